@@ -0,0 +1,184 @@
+import struct
+import zlib
+from typing import Dict, Iterable, List, Tuple
+
+import numpy as np
+
+# Counter deltas for merging the memories of nodes that share a seed
+# (hardware/esp32-s3/sensor-node/src/sdm/sdm_image.h, SDMDeltaHeader version 3).
+# Nodes export with SDM_DELTA_EXPORT; the merged result for each node is
+# built here and pushed back for SDM_DELTA_IMPORT.
+
+MAGIC = 0x444D4453  # "SDMD"
+VERSION = 3
+VARINT = 0
+RAW = 1
+SPARSE_ADDRESSES = 0x02  # SDM_IMAGE_FLAG_SPARSE_ADDRESSES
+
+_HEADER = struct.Struct('<IHHIIIBBHIIIIIHBBI')
+_RECORD = struct.Struct('<HHHH')
+
+# Largest change between two counters of a width, as the node clamps it
+_SPAN = {16: 65535, 8: 255, 4: 15}
+_RANGE = {16: (-32768, 32767), 8: (-128, 127), 4: (-8, 7)}
+# RAW lanes: int16 holds an 8- or 4-bit span, 16-bit changes need int32
+_RAW_LANE = {16: 'i', 8: 'h', 4: 'h'}
+
+class DeltaError(ValueError):
+    pass
+
+def _zigzag(value):
+    return (value << 1) ^ (value >> 63) if value < 0 else value << 1
+
+def _unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+def _put_varint(out: bytearray, value):
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+
+def _get_varint(data, at):
+    value, shift = 0, 0
+    while at < len(data) and shift < 35:
+        byte = data[at]
+        at += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, at
+        shift += 7
+    raise DeltaError('truncated varint')
+
+def encode_lanes(lanes: Iterable[int], encoding=VARINT, counter_bits=16) -> bytes:
+    """One row's lane deltas in the node's record encoding"""
+    lanes = [int(v) for v in lanes]
+    if encoding == RAW:
+        span = _SPAN[counter_bits]
+        return struct.pack(f'<{len(lanes)}{_RAW_LANE[counter_bits]}', *(max(-span, min(span, v)) for v in lanes))
+    out = bytearray()
+    j = 0
+    while j < len(lanes):
+        if lanes[j]:
+            _put_varint(out, _zigzag(lanes[j]))
+            j += 1
+            continue
+        run = 1
+        while j + run < len(lanes) and lanes[j + run] == 0:
+            run += 1
+        out.append(0)
+        _put_varint(out, run - 1)
+        j += run
+    return bytes(out)
+
+def decode_lanes(data: bytes, count, encoding=VARINT, counter_bits=16) -> List[int]:
+    span = _SPAN[counter_bits]
+    if encoding == RAW:
+        lane = struct.Struct(f'<{count}{_RAW_LANE[counter_bits]}')
+        if len(data) != lane.size:
+            raise DeltaError('raw row has the wrong length')
+        return [max(-span, min(span, v)) for v in lane.unpack(data)]
+    lanes, at = [], 0
+    while at < len(data):
+        value, at = _get_varint(data, at)
+        if value:
+            lanes.append(max(-span, min(span, _unzigzag(value))))
+        else:
+            run, at = _get_varint(data, at)
+            lanes.extend([0] * (run + 1))
+    if len(lanes) != count:
+        raise DeltaError('row decodes to the wrong number of lanes')
+    return lanes
+
+def read_delta(data: bytes) -> Dict:
+    """
+    Decode a delta file.
+
+    Returns:
+        dict of the header fields plus 'rows': {location: (access_delta, int32 lanes)}
+    """
+    if len(data) < _HEADER.size:
+        raise DeltaError('too short for a delta header')
+    fields = _HEADER.unpack_from(data)
+    (magic, version, header_bytes, seed, num_locations, vector_dim, counter_bits, encoding, row_stride,
+     row_count, base_crc, payload_bytes, payload_crc, address_crc, address_ones, flags, _, header_crc) = fields
+    if magic != MAGIC or version != VERSION or header_bytes != _HEADER.size:
+        raise DeltaError('not a version 3 delta')
+    if zlib.crc32(data[:_HEADER.size - 4]) != header_crc:
+        raise DeltaError('header CRC mismatch')
+    payload = data[_HEADER.size:_HEADER.size + payload_bytes]
+    if len(payload) != payload_bytes or zlib.crc32(payload) != payload_crc:
+        raise DeltaError('payload CRC mismatch')
+
+    rows, at = {}, 0
+    for _ in range(row_count):
+        location, access_delta, encoded_bytes, _ = _RECORD.unpack_from(payload, at)
+        at += _RECORD.size
+        lanes = decode_lanes(payload[at:at + encoded_bytes], row_stride, encoding, counter_bits)
+        at += encoded_bytes
+        rows[location] = (access_delta, np.asarray(lanes, dtype=np.int32))
+    return {'seed': seed, 'num_locations': num_locations, 'vector_dim': vector_dim, 'counter_bits': counter_bits,
+            'encoding': encoding, 'row_stride': row_stride, 'base_crc': base_crc, 'address_crc': address_crc,
+            'address_ones': address_ones, 'sparse_addresses': bool(flags & SPARSE_ADDRESSES), 'rows': rows}
+
+def write_delta(delta: Dict, encoding=VARINT) -> bytes:
+    """Encode a delta (as returned by read_delta or merge_deltas) for importDelta()"""
+    span = _SPAN[delta['counter_bits']]
+    payload = bytearray()
+    for location in sorted(delta['rows']):
+        access_delta, lanes = delta['rows'][location]
+        encoded = encode_lanes(np.clip(lanes, -span, span), encoding, delta['counter_bits'])
+        payload += _RECORD.pack(location, min(int(access_delta), 0xFFFF), len(encoded), 0) + encoded
+    header = _HEADER.pack(MAGIC, VERSION, _HEADER.size, delta['seed'], delta['num_locations'], delta['vector_dim'],
+                          delta['counter_bits'], encoding, delta['row_stride'], len(delta['rows']),
+                          delta.get('base_crc', 0), len(payload), zlib.crc32(payload), delta.get('address_crc', 0),
+                          delta.get('address_ones', 0), SPARSE_ADDRESSES if delta.get('sparse_addresses') else 0, 0, 0)
+    header = header[:-4] + struct.pack('<I', zlib.crc32(header[:-4]))
+    return header + bytes(payload)
+
+def _check_compatible(deltas):
+    # address_crc differs once a node has rebalanced: its rows sit on other hard locations.
+    # Addresses also depend on the sparsity (address_ones) and how they are stored.
+    keys = ('seed', 'num_locations', 'vector_dim', 'counter_bits', 'row_stride', 'address_crc',
+            'address_ones', 'sparse_addresses')
+    first = deltas[0]
+    for delta in deltas[1:]:
+        if any(delta[k] != first[k] for k in keys):
+            raise DeltaError('deltas come from memories with different configurations or seeds')
+
+def merge_deltas(deltas: List[Dict], subtract: Iterable[Dict] = ()) -> Dict:
+    """
+    Sum deltas row by row, minus any in subtract. Counters are additive under
+    a shared seed, so the sum is the change all nodes made together; minus a
+    node's own delta it is what that node still has to import.
+    """
+    subtract = list(subtract)
+    _check_compatible(deltas + subtract)
+    rows: Dict[int, Tuple[int, np.ndarray]] = {}
+    for sign, group in ((1, deltas), (-1, subtract)):
+        for delta in group:
+            for location, (access_delta, lanes) in delta['rows'].items():
+                total_access, total = rows.get(location, (0, np.zeros(delta['row_stride'], dtype=np.int64)))
+                rows[location] = (total_access + sign * access_delta, total + sign * lanes.astype(np.int64))
+    merged = {k: v for k, v in deltas[0].items() if k != 'rows'}
+    merged['base_crc'] = 0
+    merged['rows'] = {location: (max(0, access), lanes)
+                      for location, (access, lanes) in rows.items() if access > 0 or lanes.any()}
+    return merged
+
+def apply_delta(counters: np.ndarray, access_counts: np.ndarray, delta: Dict):
+    """
+    Saturating-add a delta in place, as importDelta() does on a node.
+
+    Args:
+        counters: (num_locations, row_stride) integer lane values
+        access_counts: (num_locations,) integer access counts
+    """
+    if not delta['rows']:
+        return
+    low, high = _RANGE[delta['counter_bits']]
+    locations = np.fromiter(delta['rows'], dtype=np.int64)
+    lanes = np.stack([delta['rows'][int(location)][1] for location in locations])
+    access = np.array([delta['rows'][int(location)][0] for location in locations], dtype=np.int64)
+    counters[locations] = np.clip(counters[locations].astype(np.int64) + lanes, low, high)
+    access_counts[locations] = np.minimum(access_counts[locations].astype(np.int64) + access, 0xFFFF)
@@ -2,6 +2,14 @@ import numpy as np
 import matplotlib.pyplot as plt
 import sys
 from typing import Dict, List, Tuple, Optional
+
+# C++ engine shared with the sensor node (python setup.py build_ext --inplace);
+# without it everything below runs on the pure-Python SparseDistributedMemory
+try:
+    from . import _sdm_native
+except ImportError:
+    _sdm_native = None
+
 class SparseDistributedMemory:
     def __init__(self, vector_dim=1024, num_locations=1000, access_radius=100):
         """
@@ -151,6 +159,118 @@ class SparseDistributedMemory:
             'read_stats': self.read_stats
         }
 
+def pack_vectors(bits, vector_dim):
+    """
+    Pack 0/1 vectors into the device layout: bit i in bit (i % 32) of uint32 word (i // 32).
+
+    Args:
+        bits: array of shape (vector_dim,) or (n, vector_dim)
+    Returns:
+        uint32 array of shape (words,) or (n, words)
+    """
+    bits = np.asarray(bits, dtype=np.uint8)
+    words = (vector_dim + 31) // 32
+    packed = np.packbits(bits.reshape(-1, vector_dim), axis=1, bitorder='little')
+    padded = np.zeros((packed.shape[0], words * 4), dtype=np.uint8)
+    padded[:, :packed.shape[1]] = packed
+    packed = padded.view('<u4').astype(np.uint32, copy=False)
+    return packed[0] if bits.ndim == 1 else packed
+
+def unpack_vectors(packed, vector_dim):
+    """Inverse of pack_vectors: int 0/1 array of shape (vector_dim,) or (n, vector_dim)"""
+    packed = np.asarray(packed, dtype='<u4')
+    rows = np.ascontiguousarray(packed.reshape(-1, packed.shape[-1]))
+    bits = np.unpackbits(rows.view(np.uint8), axis=1, count=vector_dim, bitorder='little').astype(int)
+    return bits[0] if packed.ndim == 1 else bits
+
+class NativeSparseDistributedMemory:
+    def __init__(self, vector_dim=1024, num_locations=1000, access_radius=100,
+                 sparsity=0.03, counter_bits=16, use_index=True, **engine_options):
+        """
+        SparseDistributedMemory's interface on the sensor node's C++ engine.
+
+        Addresses, counters and read weighting are the device's, so results match
+        the node and images move between them (export_image/load_image). Batched
+        packed calls (write_packed/read_packed) release the GIL.
+
+        Args:
+            vector_dim, num_locations, access_radius: as for SparseDistributedMemory
+            sparsity: fraction of address bits set
+            counter_bits: saturating counter width, 16, 8 or 4
+            engine_options: seed, sparse_addresses, dual_core
+        """
+        if _sdm_native is None:
+            raise ImportError("native SDM engine not built (python setup.py build_ext --inplace)")
+        self.vector_dim = vector_dim
+        self.num_locations = num_locations
+        self.access_radius = access_radius
+        self.engine = _sdm_native.SDM(vector_dim=vector_dim, num_locations=num_locations,
+                                      access_radius=access_radius, sparsity=sparsity,
+                                      counter_bits=counter_bits, use_index=use_index, **engine_options)
+        self.write_stats = []
+        self.read_stats = []
+
+    def write_packed(self, packed, strength=1):
+        """Write packed vectors (see pack_vectors) in order; returns total activated locations"""
+        return self.engine.write(np.ascontiguousarray(packed), strength)
+
+    def read_packed(self, packed):
+        """Read packed queries; returns (packed outputs, confidences)"""
+        return self.engine.read(np.ascontiguousarray(packed))
+
+    def write(self, input_vector, strength=1):
+        activated = self.write_packed(pack_vectors(input_vector, self.vector_dim), strength)
+        self.write_stats.append({
+            'activated_locations': activated,
+            'activation_rate': activated / self.num_locations,
+            'pattern_sparsity': float(np.mean(input_vector))
+        })
+        return activated
+
+    def read(self, query_vector):
+        packed, confidence = self.read_packed(pack_vectors(query_vector, self.vector_dim))
+        self.read_stats.append({
+            'activated_locations': self.engine.stats()['last_activated_locations'],
+            'confidence': confidence
+        })
+        return unpack_vectors(packed, self.vector_dim), confidence
+
+    def export_image(self, path):
+        """Write a device-format memory image; returns its payload CRC32"""
+        return self.engine.export_image(str(path))
+
+    def load_image(self, path):
+        """Load a device-format image of the same configuration and seed"""
+        self.engine.load_image(str(path))
+
+    def export_delta(self, path, baseline, raw=False):
+        """Write the changes since the baseline image as a delta (see delta.py) and advance the baseline"""
+        self.engine.export_delta(str(path), str(baseline), raw)
+
+    def import_delta(self, path, baseline, advance_baseline=True):
+        """Saturating-add a merged fleet delta onto the counters"""
+        self.engine.import_delta(str(path), str(baseline), advance_baseline)
+
+    def get_memory_statistics(self):
+        access_counts = self.engine.access_counts()
+        return {
+            'memory_utilization': float(np.mean(access_counts > 0)),
+            'avg_access_count': float(np.mean(access_counts)),
+            'max_access_count': int(np.max(access_counts)),
+            'write_stats': self.write_stats,
+            'read_stats': self.read_stats
+        }
+
+def create_memory(vector_dim, num_locations, access_radius, native=None):
+    """
+    SDM for the backend: the native engine when built (or native=True), else Python.
+    """
+    if native is None:
+        native = _sdm_native is not None
+    if native:
+        return NativeSparseDistributedMemory(vector_dim, num_locations, access_radius)
+    return SparseDistributedMemory(vector_dim, num_locations, access_radius)
+
 def generate_sparse_vector(dim: int, sparsity: float = 0.05) -> np.ndarray:
     """
     Generate properly sparse binary vector (unlike your current dense ones)
@@ -250,13 +370,11 @@ def plot_reinforcement_effects(results):
     plt.show()
 
 def run_enhanced_sdm_test(vector_dim=32, num_locations=3000, access_radius=18, 
-                       reinforce=30, use_sparse_encoding=True, target_sparsity=0.03):
+                       reinforce=30, use_sparse_encoding=True, target_sparsity=0.03, native=None):
     """
     Enhanced version of your test function with better analysis
     """
-    sdm = SparseDistributedMemory(vector_dim=vector_dim, 
-    num_locations=num_locations, 
-    access_radius=access_radius)
+    sdm = create_memory(vector_dim, num_locations, access_radius, native=native)
     
     # Generate input vector
     if use_sparse_encoding:
@@ -306,12 +424,13 @@ def run_enhanced_sdm_test(vector_dim=32, num_locations=3000, access_radius=18,
     }
 
 def run_sdm_memory_test(vector_dim=32, num_locations=3000, access_radius=18, 
-                       reinforce=30, use_sparse_encoding=True, target_sparsity=0.03):
+                       reinforce=30, use_sparse_encoding=True, target_sparsity=0.03, native=None):
 
     result = run_enhanced_sdm_test(
         vector_dim, num_locations, access_radius, reinforce, 
         use_sparse_encoding=use_sparse_encoding,
-        target_sparsity=target_sparsity 
+        target_sparsity=target_sparsity,
+        native=native
     )
     return result
 
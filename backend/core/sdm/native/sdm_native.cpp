@@ -0,0 +1,292 @@
+// Python binding over the host build of the sensor node's SDM engine
+// (hardware/esp32-s3/sensor-node/src/sdm, built against src/host).
+//
+// Vectors use the device's packed layout: bit i of a vector is bit (i % 32)
+// of uint32 word (i / 32), wordsPerVector() words per vector, unused tail bits
+// zero. On little-endian hosts that is np.packbits(bits, bitorder="little")
+// padded to a multiple of 4 bytes, so uint8 arrays of that shape are accepted
+// as well as uint32 ones. Batched calls release the GIL for the whole batch.
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include <SD.h>
+#include "sdm/sdm.h"
+
+namespace py = pybind11;
+
+namespace {
+
+class NativeSDM {
+public:
+    NativeSDM(uint16_t vector_dim, uint16_t num_locations, uint16_t access_radius, float sparsity,
+              uint32_t seed, uint8_t counter_bits, bool use_index, bool sparse_addresses, bool dual_core) {
+        if (vector_dim == 0 || num_locations == 0) {
+            throw py::value_error("vector_dim and num_locations must be positive");
+        }
+        if (counter_bits != 16 && counter_bits != 8 && counter_bits != 4) {
+            throw py::value_error("counter_bits must be 16, 8 or 4");
+        }
+
+        // Never touches the card files; images go through the explicit calls below
+        SDMConfig config;
+        config.vector_dim = vector_dim;
+        config.num_locations = num_locations;
+        config.access_radius = access_radius;
+        config.sparsity = sparsity;
+        config.seed = seed;
+        config.counter_bits = counter_bits;
+        config.use_index = use_index;
+        config.sparse_addresses = sparse_addresses;
+        config.dual_core = dual_core;
+        config.persistent = false;
+
+        sdm.reset(new SparseDistributedMemory(config));
+        bool initialized;
+        {
+            py::gil_scoped_release release;
+            initialized = sdm->initialize();
+        }
+        if (!initialized) {
+            throw std::runtime_error("SDM initialization failed");
+        }
+        words = sdm->wordsPerVector();
+    }
+
+    // Returns the total number of activated locations over all vectors
+    uint64_t write(py::array vectors, uint8_t strength) {
+        size_t count = 0;
+        const uint32_t* packed = packedRows(vectors, &count);
+        uint64_t activated = 0;
+
+        py::gil_scoped_release release;
+        std::lock_guard<std::mutex> guard(lock);
+        for (size_t done = 0; done < count;) {
+            uint16_t chunk = static_cast<uint16_t>(std::min<size_t>(count - done, 0xFFFF));
+            activated += sdm->writeBatch(packed + done * words, chunk, strength);
+            done += chunk;
+        }
+        return activated;
+    }
+
+    // (outputs, confidences): uint32 words shaped like the query, float32 per vector
+    py::tuple read(py::array queries) {
+        size_t count = 0;
+        const uint32_t* packed = packedRows(queries, &count);
+        bool single = queries.ndim() == 1;
+
+        py::array_t<uint32_t> outputs(single ? std::vector<py::ssize_t>{words}
+                                             : std::vector<py::ssize_t>{static_cast<py::ssize_t>(count), words});
+        py::array_t<float> confidences(static_cast<py::ssize_t>(count));
+        uint32_t* out = outputs.mutable_data();
+        float* conf = confidences.mutable_data();
+        {
+            py::gil_scoped_release release;
+            std::lock_guard<std::mutex> guard(lock);
+            for (size_t done = 0; done < count;) {
+                uint16_t chunk = static_cast<uint16_t>(std::min<size_t>(count - done, 0xFFFF));
+                sdm->readBatch(packed + done * words, chunk, out + done * words, conf + done);
+                done += chunk;
+            }
+        }
+        if (single) return py::make_tuple(outputs, conf[0]);
+        return py::make_tuple(outputs, confidences);
+    }
+
+    void clear() {
+        py::gil_scoped_release release;
+        std::lock_guard<std::mutex> guard(lock);
+        sdm->clearMemory();
+        sdm->resetStats();
+    }
+
+    // Memory images in the device format (what the node keeps in /sdm/memory.bin)
+    uint32_t exportImage(const std::string& path) {
+        uint32_t crc = 0;
+        bool written;
+        {
+            py::gil_scoped_release release;
+            std::lock_guard<std::mutex> guard(lock);
+            written = sdm->exportImage(path.c_str(), &crc);
+        }
+        if (!written) throw std::runtime_error("could not write image " + path);
+        return crc;
+    }
+
+    void loadImage(const std::string& path) {
+        bool loaded;
+        {
+            py::gil_scoped_release release;
+            std::lock_guard<std::mutex> guard(lock);
+            sdm->clearMemory();
+            loaded = sdm->stackImage(path.c_str());
+            // Leave the memory empty rather than with part of the image
+            if (!loaded) sdm->clearMemory();
+        }
+        if (!loaded) throw std::runtime_error(path + " is not an image for this configuration");
+    }
+
+    void stackImage(const std::string& path) {
+        bool stacked;
+        {
+            py::gil_scoped_release release;
+            std::lock_guard<std::mutex> guard(lock);
+            stacked = sdm->stackImage(path.c_str());
+        }
+        if (!stacked) throw std::runtime_error(path + " is not an image for this configuration");
+    }
+
+    // Fleet merge deltas; the baseline is always explicit since the node's
+    // default sync file would land in /sdm on the host
+    void exportDelta(const std::string& path, const std::string& baseline, bool raw) {
+        bool written;
+        {
+            py::gil_scoped_release release;
+            std::lock_guard<std::mutex> guard(lock);
+            written = sdm->exportDelta(path.c_str(), raw ? SDM_DELTA_RAW : SDM_DELTA_VARINT, baseline.c_str());
+        }
+        if (!written) throw std::runtime_error("could not write delta " + path);
+    }
+
+    void importDelta(const std::string& path, const std::string& baseline, bool advance_baseline) {
+        bool imported;
+        {
+            py::gil_scoped_release release;
+            std::lock_guard<std::mutex> guard(lock);
+            imported = sdm->importDelta(path.c_str(), advance_baseline, baseline.c_str());
+        }
+        if (!imported) throw std::runtime_error(path + " is not a delta for this configuration");
+    }
+
+    py::array_t<uint32_t> address(uint16_t location) const {
+        if (location >= sdm->config.num_locations) throw py::index_error("location out of range");
+        py::array_t<uint32_t> packed(words);
+        sdm->generateAddress(location, packed.mutable_data());
+        return packed;
+    }
+
+    py::array_t<uint16_t> accessCounts() {
+        std::lock_guard<std::mutex> guard(lock);
+        py::array_t<uint16_t> counts(sdm->config.num_locations);
+        uint16_t* data = counts.mutable_data();
+        for (uint16_t location = 0; location < sdm->config.num_locations; location++) {
+            data[location] = sdm->accessCount(location);
+        }
+        return counts;
+    }
+
+    py::dict stats() {
+        SDMStats s;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            s = sdm->getStats();
+        }
+        py::dict result;
+        result["total_writes"] = s.total_writes;
+        result["total_reads"] = s.total_reads;
+        result["last_confidence"] = s.last_confidence;
+        result["last_activated_locations"] = s.last_activated_locations;
+        result["last_radius"] = s.last_radius;
+        return result;
+    }
+
+    const SDMConfig& config() const { return sdm->config; }
+    // 0 activates within access_radius, otherwise the k nearest locations per op
+    void setTargetActivations(uint16_t k) {
+        py::gil_scoped_release release;
+        std::lock_guard<std::mutex> guard(lock);
+        sdm->config.target_activations = k;
+    }
+    uint16_t wordsPerVector() const { return words; }
+    uint32_t footprintBytes() const { return sdm->footprint().total(); }
+
+private:
+    std::unique_ptr<SparseDistributedMemory> sdm;
+    std::mutex lock;  // The engine is single-threaded; calls from other Python threads wait here
+    py::ssize_t words = 0;
+
+    // Validate a (words,) or (n, words) uint32 array, or the same bytes as uint8
+    const uint32_t* packedRows(py::array& vectors, size_t* count) const {
+        if (!(vectors.flags() & py::array::c_style)) {
+            throw py::value_error("packed vectors must be C-contiguous");
+        }
+        py::ssize_t row_items;
+        if (py::isinstance<py::array_t<uint32_t>>(vectors)) {
+            row_items = words;
+        } else if (py::isinstance<py::array_t<uint8_t>>(vectors)) {
+            row_items = words * 4;
+        } else {
+            throw py::value_error("packed vectors must be uint32 words or uint8 bytes");
+        }
+        if ((vectors.ndim() != 1 && vectors.ndim() != 2) || vectors.shape(vectors.ndim() - 1) != row_items) {
+            throw py::value_error("expected packed vectors of shape (" + std::to_string(row_items) + ",) or (n, " +
+                                  std::to_string(row_items) + ")");
+        }
+        *count = vectors.ndim() == 1 ? 1 : static_cast<size_t>(vectors.shape(0));
+
+        // Tail bits past vector_dim would count towards every distance
+        const uint32_t* packed = static_cast<const uint32_t*>(vectors.data());
+        uint16_t tail = sdm->config.vector_dim & 31;
+        if (tail) {
+            uint32_t mask = ~((1u << tail) - 1u);
+            for (size_t v = 0; v < *count; v++) {
+                if (packed[v * words + words - 1] & mask) {
+                    throw py::value_error("bits past vector_dim must be zero");
+                }
+            }
+        }
+        return packed;
+    }
+};
+
+} // namespace
+
+PYBIND11_MODULE(_sdm_native, m) {
+    m.doc() = "Sparse Distributed Memory engine shared with the ESP32-S3 sensor node";
+
+    // Image paths are host paths
+    sdmHostSetRoot("/");
+
+    m.attr("AVX2") = static_cast<bool>(SDM_USE_AVX2);
+    m.attr("NEON") = static_cast<bool>(SDM_USE_NEON);
+    m.attr("BATCH_MAX") = SDM_BATCH_MAX;
+
+    py::class_<NativeSDM>(m, "SDM")
+        .def(py::init<uint16_t, uint16_t, uint16_t, float, uint32_t, uint8_t, bool, bool, bool>(),
+             py::arg("vector_dim") = 128, py::arg("num_locations") = 1000, py::arg("access_radius") = 20,
+             py::arg("sparsity") = 0.03f, py::arg("seed") = 0x5DC0FFEE, py::arg("counter_bits") = 16,
+             py::arg("use_index") = true, py::arg("sparse_addresses") = false, py::arg("dual_core") = false)
+        .def("write", &NativeSDM::write, py::arg("vectors"), py::arg("strength") = 1,
+             "Write packed vectors in order; returns the total activated locations")
+        .def("read", &NativeSDM::read, py::arg("queries"),
+             "Read packed queries; returns (packed outputs, confidences)")
+        .def("clear", &NativeSDM::clear)
+        .def("export_image", &NativeSDM::exportImage, py::arg("path"),
+             "Write a device-format memory image; returns its payload CRC32")
+        .def("load_image", &NativeSDM::loadImage, py::arg("path"),
+             "Replace the counters with a device-format image of the same config and seed")
+        .def("stack_image", &NativeSDM::stackImage, py::arg("path"),
+             "Saturating-add a device-format image onto the counters")
+        .def("export_delta", &NativeSDM::exportDelta, py::arg("path"), py::arg("baseline"), py::arg("raw") = false,
+             "Write the rows changed since the baseline image as a delta, then advance the baseline")
+        .def("import_delta", &NativeSDM::importDelta, py::arg("path"), py::arg("baseline"),
+             py::arg("advance_baseline") = true, "Saturating-add a delta from another node with this config and seed")
+        .def("address", &NativeSDM::address, py::arg("location"))
+        .def("access_counts", &NativeSDM::accessCounts)
+        .def("stats", &NativeSDM::stats)
+        .def_property_readonly("vector_dim", [](const NativeSDM& s) { return s.config().vector_dim; })
+        .def_property_readonly("num_locations", [](const NativeSDM& s) { return s.config().num_locations; })
+        .def_property_readonly("access_radius", [](const NativeSDM& s) { return s.config().access_radius; })
+        .def_property("target_activations", [](const NativeSDM& s) { return s.config().target_activations; },
+                      &NativeSDM::setTargetActivations)
+        .def_property_readonly("counter_bits", [](const NativeSDM& s) { return s.config().counter_bits; })
+        .def_property_readonly("seed", [](const NativeSDM& s) { return s.config().seed; })
+        .def_property_readonly("words_per_vector", &NativeSDM::wordsPerVector)
+        .def_property_readonly("footprint_bytes", &NativeSDM::footprintBytes);
+}
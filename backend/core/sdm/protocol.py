@@ -0,0 +1,209 @@
+import socket
+import struct
+import zlib
+from typing import Optional, Tuple
+
+import numpy as np
+
+# Host side of the sensor node's binary serial frames
+# (hardware/esp32-s3/sensor-node/src/sdm/sdm_protocol.h). `port` is anything
+# with read(n) and write(bytes), e.g. serial.Serial(dev, 115200, timeout=1),
+# or a UdpPort for the node's network service (sdm_net.h).
+
+SYNC = b'\xA5\x5A'
+REPLY = 0x80
+MAX_PAYLOAD = 8192
+
+INFO = 0x01
+WRITE = 0x02
+READ = 0x03
+LIB_BEGIN = 0x10
+LIB_DATA = 0x11
+LIB_END = 0x12
+NAK = 0x7F
+
+# Safe to resend after a timeout: running these twice changes nothing
+IDEMPOTENT = (INFO, READ)
+
+STATUS_BUSY = 7
+STATUS = {0: 'ok', 1: 'bad crc', 2: 'too large', 3: 'bad request', 4: 'not ready', 5: 'io error',
+          6: 'bad library', STATUS_BUSY: 'busy'}
+
+NET_PORT = 5710
+
+class ProtocolError(RuntimeError):
+    pass
+
+class Busy(ProtocolError):
+    """The node's request queue was full; the request was not run"""
+
+def encode_frame(frame_type, sequence, payload=b''):
+    """Frame bytes: sync, header, payload and the CRC32 over header and payload"""
+    body = struct.pack('<BBHH', frame_type, 0, sequence, len(payload)) + payload
+    return SYNC + body + struct.pack('<I', zlib.crc32(body))
+
+def read_frame(port) -> Tuple[int, int, bytes]:
+    """
+    Read the next frame, skipping text (heartbeats, logs) in front of it.
+
+    Returns:
+        (type, sequence, payload)
+    """
+    window = b''
+    while True:
+        byte = port.read(1)
+        if not byte:
+            raise ProtocolError('timed out waiting for a frame')
+        window = (window + byte)[-2:]
+        if window != SYNC:
+            continue
+        header = _read_exact(port, 6)
+        frame_type, _, sequence, length = struct.unpack('<BBHH', header)
+        payload = _read_exact(port, length)
+        (crc,) = struct.unpack('<I', _read_exact(port, 4))
+        if zlib.crc32(header + payload) == crc:
+            return frame_type, sequence, payload
+        window = b''
+
+def _read_exact(port, count):
+    data = b''
+    while len(data) < count:
+        chunk = port.read(count - len(data))
+        if not chunk:
+            raise ProtocolError('timed out inside a frame')
+        data += chunk
+    return data
+
+class UdpPort:
+    def __init__(self, host, port=NET_PORT, timeout=0.5):
+        """
+        Datagram transport with the read/write interface of a serial port: each
+        write() is one frame in one packet, read() hands out received packets.
+        """
+        self.address = (host, port)
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.settimeout(timeout)
+        self.pending = b''
+
+    def write(self, data):
+        self.pending = b''  # Whatever is left belongs to an abandoned request
+        self.sock.sendto(data, self.address)
+
+    def read(self, count):
+        while not self.pending:
+            try:
+                packet, sender = self.sock.recvfrom(2048)
+            except socket.timeout:
+                return b''
+            if sender[0] == self.address[0]:
+                self.pending = packet
+        data, self.pending = self.pending[:count], self.pending[count:]
+        return data
+
+    def close(self):
+        self.sock.close()
+
+class NodeLink:
+    def __init__(self, port, retries=0):
+        """
+        Request/reply client for one node.
+
+        Args:
+            port: open serial port (or any read/write stream) at SERIAL_BAUD,
+                or a UdpPort
+            retries: times a request is resent after a busy reply, or after
+                a timeout for INFO and READ. Only for transports that can lose
+                a request outright (UDP). Other requests are not resent on a
+                timeout: the reply may be what was lost, and a WRITE that
+                had already run would be applied twice.
+        """
+        self.port = port
+        self.retries = retries
+        self.sequence = 0
+        self.vector_dim, self.num_locations, self.words, self.max_payload, bits_batch, _ = self._info()
+        self.counter_bits = bits_batch & 0xFF
+
+    @classmethod
+    def udp(cls, host, port=NET_PORT, timeout=0.5, retries=3):
+        return cls(UdpPort(host, port, timeout), retries=retries)
+
+    def request(self, frame_type, payload=b''):
+        """Send one frame and return the payload of its reply"""
+        for attempt in range(self.retries + 1):
+            try:
+                return self._request_once(frame_type, payload)
+            except ProtocolError as error:
+                last = attempt == self.retries
+                retry = isinstance(error, Busy) or ('timed out' in str(error) and frame_type in IDEMPOTENT)
+                if last or not retry:
+                    raise
+
+    def _request_once(self, frame_type, payload):
+        self.sequence = (self.sequence + 1) & 0xFFFF
+        self.port.write(encode_frame(frame_type, self.sequence, payload))
+        while True:
+            reply_type, sequence, reply = read_frame(self.port)
+            if sequence != self.sequence:
+                continue  # A late reply to an earlier request
+            if reply_type == NAK or reply_type != frame_type | REPLY:
+                status = self._status_code(reply)
+                error = Busy if status == STATUS_BUSY else ProtocolError
+                raise error(f'request 0x{frame_type:02x} rejected: {self._status(reply)}')
+            return reply
+
+    def _status_code(self, reply) -> int:
+        return struct.unpack_from('<H', reply)[0] if len(reply) >= 2 else -1
+
+    def _status(self, reply) -> str:
+        status = self._status_code(reply)
+        return STATUS.get(status, f'status {status}')
+
+    def _checked(self, frame_type, payload=b'') -> int:
+        """Request with a status reply; returns its value"""
+        reply = self.request(frame_type, payload)
+        status, _, value = struct.unpack('<HHI', reply)
+        if status != 0:
+            raise ProtocolError(f'request 0x{frame_type:02x} failed: {STATUS.get(status, status)}')
+        return value
+
+    def _info(self):
+        return struct.unpack('<6H', self.request(INFO))
+
+    def _batches(self, packed, extra_per_vector=0):
+        packed = np.ascontiguousarray(np.atleast_2d(packed), dtype='<u4')
+        if packed.shape[1] != self.words:
+            raise ValueError(f'expected packed vectors of {self.words} words')
+        per_frame = max(1, (self.max_payload - 4) // (self.words * 4 + extra_per_vector))
+        for first in range(0, len(packed), per_frame):
+            yield packed[first:first + per_frame]
+
+    def write(self, packed, strength=1) -> int:
+        """Write packed vectors (see memory.pack_vectors); returns the activated locations"""
+        activated = 0
+        for batch in self._batches(packed):
+            activated += self._checked(WRITE, struct.pack('<BBH', strength, 0, len(batch)) + batch.tobytes())
+        return activated
+
+    def read(self, packed) -> Tuple[np.ndarray, np.ndarray]:
+        """Read packed queries; returns (packed outputs, confidences)"""
+        outputs, confidences = [], []
+        for batch in self._batches(packed, extra_per_vector=4):
+            reply = self.request(READ, struct.pack('<HH', len(batch), 0) + batch.tobytes())
+            count = struct.unpack_from('<H', reply)[0]
+            vectors_end = 4 + count * self.words * 4
+            outputs.append(np.frombuffer(reply[4:vectors_end], dtype='<u4').reshape(count, self.words))
+            confidences.append(np.frombuffer(reply[vectors_end:], dtype='<f4'))
+        return np.concatenate(outputs).astype(np.uint32), np.concatenate(confidences)
+
+    def upload_library(self, name, vectors_bin: bytes, chunk: Optional[int] = None) -> int:
+        """
+        Install a library file (vectors.bin, version 2) as /lib/<name>/vectors.bin.
+
+        Returns:
+            number of vectors the node verified and installed
+        """
+        chunk = chunk or self.max_payload - 4
+        self._checked(LIB_BEGIN, struct.pack('<I', len(vectors_bin)) + name.encode())
+        for offset in range(0, len(vectors_bin), chunk):
+            self._checked(LIB_DATA, struct.pack('<I', offset) + vectors_bin[offset:offset + chunk])
+        return self._checked(LIB_END)
@@ -0,0 +1,113 @@
+import socket
+import struct
+import zlib
+from typing import Dict, Iterator, Optional
+
+# Decoder for the sensor node's binary telemetry frames
+# (hardware/esp32-s3/sensor-node/src/sdm/sdm_telemetry.h, version 1)
+
+MAGIC = b'SDMT'
+VERSION = 1
+BUCKETS = 16
+OPS = ('write', 'read', 'checkpoint', 'save')
+
+FLAG_PAGED = 0x01
+FLAG_PSRAM = 0x02
+FLAG_HOT_PATH = 0x04
+
+_FRAME = struct.Struct(
+    '<4sHHII'                        # magic, version, frame_bytes, sequence, uptime_ms
+    'HHHBBII'                        # config, flags, total_writes, total_reads
+    f'{len(OPS)}I{len(OPS)}I'        # op_count, op_max_us
+    f'{len(OPS) * BUCKETS}I'         # latency_us
+    f'{BUCKETS}I'                    # activated
+    'IIHH'                           # saturated_lanes, sampled_lanes, used_locations, max_access_count
+    f'{BUCKETS}I'                    # access_counts
+    'IIII'                           # heap_free, heap_min_free, psram_free, psram_min_free
+    'HHIII'                          # dirty_rows, page_failures, page_faults, page_writebacks, crc
+)
+FRAME_BYTES = _FRAME.size
+
+def bucket_bounds(bucket):
+    """[low, high) of a log2 histogram bucket; the last bucket has no upper bound"""
+    if bucket == 0:
+        return 0, 1
+    high = None if bucket == BUCKETS - 1 else 1 << bucket
+    return 1 << (bucket - 1), high
+
+def decode_frame(data: bytes) -> Optional[Dict]:
+    """
+    Decode one frame.
+
+    Args:
+        data: exactly FRAME_BYTES bytes starting at the magic
+    Returns:
+        dict of the frame's fields (histograms as lists of bucket counts),
+        or None if the magic, version, size or CRC don't match
+    """
+    if len(data) != FRAME_BYTES:
+        return None
+    fields = _FRAME.unpack(data)
+    magic, version, frame_bytes = fields[0:3]
+    if magic != MAGIC or version != VERSION or frame_bytes != FRAME_BYTES:
+        return None
+    if zlib.crc32(data[:-4]) != fields[-1]:
+        return None
+
+    values = iter(fields[3:])
+    take = lambda n: [next(values) for _ in range(n)]
+    frame = dict(zip(('sequence', 'uptime_ms', 'vector_dim', 'num_locations', 'access_radius',
+                      'counter_bits', 'flags', 'total_writes', 'total_reads'), take(9)))
+    op_count, op_max_us = take(len(OPS)), take(len(OPS))
+    frame['ops'] = {
+        op: {'count': op_count[i], 'max_us': op_max_us[i], 'latency_us': take(BUCKETS)}
+        for i, op in enumerate(OPS)
+    }
+    frame['activated'] = take(BUCKETS)
+    frame.update(zip(('saturated_lanes', 'sampled_lanes', 'used_locations', 'max_access_count'), take(4)))
+    frame['access_counts'] = take(BUCKETS)
+    frame.update(zip(('heap_free', 'heap_min_free', 'psram_free', 'psram_min_free',
+                      'dirty_rows', 'page_failures', 'page_faults', 'page_writebacks'), take(8)))
+
+    frame['saturation'] = frame['saturated_lanes'] / frame['sampled_lanes'] if frame['sampled_lanes'] else 0.0
+    frame['utilization'] = frame['used_locations'] / frame['num_locations'] if frame['num_locations'] else 0.0
+    return frame
+
+def iter_frames(stream) -> Iterator[Dict]:
+    """
+    Yield frames from a serial port or file (anything with read(n)), skipping
+    the text output the node interleaves with them.
+    """
+    buffer = b''
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            return
+        buffer += chunk
+        while True:
+            at = buffer.find(MAGIC)
+            if at < 0:
+                buffer = buffer[-(len(MAGIC) - 1):]
+                break
+            if len(buffer) - at < FRAME_BYTES:
+                buffer = buffer[at:]
+                break
+            frame = decode_frame(buffer[at:at + FRAME_BYTES])
+            if frame is None:
+                # Magic inside text or a corrupt frame: resynchronise past it
+                buffer = buffer[at + 1:]
+                continue
+            buffer = buffer[at + FRAME_BYTES:]
+            yield frame
+
+def listen_udp(port, host='0.0.0.0') -> Iterator[Dict]:
+    """Yield frames sent to SDM_TELEMETRY_UDP <this host> <port>, one per datagram"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((host, port))
+    try:
+        while True:
+            frame = decode_frame(sock.recv(2048))
+            if frame is not None:
+                yield frame
+    finally:
+        sock.close()
@@ -20,6 +20,10 @@ private:
 public:
     CameraModule();
     bool init();
+    // Raw formats for on-device processing; fb_count > 1 lets the driver fill
+    // one buffer while another is held
+    bool init(pixformat_t format, framesize_t size, uint8_t fb_count);
+    void deinit();
     bool isInitialized();
     CameraStatus getStatus();
     camera_fb_t* captureFrame();
@@ -0,0 +1,170 @@
+#ifndef SDM_HOST_ARDUINO_H
+#define SDM_HOST_ARDUINO_H
+
+// Host (native) stand-in for the subset of the Arduino-ESP32 core the SDM
+// engine uses: String, Serial, ESP, timing and random. Only on the include
+// path of the [env:native] build; the device build never sees it.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+class String : public std::string {
+public:
+    String() {}
+    String(const char* s) : std::string(s ? s : "") {}
+    String(const std::string& s) : std::string(s) {}
+    explicit String(char c) : std::string(1, c) {}
+    String(int value) : std::string(std::to_string(value)) {}
+    String(unsigned int value) : std::string(std::to_string(value)) {}
+    String(long value) : std::string(std::to_string(value)) {}
+    String(unsigned long value) : std::string(std::to_string(value)) {}
+    String(long long value) : std::string(std::to_string(value)) {}
+    String(unsigned long long value) : std::string(std::to_string(value)) {}
+    String(float value, unsigned int decimals = 2) : String(static_cast<double>(value), decimals) {}
+    String(double value, unsigned int decimals = 2);
+
+    unsigned int length() const { return static_cast<unsigned int>(size()); }
+    bool isEmpty() const { return empty(); }
+    char charAt(unsigned int index) const { return index < size() ? (*this)[index] : 0; }
+    bool equals(const String& other) const { return *this == other; }
+    bool startsWith(const String& prefix) const { return compare(0, prefix.size(), prefix) == 0; }
+    bool endsWith(const String& suffix) const {
+        return size() >= suffix.size() && compare(size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    int indexOf(char c, unsigned int from = 0) const { return position(find(c, from)); }
+    int indexOf(const String& s, unsigned int from = 0) const { return position(find(s, from)); }
+    int lastIndexOf(char c) const { return position(rfind(c)); }
+    String substring(unsigned int begin) const { return begin < size() ? String(substr(begin)) : String(); }
+    String substring(unsigned int begin, unsigned int end) const {
+        if (begin > end) std::swap(begin, end);
+        return begin < size() ? String(substr(begin, end - begin)) : String();
+    }
+
+    void trim();
+    void toUpperCase() { for (char& c : *this) c = static_cast<char>(toupper(static_cast<unsigned char>(c))); }
+    void toLowerCase() { for (char& c : *this) c = static_cast<char>(tolower(static_cast<unsigned char>(c))); }
+    void replace(const String& from, const String& to);
+    void remove(unsigned int index) { if (index < size()) erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < size()) erase(index, count); }
+    bool concat(const String& s) { append(s); return true; }
+
+    long toInt() const { return atol(c_str()); }
+    float toFloat() const { return static_cast<float>(atof(c_str())); }
+
+private:
+    static int position(size_t pos) { return pos == npos ? -1 : static_cast<int>(pos); }
+};
+
+inline const std::string& stdString(const String& s) { return s; }
+inline String operator+(const String& a, const String& b) { return String(stdString(a) + stdString(b)); }
+inline String operator+(const String& a, const char* b) { return String(stdString(a) + b); }
+inline String operator+(const char* a, const String& b) { return String(a + stdString(b)); }
+inline String operator+(const String& a, char b) { return String(stdString(a) + b); }
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        for (size_t i = 0; i < size; i++) write(buffer[i]);
+        return size;
+    }
+    size_t write(const char* s) { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const String& s) { return write(reinterpret_cast<const uint8_t*>(s.data()), s.size()); }
+    size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+    size_t print(int value) { return print(String(value)); }
+    size_t print(unsigned int value) { return print(String(value)); }
+    size_t print(long value) { return print(String(value)); }
+    size_t print(unsigned long value) { return print(String(value)); }
+    size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T& value) { return print(value) + println(); }
+    size_t println(double value, int decimals) { return print(value, decimals) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+
+    // Never waits: stops at the first byte not yet available
+    size_t readBytes(char* buffer, size_t length) {
+        size_t count = 0;
+        for (int c; count < length && (c = read()) >= 0;) buffer[count++] = static_cast<char>(c);
+        return count;
+    }
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes(reinterpret_cast<char*>(buffer), length); }
+    String readString();
+    String readStringUntil(char terminator);
+};
+
+// Serial writes to stdout and reads from stdin without blocking the caller
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+    size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+    using Print::write;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override { fflush(stdout); }
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// ESP.get* reports the host process as one flat heap with no PSRAM
+class EspClass {
+public:
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap() { return getFreeHeap(); }
+    uint32_t getMaxAllocHeap() { return getFreeHeap(); }
+    uint32_t getPsramSize() { return 0; }
+    uint32_t getFreePsram() { return 0; }
+    uint32_t getMinFreePsram() { return 0; }
+    uint32_t getMaxAllocPsram() { return 0; }
+    uint32_t getCpuFreqMHz() { return 0; }
+    const char* getChipModel() { return "host"; }
+    uint8_t getChipRevision() { return 0; }
+    uint32_t getFlashChipSize() { return 0; }
+    void restart() { exit(0); }
+};
+
+extern EspClass ESP;
+
+inline bool psramFound() { return false; }
+inline uint32_t getCpuFreqMHz() { return 0; }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef SDM_HOST_SD_H
+#define SDM_HOST_SD_H
+
+#include <FS.h>
+
+#define CARD_NONE 0
+#define CARD_SD   2
+
+// SD card backed by the host directory from sdmHostSetRoot()
+class SDFS : public fs::FS {
+public:
+    bool begin(uint8_t ssPin = 0);
+    void end() {}
+    uint8_t cardType() { return CARD_SD; }
+    uint64_t cardSize() { return 0; }
+    uint64_t totalBytes() { return 0; }
+    uint64_t usedBytes() { return 0; }
+};
+
+extern SDFS SD;
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef SDM_HOST_ESP_HEAP_CAPS_H
+#define SDM_HOST_ESP_HEAP_CAPS_H
+
+// heap_caps_* on the host: every capability is served by the process heap.
+// There is no PSRAM, and free sizes report what the native build may use.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+
+void* heap_caps_malloc(size_t size, uint32_t caps);
+void* heap_caps_aligned_calloc(size_t alignment, size_t n, size_t size, uint32_t caps);
+void heap_caps_free(void* ptr);
+
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+#endif
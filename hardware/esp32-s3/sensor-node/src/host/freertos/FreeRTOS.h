@@ -0,0 +1,25 @@
+#ifndef SDM_HOST_FREERTOS_H
+#define SDM_HOST_FREERTOS_H
+
+// The FreeRTOS task and semaphore calls the SDM engine makes, on top of
+// std::thread for the native build. Ticks are milliseconds; priorities and
+// core affinity are accepted and ignored.
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdFAIL  0
+#define pdPASS  1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef SDM_HOST_FREERTOS_QUEUE_H
+#define SDM_HOST_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+
+// Fixed-size items copied in and out, FIFO
+typedef struct SDMHostQueue* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef SDM_HOST_FREERTOS_TASK_H
+#define SDM_HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef struct SDMHostTask* TaskHandle_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                                   void* parameter, UBaseType_t priority, TaskHandle_t* created, BaseType_t core);
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                       void* parameter, UBaseType_t priority, TaskHandle_t* created);
+
+// vTaskDelete(nullptr) ends the calling task and does not return; deleting
+// another task is not supported (the engine's tasks always delete themselves)
+void vTaskDelete(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+BaseType_t xPortGetCoreID();
+
+#endif
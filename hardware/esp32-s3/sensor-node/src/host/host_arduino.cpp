@@ -0,0 +1,134 @@
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <chrono>
+#include <random>
+#include <thread>
+
+// Budget reported as free heap, so fitsInMemory() and the benchmarks size
+// configurations as they would on a board with this much RAM
+#ifndef SDM_HOST_HEAP_BYTES
+#define SDM_HOST_HEAP_BYTES (256u * 1024u * 1024u)
+#endif
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static const std::chrono::steady_clock::time_point boot_time = std::chrono::steady_clock::now();
+static std::mt19937 random_engine(0x5DC0FFEE);
+
+String::String(double value, unsigned int decimals) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", static_cast<int>(decimals), value);
+    assign(buffer);
+}
+
+void String::trim() {
+    size_t begin = find_first_not_of(" \t\r\n");
+    if (begin == npos) {
+        clear();
+        return;
+    }
+    size_t end = find_last_not_of(" \t\r\n");
+    assign(substr(begin, end - begin + 1));
+}
+
+void String::replace(const String& from, const String& to) {
+    if (from.empty()) return;
+    for (size_t pos = find(from); pos != npos; pos = find(from, pos + to.size())) {
+        std::string::replace(pos, from.size(), to);
+    }
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) return 0;
+    if (static_cast<size_t>(length) < sizeof(buffer)) {
+        return write(reinterpret_cast<const uint8_t*>(buffer), length);
+    }
+
+    std::string large(length + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&large[0], large.size(), format, args);
+    va_end(args);
+    return write(reinterpret_cast<const uint8_t*>(large.data()), length);
+}
+
+String Stream::readString() {
+    String result;
+    for (int c = read(); c >= 0; c = read()) {
+        result += static_cast<char>(c);
+    }
+    return result;
+}
+
+String Stream::readStringUntil(char terminator) {
+    String result;
+    for (int c = read(); c >= 0 && c != terminator; c = read()) {
+        result += static_cast<char>(c);
+    }
+    return result;
+}
+
+uint32_t EspClass::getHeapSize() { return SDM_HOST_HEAP_BYTES; }
+uint32_t EspClass::getFreeHeap() { return SDM_HOST_HEAP_BYTES; }
+
+unsigned long millis() {
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - boot_time).count());
+}
+
+unsigned long micros() {
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - boot_time).count());
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+long random(long max) {
+    if (max <= 0) return 0;
+    return std::uniform_int_distribution<long>(0, max - 1)(random_engine);
+}
+
+long random(long min, long max) {
+    if (min >= max) return min;
+    return min + random(max - min);
+}
+
+void randomSeed(unsigned long seed) {
+    random_engine.seed(static_cast<uint32_t>(seed));
+}
+
+void* heap_caps_malloc(size_t size, uint32_t) {
+    return malloc(size);
+}
+
+void* heap_caps_aligned_calloc(size_t alignment, size_t n, size_t size, uint32_t) {
+    // aligned_alloc() wants the size to be a multiple of the alignment
+    size_t bytes = n * size;
+    size_t rounded = (bytes + alignment - 1) / alignment * alignment;
+    void* ptr = aligned_alloc(alignment, rounded ? rounded : alignment);
+    if (ptr) memset(ptr, 0, rounded);
+    return ptr;
+}
+
+void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? 0 : SDM_HOST_HEAP_BYTES;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
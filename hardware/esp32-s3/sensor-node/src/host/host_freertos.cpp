@@ -0,0 +1,190 @@
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct SDMHostSemaphore {
+    std::mutex lock;
+    std::condition_variable changed;
+    UBaseType_t count = 0;
+    UBaseType_t max_count = 1;
+};
+
+struct SDMHostQueue {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length = 0;
+    UBaseType_t item_size = 0;
+};
+
+struct SDMHostTask {
+    SDMHostSemaphore notify;  // The task's notification value, as a counting semaphore
+};
+
+namespace {
+
+// Thrown by vTaskDelete(nullptr) to unwind out of the task function
+struct TaskExit {};
+
+thread_local SDMHostTask* current_task = nullptr;
+
+BaseType_t take(SDMHostSemaphore* semaphore, TickType_t ticks_to_wait, bool take_all, uint32_t* taken) {
+    std::unique_lock<std::mutex> guard(semaphore->lock);
+    auto ready = [semaphore] { return semaphore->count > 0; };
+    if (ticks_to_wait == portMAX_DELAY) {
+        semaphore->changed.wait(guard, ready);
+    } else if (!semaphore->changed.wait_for(guard, std::chrono::milliseconds(ticks_to_wait), ready)) {
+        if (taken) *taken = 0;
+        return pdFALSE;
+    }
+    if (taken) *taken = semaphore->count;
+    semaphore->count = take_all ? 0 : semaphore->count - 1;
+    return pdTRUE;
+}
+
+BaseType_t give(SDMHostSemaphore* semaphore) {
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    if (semaphore->count >= semaphore->max_count) return pdFALSE;
+    semaphore->count++;
+    semaphore->changed.notify_all();
+    return pdTRUE;
+}
+
+// Wait until ready() or the timeout; the caller holds guard
+template <typename Ready>
+bool waitFor(std::condition_variable& changed, std::unique_lock<std::mutex>& guard, TickType_t ticks_to_wait,
+             Ready ready) {
+    if (ticks_to_wait == portMAX_DELAY) {
+        changed.wait(guard, ready);
+        return true;
+    }
+    return changed.wait_for(guard, std::chrono::milliseconds(ticks_to_wait), ready);
+}
+
+} // namespace
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char*, uint32_t, void* parameter,
+                                   UBaseType_t, TaskHandle_t* created, BaseType_t) {
+    SDMHostTask* task = new SDMHostTask;
+    task->notify.max_count = 0xFFFFFFFFu;
+    if (created) *created = task;
+
+    std::thread([task, function, parameter] {
+        current_task = task;
+        try {
+            function(parameter);
+        } catch (const TaskExit&) {
+        }
+        delete task;
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                       void* parameter, UBaseType_t priority, TaskHandle_t* created) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, parameter, priority, created, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == nullptr || task == current_task) throw TaskExit();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return current_task;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+    give(&task->notify);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    uint32_t value = 0;
+    if (current_task) take(&current_task->notify, ticks_to_wait, clear_on_exit != pdFALSE, &value);
+    return value;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+TickType_t xTaskGetTickCount() {
+    return static_cast<TickType_t>(millis());
+}
+
+BaseType_t xPortGetCoreID() {
+    return 0;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    SDMHostSemaphore* semaphore = new SDMHostSemaphore;
+    semaphore->max_count = max_count;
+    semaphore->count = initial_count;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+    return take(semaphore, ticks_to_wait, false, nullptr);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return give(semaphore);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    SDMHostQueue* queue = new SDMHostQueue;
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    if (!waitFor(queue->changed, guard, ticks_to_wait, [queue] { return queue->items.size() < queue->length; })) {
+        return pdFALSE;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(bytes, bytes + queue->item_size);
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    if (!waitFor(queue->changed, guard, ticks_to_wait, [queue] { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return static_cast<UBaseType_t>(queue->items.size());
+}
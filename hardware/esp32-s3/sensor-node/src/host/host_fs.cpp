@@ -0,0 +1,196 @@
+#include <SD.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SDFS SD;
+
+static String host_root;
+
+void sdmHostSetRoot(const String& directory) {
+    host_root = directory;
+    while (host_root.length() > 1 && host_root.endsWith("/")) {
+        host_root.remove(host_root.length() - 1);
+    }
+}
+
+String sdmHostPath(const char* path) {
+    if (host_root.isEmpty()) {
+        const char* env = getenv("SDM_SD_ROOT");
+        sdmHostSetRoot(env && *env ? env : "./sd");
+    }
+    String card_path = path ? path : "";
+    if (!card_path.startsWith("/")) card_path = "/" + card_path;
+    // A root of "/" makes card paths plain host paths
+    return host_root == "/" ? card_path : host_root + card_path;
+}
+
+bool SDFS::begin(uint8_t) {
+    // The root directory is the "card"; create it on first use
+    String root = sdmHostPath("/");
+    struct stat st;
+    return stat(root.c_str(), &st) == 0 ? S_ISDIR(st.st_mode) : ::mkdir(root.c_str(), 0755) == 0;
+}
+
+namespace fs {
+
+struct FileImpl {
+    FILE* fp = nullptr;
+    DIR* dir = nullptr;
+    String path;  // Card path, as passed to open()
+    String name;  // Last path component
+
+    ~FileImpl() {
+        if (fp) fclose(fp);
+        if (dir) closedir(dir);
+    }
+};
+
+size_t File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    return (impl && impl->fp) ? fwrite(buffer, 1, size, impl->fp) : 0;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    return (impl && impl->fp) ? fread(buffer, 1, size, impl->fp) : 0;
+}
+
+int File::read() {
+    if (!impl || !impl->fp) return -1;
+    int c = fgetc(impl->fp);
+    return c == EOF ? -1 : c;
+}
+
+int File::peek() {
+    if (!impl || !impl->fp) return -1;
+    int c = fgetc(impl->fp);
+    if (c == EOF) return -1;
+    ungetc(c, impl->fp);
+    return c;
+}
+
+int File::available() {
+    if (!impl || !impl->fp) return 0;
+    size_t pos = position();
+    size_t total = size();
+    return total > pos ? static_cast<int>(total - pos) : 0;
+}
+
+void File::flush() {
+    if (impl && impl->fp) fflush(impl->fp);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!impl || !impl->fp) return false;
+    int whence = mode == SeekCur ? SEEK_CUR : (mode == SeekEnd ? SEEK_END : SEEK_SET);
+    return fseek(impl->fp, pos, whence) == 0;
+}
+
+size_t File::position() const {
+    if (!impl || !impl->fp) return 0;
+    long pos = ftell(impl->fp);
+    return pos < 0 ? 0 : static_cast<size_t>(pos);
+}
+
+size_t File::size() const {
+    if (!impl || !impl->fp) return 0;
+    // Seek rather than fstat() so writes still in the stdio buffer count
+    long pos = ftell(impl->fp);
+    if (pos < 0 || fseek(impl->fp, 0, SEEK_END) != 0) return 0;
+    long end = ftell(impl->fp);
+    fseek(impl->fp, pos, SEEK_SET);
+    return end < 0 ? 0 : static_cast<size_t>(end);
+}
+
+void File::close() {
+    impl.reset();
+}
+
+File::operator bool() const {
+    return impl && (impl->fp || impl->dir);
+}
+
+const char* File::name() const {
+    return impl ? impl->name.c_str() : "";
+}
+
+const char* File::path() const {
+    return impl ? impl->path.c_str() : "";
+}
+
+bool File::isDirectory() const {
+    return impl && impl->dir;
+}
+
+File File::openNextFile() {
+    if (!impl || !impl->dir) return File();
+    while (struct dirent* entry = readdir(impl->dir)) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        String child = impl->path.endsWith("/") ? impl->path + entry->d_name : impl->path + "/" + entry->d_name;
+        return SD.open(child);
+    }
+    return File();
+}
+
+void File::rewindDirectory() {
+    if (impl && impl->dir) rewinddir(impl->dir);
+}
+
+static bool makeParents(const String& host_path) {
+    for (int slash = host_path.indexOf('/', 1); slash > 0; slash = host_path.indexOf('/', slash + 1)) {
+        String parent = host_path.substring(0, slash);
+        struct stat st;
+        if (stat(parent.c_str(), &st) != 0 && ::mkdir(parent.c_str(), 0755) != 0) return false;
+    }
+    return true;
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+    String host_path = sdmHostPath(path);
+    auto impl = std::make_shared<FileImpl>();
+    impl->path = path;
+    int slash = impl->path.lastIndexOf('/');
+    impl->name = slash >= 0 ? impl->path.substring(slash + 1) : impl->path;
+
+    struct stat st;
+    if (stat(host_path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        impl->dir = opendir(host_path.c_str());
+        return impl->dir ? File(impl) : File();
+    }
+
+    if (create && mode[0] != 'r' && !makeParents(host_path)) return File();
+
+    // Binary mode; "r+" is used to patch images in place
+    String host_mode = String(mode) + "b";
+    impl->fp = fopen(host_path.c_str(), host_mode.c_str());
+    return impl->fp ? File(impl) : File();
+}
+
+bool FS::exists(const char* path) {
+    struct stat st;
+    return stat(sdmHostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path) {
+    return unlink(sdmHostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+    // FAT refuses to replace an existing file; keep that behaviour so renames
+    // that only work on the host can't slip in
+    if (exists(to)) return false;
+    return ::rename(sdmHostPath(from).c_str(), sdmHostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+    return ::mkdir(sdmHostPath(path).c_str(), 0755) == 0;
+}
+
+bool FS::rmdir(const char* path) {
+    return ::rmdir(sdmHostPath(path).c_str()) == 0;
+}
+
+} // namespace fs
@@ -0,0 +1,116 @@
+// Native throughput benchmark: runs SDMPerfHarness over a grid of
+// configurations on the host and writes one CSV with every phase.
+//
+//   pio run -e native && .pio/build/native/program [options]
+//
+//   --dims 128,256,1024      vector dimensions
+//   --locations 1000,10000   hard locations (at most 65535)
+//   --bits 16,8,4            counter widths
+//   --radius 0.05            access radius as a fraction of vector_dim; by default
+//                            locations must share more bits with the query than
+//                            two random sparse vectors would on average
+//   --iterations 128         timed iterations per phase (--warmup for untimed)
+//   --dense / --no-index / --dual   sparse_addresses off, use_index off, dual_core on
+//   --sd DIR                 directory standing in for the SD card (default ./sd)
+//   --csv PATH               card path of the results (default /sdm_native_perf.csv)
+
+#include <Arduino.h>
+#include <SD.h>
+#include "sdm/sdm_perf.h"
+
+namespace {
+
+std::vector<uint16_t> parseList(const char* text) {
+    std::vector<uint16_t> values;
+    String list = text;
+    int begin = 0;
+    while (begin < static_cast<int>(list.length())) {
+        int comma = list.indexOf(',', begin);
+        if (comma < 0) comma = list.length();
+        long value = list.substring(begin, comma).toInt();
+        if (value > 0 && value <= 0xFFFF) values.push_back(static_cast<uint16_t>(value));
+        begin = comma + 1;
+    }
+    return values;
+}
+
+// Addresses and queries both have `ones` set bits, so distance = 2 * (ones - overlap)
+uint16_t defaultRadius(const SDMConfig& config) {
+    uint32_t ones = std::max<uint32_t>(1, static_cast<uint32_t>(config.vector_dim * config.sparsity));
+    uint32_t chance = (2 * ones * ones + config.vector_dim) / (2 * config.vector_dim);
+    uint32_t min_overlap = std::min(ones, chance + 1);
+    return static_cast<uint16_t>(std::max<uint32_t>(1, 2 * (ones - min_overlap)));
+}
+
+void usage(const char* program) {
+    Serial.printf("usage: %s [--dims a,b] [--locations a,b] [--bits 16,8,4] [--radius f] "
+                  "[--iterations n] [--warmup n] [--dense] [--no-index] [--dual] [--sd dir] [--csv path]\n",
+                  program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<uint16_t> dims = {128, 256, 1024};
+    std::vector<uint16_t> locations = {1000, 10000, 60000};
+    std::vector<uint16_t> bits = {16, 8, 4};
+    float radius_factor = 0.0f;
+    SDMConfig base;
+    base.persistent = false;
+    base.sparse_addresses = true;
+    SDMPerfHarness harness;
+    String csv_path = "/sdm_native_perf.csv";
+
+    for (int i = 1; i < argc; i++) {
+        String arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--dims" && has_value) dims = parseList(argv[++i]);
+        else if (arg == "--locations" && has_value) locations = parseList(argv[++i]);
+        else if (arg == "--bits" && has_value) bits = parseList(argv[++i]);
+        else if (arg == "--radius" && has_value) radius_factor = String(argv[++i]).toFloat();
+        else if (arg == "--iterations" && has_value) harness.iterations = String(argv[++i]).toInt();
+        else if (arg == "--warmup" && has_value) harness.warmup = String(argv[++i]).toInt();
+        else if (arg == "--dense") base.sparse_addresses = false;
+        else if (arg == "--no-index") base.use_index = false;
+        else if (arg == "--dual") base.dual_core = true;
+        else if (arg == "--sd" && has_value) sdmHostSetRoot(argv[++i]);
+        else if (arg == "--csv" && has_value) csv_path = argv[++i];
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (dims.empty() || locations.empty() || bits.empty() || harness.iterations == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Serial.printf("SDM native benchmark (%s kernels)\n",
+                  SDM_USE_AVX2 ? "AVX2" : (SDM_USE_NEON ? "NEON" : "portable"));
+    uint16_t failed = 0;
+    for (uint16_t dim : dims) {
+        for (uint16_t count : locations) {
+            for (uint16_t counter_bits : bits) {
+                SDMConfig config = base;
+                config.vector_dim = dim;
+                config.num_locations = count;
+                config.access_radius = radius_factor > 0.0f
+                    ? std::max<uint16_t>(1, static_cast<uint16_t>(dim * radius_factor))
+                    : defaultRadius(config);
+                config.counter_bits = static_cast<uint8_t>(counter_bits);
+                if (!harness.run(config)) {
+                    Serial.printf("Failed: dim %u, %u locations, %u-bit counters\n", dim, count, counter_bits);
+                    failed++;
+                }
+            }
+        }
+    }
+
+    harness.print();
+    if (!SD.begin() || !harness.saveCSV(csv_path)) {
+        Serial.printf("Could not write %s\n", sdmHostPath(csv_path.c_str()).c_str());
+        return 1;
+    }
+    Serial.printf("Results written to %s\n", sdmHostPath(csv_path.c_str()).c_str());
+    return failed ? 1 : 0;
+}
@@ -8,7 +8,11 @@
 #include <SPI.h>
 #include <ArduinoJson.h>
 #include "secrets.h"  // Include WiFi credentials
+#include "config.h"
 #include "sdm/sdm.h"      // Include SDM functionality
+#include "sdm/sdm_vision.h"  // Camera frames -> SDM vectors
+#include "sdm/sdm_protocol.h"  // Line commands and binary frames on Serial
+#include "sdm/sdm_net.h"       // The same frames over UDP
 
 // WiFi credentials from secrets.h (your existing working approach)
 const char* ssid = WIFI_SSID;
@@ -24,6 +28,43 @@ bool wifiConnected = false;
 SparseDistributedMemory* sdm = nullptr;
 SDMEncoder* encoder = nullptr;
 SDMBenchmark* benchmark = nullptr;
+SDMStreamEncoder* stream = nullptr;  // Sliding window over SDM_STREAM samples
+// Packed query/recall buffers for the serial commands, sized once the SDM is up
+std::vector<uint32_t> sdm_query;
+std::vector<uint32_t> sdm_recall;
+// Labels DECODE resolves recalls to, loaded from a pretrained library
+SDMCleanupMemory cleanup_memory;
+#define SDM_CLEANUP_LIBRARY "common_words"
+
+// Network requests run on the service's own task; everything else that calls
+// into sdm holds sdm_lock as well
+SemaphoreHandle_t sdm_lock = nullptr;
+SDMNetService net_service;
+
+void lockSDM() {
+  if (sdm_lock) xSemaphoreTake(sdm_lock, portMAX_DELAY);
+}
+
+void unlockSDM() {
+  if (sdm_lock) xSemaphoreGive(sdm_lock);
+}
+
+// Serial input: text commands line by line, bulk vectors and library uploads as frames
+SDMProtocol serial_link(Serial);
+SDMLibraryUpload library_upload;
+
+// Binary telemetry frames (sdm_telemetry.h) every telemetry_period_ms, 0 = off;
+// over serial unless a UDP target is set
+uint32_t telemetry_period_ms = 0;
+uint32_t last_telemetry_ms = 0;
+WiFiUDP telemetry_udp;
+IPAddress telemetry_host;
+uint16_t telemetry_port = 0;
+
+// Vision pipeline: encodes camera frames on core 0 while loop() runs
+CameraModule camera;
+VisionPipeline vision(&camera);
+uint32_t vision_seen = 0;
 
 void setupWiFi() {
   Serial.println("Connecting to WiFi...");
@@ -188,6 +229,9 @@ void testSDCard() {
       Serial.println(CS_PINS[i]);
       sdInitialized = true;
       testSDOperations();
+      // Checkpoint journals, stats and CSV logs are written from here on by
+      // their own task on core 0, away from the loop on core 1
+      sdmWriter().begin(0);
       return;
     }
     delay(100);
@@ -225,13 +269,31 @@ void initializeSDM() {
   
   // Initialize encoder
   encoder = new SDMEncoder(sdm);
+  stream = new SDMStreamEncoder(sdm, encoder->sequenceLength(), 8);  // Store the window every 8 samples
+  sdm_query.assign(sdm->wordsPerVector(), 0);
+  sdm_recall.assign(sdm->wordsPerVector(), 0);
+  
+  // Decode on-device against the default library when it is on the card
+  if (SD.exists("/lib/" SDM_CLEANUP_LIBRARY "/vectors.bin") &&
+      cleanup_memory.loadLibrary(sdm, SDM_CLEANUP_LIBRARY)) {
+    encoder->setCleanupMemory(&cleanup_memory, sdm->config.vector_dim / 4);
+  }
+  
+  sdm_lock = xSemaphoreCreateMutex();
   
   Serial.println("SDM system initialized successfully");
   sdm->printMemoryUsage();
 }
 
+void startNetService() {
+  if (!sdm || !wifiConnected || net_service.running()) return;
+  if (!net_service.begin(sdm, sdm_lock)) {
+    Serial.println("Failed to start SDM network service");
+  }
+}
+
 void setup() {
-  Serial.begin(9600);
+  Serial.begin(SERIAL_BAUD);
   delay(1000);
   Serial.println("ESP32-S3 Device Ready with OTA and SDM");
   
@@ -246,6 +308,7 @@ void setup() {
   
   // Initialize SDM system
   initializeSDM();
+  startNetService();
   
   Serial.println("Setup complete!");
   if (wifiConnected) {
@@ -256,6 +319,19 @@ void setup() {
   }
 }
 
+void sendTelemetry() {
+  SDMTelemetryFrame frame;
+  sdm->telemetryFrame(frame);
+  if (telemetry_port) {
+    if (!wifiConnected) return;
+    telemetry_udp.beginPacket(telemetry_host, telemetry_port);
+    sdmSendTelemetry(telemetry_udp, frame);
+    telemetry_udp.endPacket();
+  } else {
+    sdmSendTelemetry(Serial, frame);
+  }
+}
+
 void processSDMCommands(String command) {
   if (!sdm) {
     Serial.println("SDM not initialized");
@@ -265,25 +341,52 @@ void processSDMCommands(String command) {
   commandUpper.toUpperCase();
   if (command.startsWith("ENCODE ")) {
     String text = command.substring(7);
-    auto encoded = encoder->encodeText(text);
+    encoder->encodeText(text, sdm_query.data());
     
     // Store in SDM
-    uint16_t activated = sdm->write(encoded, 5); // Strong reinforcement
+    uint16_t activated = sdm->write(sdm_query.data(), 5); // Strong reinforcement
     Serial.printf("Encoded '%s' -> %d activated locations\n", text.c_str(), activated);
-    
-    // Save to SD card
-    sdm->saveToSD();
+    // Persisted by the checkpoint policy in loop(), not per write
     
   } else if (command.startsWith("DECODE ")) {
     String text = command.substring(7);
-    auto encoded = encoder->encodeText(text);
+    encoder->encodeText(text, sdm_query.data());
     
     // Try to recall from SDM
-    auto [decoded, confidence] = sdm->read(encoded);
-    String result = encoder->decodeText(decoded);
+    float confidence = sdm->read(sdm_query.data(), sdm_recall.data());
+    String result = encoder->decodeText(sdm_recall.data());
     
     Serial.printf("Decoded '%s' -> '%s' (confidence: %.2f)\n", 
-                  text.c_str(), result.c_str(), confidence);
+                  text.c_str(), result.length() ? result.c_str() : "<no match>", confidence);
+    
+  } else if (command.startsWith("SDM_STREAM ")) {
+    // Space-separated samples in [-1, 1], e.g. from a host-side sensor log
+    String samples = command.substring(11);
+    uint16_t pushed = 0, written = 0;
+    int start = 0;
+    while (start < (int)samples.length()) {
+      int end = samples.indexOf(' ', start);
+      if (end < 0) end = samples.length();
+      if (end > start) {
+        pushed++;
+        if (stream->push(samples.substring(start, end).toFloat())) {
+          stream->writeWindow();
+          written++;
+        }
+      }
+      start = end + 1;
+    }
+    Serial.printf("Streamed %d samples, %d window writes\n", pushed, written);
+    
+  } else if (command.startsWith("SDM_CLEANUP ")) {
+    String lib_name = command.substring(12);
+    lib_name.toLowerCase();  // Commands arrive upper-cased; library directories are lower case
+    if (cleanup_memory.loadLibrary(sdm, lib_name)) {
+      encoder->setCleanupMemory(&cleanup_memory, sdm->config.vector_dim / 4);
+      Serial.printf("DECODE now resolves against '%s'\n", lib_name.c_str());
+    } else {
+      Serial.println("Failed to load cleanup library");
+    }
     
   } else if (command == "SDM_STATS") {
     SDMStats stats = sdm->getStats();
@@ -292,6 +395,45 @@ void processSDMCommands(String command) {
     Serial.printf("Total reads: %d\n", stats.total_reads);
     Serial.printf("Last confidence: %.2f\n", stats.last_confidence);
     Serial.printf("Last activated locations: %d\n", stats.last_activated_locations);
+    if (sdm->config.target_activations) {
+      Serial.printf("Activation: %d nearest, last radius %d\n", sdm->config.target_activations, stats.last_radius);
+    }
+    Serial.printf("Unsaved rows: %d\n", sdm->dirtyRowCount());
+    Serial.printf("SD writer: %u jobs queued, %u failed%s\n", (unsigned)sdmWriter().pending(),
+                  (unsigned)sdmWriter().failures(), sdm->checkpointInFlight() ? ", checkpoint in flight" : "");
+    
+  } else if (command.startsWith("SDM_TELEMETRY ")) {
+    // Frame period in ms over serial, 0 stops
+    telemetry_period_ms = command.substring(14).toInt();
+    telemetry_port = 0;
+    Serial.printf("Telemetry %s\n", telemetry_period_ms ? "streaming on serial" : "off");
+    
+  } else if (command.startsWith("SDM_TELEMETRY_UDP ")) {
+    // <ip> <port> [period ms, default 1000]
+    String args = command.substring(18);
+    int port_at = args.indexOf(' ');
+    int period_at = port_at < 0 ? -1 : args.indexOf(' ', port_at + 1);
+    IPAddress host;
+    if (port_at < 0 || !host.fromString(args.substring(0, port_at))) {
+      Serial.println("Usage: SDM_TELEMETRY_UDP <ip> <port> [period_ms]");
+      return;
+    }
+    telemetry_host = host;
+    telemetry_port = period_at < 0 ? args.substring(port_at + 1).toInt() : args.substring(port_at + 1, period_at).toInt();
+    telemetry_period_ms = period_at < 0 ? 1000 : args.substring(period_at + 1).toInt();
+    Serial.printf("Telemetry to %s:%u every %u ms\n", host.toString().c_str(), telemetry_port, telemetry_period_ms);
+    
+  } else if (command == "SDM_NET") {
+    if (net_service.running()) {
+      Serial.printf("SDM network service on %s:%u: %u served, %u dropped\n", WiFi.localIP().toString().c_str(),
+                    SDM_NET_PORT, net_service.served(), net_service.dropped());
+    } else {
+      Serial.println("SDM network service not running");
+    }
+    
+  } else if (command == "SDM_TELEMETRY_RESET") {
+    sdm->resetTelemetry();
+    Serial.println("Telemetry counters reset");
     
   } else if (command == "SDM_SAVE") {
     if (sdm->saveToSD()) {
@@ -307,6 +449,56 @@ void processSDMCommands(String command) {
       Serial.println("Failed to load SDM");
     }
     
+  } else if (command.startsWith("SDM_TARGET ")) {
+    // k nearest locations per op, 0 returns to the configured access_radius; SDM_SAVE keeps it
+    sdm->config.target_activations = command.substring(11).toInt();
+    if (sdm->config.target_activations) {
+      Serial.printf("Activating the %d nearest locations per op\n", sdm->config.target_activations);
+    } else {
+      Serial.printf("Activating within radius %d\n", sdm->config.access_radius);
+    }
+    
+  } else if (command == "SDM_BALANCE") {
+    SDMBalanceReport report = sdm->balanceReport();
+    Serial.printf("Access counts: mean %.1f, max %u\n", report.mean_access_count, report.max_access_count);
+    Serial.printf("Cold %u, hot %u, saturated %u, relocated %u of %u locations\n", report.cold_locations,
+                  report.hot_locations, report.saturated_locations, report.relocated_locations, sdm->config.num_locations);
+    
+  } else if (command == "SDM_REBALANCE" || command.startsWith("SDM_REBALANCE ")) {
+    // [max moves, default 16]
+    int moves = command.length() > 14 ? command.substring(14).toInt() : 16;
+    if (sdm->isPaged()) {
+      Serial.println("Rebalancing needs the whole counter arena in memory");
+    } else {
+      Serial.printf("Moved %u locations\n", sdm->rebalance(moves > 0 ? moves : 16));
+    }
+    
+  } else if (command.startsWith("SDM_DELTA_EXPORT ")) {
+    // <path> [RAW]; the backend merges deltas across nodes (backend/core/sdm/delta.py)
+    String path = command.substring(17);
+    path.trim();
+    SDMDeltaEncoding encoding = SDM_DELTA_VARINT;
+    if (path.endsWith(" RAW")) {
+      encoding = SDM_DELTA_RAW;
+      path = path.substring(0, path.length() - 4);
+    }
+    path.toLowerCase();
+    if (sdm->exportDelta(path, encoding)) {
+      Serial.printf("SDM delta written to %s\n", path.c_str());
+    } else {
+      Serial.println("Failed to export SDM delta");
+    }
+    
+  } else if (command.startsWith("SDM_DELTA_IMPORT ")) {
+    String path = command.substring(17);
+    path.trim();
+    path.toLowerCase();
+    if (sdm->importDelta(path)) {
+      Serial.printf("SDM delta %s merged\n", path.c_str());
+    } else {
+      Serial.println("Failed to import SDM delta");
+    }
+    
   } else if (command == "BENCHMARK_QUICK") {
     if (benchmark && benchmark->runQuickBenchmark()) {
       Serial.println("Quick benchmark completed");
@@ -321,6 +513,13 @@ void processSDMCommands(String command) {
       Serial.println("Comprehensive benchmark failed");
     }
     
+  } else if (command == "BENCHMARK_PERF") {
+    if (benchmark && benchmark->runPerfBenchmark(sdm->config)) {
+      Serial.println("Phase timing completed");
+    } else {
+      Serial.println("Phase timing failed");
+    }
+    
   } else if (command == "BENCHMARK_MEMORY") {
     if (benchmark && benchmark->runMemoryConstraintTest()) {
       Serial.println("Memory constraint test completed");
@@ -330,14 +529,118 @@ void processSDMCommands(String command) {
   }
 }
 
+void processSDMFrame(const SDMFrame& frame) {
+  const uint8_t* p = frame.payload;
+  if (!sdm) {
+    serial_link.sendStatus(frame.type, frame.sequence, SDM_STATUS_NOT_READY);
+    return;
+  }
+  
+  // INFO, WRITE and READ are served like network requests
+  std::vector<uint8_t> reply;
+  if (sdmServeFrame(*sdm, frame, SDM_FRAME_MAX_PAYLOAD, reply)) {
+    serial_link.send(reply);
+    return;
+  }
+  
+  switch (frame.type) {
+    case SDM_FRAME_LIB_BEGIN: {
+      uint32_t file_bytes = frame.length > 4 ? p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24) : 0;
+      String lib_name;
+      for (uint16_t i = 4; i < frame.length; i++) lib_name += (char)p[i];
+      bool started = file_bytes && library_upload.begin(lib_name, file_bytes);
+      serial_link.sendStatus(frame.type, frame.sequence, started ? SDM_STATUS_OK : SDM_STATUS_BAD_REQUEST);
+      break;
+    }
+    
+    case SDM_FRAME_LIB_DATA: {
+      uint32_t offset = frame.length >= 4 ? p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24) : 0;
+      bool stored = frame.length >= 4 && library_upload.append(offset, p + 4, frame.length - 4);
+      serial_link.sendStatus(frame.type, frame.sequence, stored ? SDM_STATUS_OK : SDM_STATUS_IO_ERROR,
+                             library_upload.received());
+      break;
+    }
+    
+    case SDM_FRAME_LIB_END: {
+      uint32_t vectors = library_upload.commit(sdm->config.vector_dim);
+      serial_link.sendStatus(frame.type, frame.sequence, vectors ? SDM_STATUS_OK : SDM_STATUS_BAD_LIBRARY, vectors);
+      break;
+    }
+    
+    default:
+      serial_link.sendStatus(frame.type, frame.sequence, SDM_STATUS_BAD_REQUEST);
+      break;
+  }
+}
+
+void processVisionCommands(String command) {
+  if (command == "VISION_START") {
+    if (!sdm) {
+      Serial.println("SDM not initialized");
+      return;
+    }
+    VisionConfig vision_config;
+    lockSDM();
+    vision_config.vector_dim = sdm->config.vector_dim;
+    unlockSDM();
+    Serial.println(vision.begin(vision_config) ? "Vision pipeline running" : "Failed to start vision pipeline");
+    
+  } else if (command == "VISION_STOP") {
+    vision.end();
+    Serial.println("Vision pipeline stopped");
+    
+  } else if (command == "VISION_STATS") {
+    VisionStats stats = vision.getStats();
+    Serial.println("=== Vision Statistics ===");
+    Serial.printf("Running: %s\n", vision.running() ? "yes" : "no");
+    Serial.printf("Frames: %u (%u failed)\n", stats.frames, stats.failures);
+    Serial.printf("FPS: %.1f\n", stats.fps);
+    Serial.printf("Encode: %u us last, %u us avg\n", stats.last_encode_us, stats.avg_encode_us);
+    
+  } else if (command == "VISION_WRITE" || command == "VISION_READ") {
+    if (!sdm || !vision.running()) {
+      Serial.println("Vision pipeline not running");
+      return;
+    }
+    // Wait up to a second for a frame newer than the last one used, before
+    // taking sdm_lock so network requests aren't held up meanwhile
+    uint32_t start = millis();
+    bool fresh = false;
+    while (!(fresh = vision.latest(sdm_query.data(), &vision_seen)) && millis() - start < 1000) {
+      delay(1);
+    }
+    if (!fresh) {
+      Serial.println("No new frame");
+      return;
+    }
+    lockSDM();
+    if (command == "VISION_WRITE") {
+      uint16_t activated = sdm->write(sdm_query.data(), 5);
+      Serial.printf("Frame %u -> %d activated locations\n", vision_seen, activated);
+    } else {
+      float confidence = sdm->read(sdm_query.data(), sdm_recall.data());
+      uint16_t distance = SDMKernels::hammingDistance(sdm_query.data(), sdm_recall.data(), sdm->wordsPerVector());
+      Serial.printf("Frame %u -> recall distance %d (confidence: %.2f)\n", vision_seen, distance, confidence);
+    }
+    unlockSDM();
+  }
+}
+
 void loop() {
   // Handle OTA updates
   if (wifiConnected) {
     ArduinoOTA.handle();
   }
   
-  if (Serial.available()) {
-    String command = Serial.readString();
+  // Never blocks: a command or frame is handled as soon as it is complete
+  SDMProtocol::Event event = serial_link.poll();
+  if (event == SDMProtocol::EVENT_FRAME) {
+    lockSDM();
+    processSDMFrame(serial_link.frame());
+    unlockSDM();
+  }
+  if (event == SDMProtocol::EVENT_LINE) {
+    String command = serial_link.line();
     command.trim();
     command.toUpperCase();
     
@@ -368,6 +671,7 @@ void loop() {
       setupWiFi();
       if (wifiConnected) {
         setupOTA();
+        startNetService();
       }
     }
     else if (command == "SD") {
@@ -401,15 +705,40 @@ void loop() {
     }
     else if (command.startsWith("ENCODE ") || command.startsWith("DECODE ") || 
              command.startsWith("SDM_") || command.startsWith("BENCHMARK_")) {
+      lockSDM();
       processSDMCommands(command);
+      unlockSDM();
+    }
+    else if (command.startsWith("VISION_")) {
+      // Takes sdm_lock itself, only around SDM calls
+      processVisionCommands(command);
     }
     else {
       Serial.println("Commands: TEST, PING, IP, WIFI, SD, SDWRITE, SDLIST, RESTART");
-      Serial.println("SDM Commands: ENCODE <text>, DECODE <text>, SDM_STATS, SDM_SAVE, SDM_LOAD");
-      Serial.println("Benchmark: BENCHMARK_QUICK, BENCHMARK_FULL, BENCHMARK_MEMORY");
+      Serial.println("SDM Commands: ENCODE <text>, DECODE <text>, SDM_STATS, SDM_SAVE, SDM_LOAD, SDM_CLEANUP <lib>, SDM_STREAM <samples>");
+      Serial.println("Network: SDM_NET (UDP port " + String(SDM_NET_PORT) + ")");
+      Serial.println("Fleet merge: SDM_DELTA_EXPORT <path> [RAW], SDM_DELTA_IMPORT <path>");
+      Serial.println("Utilization: SDM_TARGET <k>, SDM_BALANCE, SDM_REBALANCE [n]");
+      Serial.println("Telemetry: SDM_TELEMETRY <ms>, SDM_TELEMETRY_UDP <ip> <port> [ms], SDM_TELEMETRY_RESET");
+      Serial.println("Benchmark: BENCHMARK_QUICK, BENCHMARK_FULL, BENCHMARK_MEMORY, BENCHMARK_PERF");
+      Serial.println("Vision: VISION_START, VISION_STOP, VISION_STATS, VISION_WRITE, VISION_READ");
     }
   }
   
+  // Journal dirty SDM rows when the checkpoint policy says so
+  if (sdm) {
+    lockSDM();
+    sdm->serviceCheckpoint();
+    unlockSDM();
+  }
+  
+  if (sdm && telemetry_period_ms && millis() - last_telemetry_ms >= telemetry_period_ms) {
+    lockSDM();
+    sendTelemetry();
+    unlockSDM();
+    last_telemetry_ms = millis();
+  }
+  
   // Send heartbeat every 10 seconds
   static unsigned long lastHeartbeat = 0;
   if (millis() - lastHeartbeat > 10000) {
@@ -426,5 +755,8 @@ void loop() {
     lastHeartbeat = millis();
   }
   
-  delay(100);
+  // Idle: give the other tasks a tick, but come straight back for queued input
+  if (event == SDMProtocol::EVENT_NONE) {
+    delay(1);
+  }
 }
\ No newline at end of file
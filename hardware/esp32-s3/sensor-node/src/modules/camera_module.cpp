@@ -8,6 +8,12 @@ CameraModule::CameraModule() {
 }
 
 bool CameraModule::init() {
+    return init(PIXFORMAT_JPEG, FRAMESIZE_QVGA, 1);
+}
+
+bool CameraModule::init(pixformat_t format, framesize_t size, uint8_t fb_count) {
+    if (isInitialized()) deinit();
+    
     // Configure camera
     config.ledc_channel = LEDC_CHANNEL_0;
     config.ledc_timer = LEDC_TIMER_0;
@@ -28,10 +34,13 @@ bool CameraModule::init() {
     config.pin_pwdn = -1;
     config.pin_reset = -1;
     config.xclk_freq_hz = CAM_XCLK_FREQ;
-    config.pixel_format = PIXFORMAT_JPEG;
-    config.frame_size = FRAMESIZE_QVGA;
+    config.pixel_format = format;
+    config.frame_size = size;
     config.jpeg_quality = 15;
-    config.fb_count = 1;
+    config.fb_count = fb_count;
+    config.fb_location = CAMERA_FB_IN_PSRAM;
+    // With several buffers, hand out the newest frame instead of a queued stale one
+    config.grab_mode = fb_count > 1 ? CAMERA_GRAB_LATEST : CAMERA_GRAB_WHEN_EMPTY;
 
     esp_err_t err = esp_camera_init(&config);
     
@@ -47,6 +56,12 @@ bool CameraModule::init() {
     }
 }
 
+void CameraModule::deinit() {
+    if (isInitialized()) esp_camera_deinit();
+    status = CAM_NOT_INITIALIZED;
+    sensor = nullptr;
+}
+
 bool CameraModule::isInitialized() {
     return status == CAM_INITIALIZED;
 }
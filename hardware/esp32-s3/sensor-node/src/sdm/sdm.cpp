@@ -1,7 +1,19 @@
 #include "sdm.h"
-#include <random>
 #include <algorithm>
 
+// Read weights are SDM_READ_WEIGHT_ONE / (1 + distance). The int32 accumulators
+// stay overflow-free while the sum of applied weights times INT16_MAX fits, so
+// once that budget is reached the accumulators and weights are halved.
+#define SDM_READ_WEIGHT_ONE 1024
+#define SDM_READ_WEIGHT_BUDGET (INT32_MAX / INT16_MAX)
+
+// Counter lanes per row: vector_dim rounded up so a row of counter_bits-wide
+// lanes fills whole 16-byte SIMD blocks (8, 16 or 32 lanes per block)
+static uint16_t counterStride(uint16_t vector_dim, uint8_t counter_bits) {
+    uint16_t lanes = 128 / counter_bits;
+    return (vector_dim + lanes - 1) / lanes * lanes;
+}
+
 SparseDistributedMemory::SparseDistributedMemory() {
     // Default constructor uses default config
 }
@@ -12,39 +24,152 @@ SparseDistributedMemory::SparseDistributedMemory(const SDMConfig& cfg) : config(
 
 SparseDistributedMemory::~SparseDistributedMemory() {
     // Save state before destruction
-    saveToSD();
+    if (counters && config.persistent) {
+        saveToSD();
+        sdmWriter().flush();
+    }
+    stopWorkers();
+    releaseCounters();
+}
+
+bool SparseDistributedMemory::allocateCounters() {
+    releaseCounters();
+    
+    // Paged mode only holds the page cache in the arena
+    size_t arena_bytes = paged ? static_cast<size_t>(config.cache_pages) * SDM_PAGE_ROWS * row_bytes
+                               : static_cast<size_t>(config.num_locations) * row_bytes;
+    counters = static_cast<uint8_t*>(sdmAllocArena(arena_bytes, config.use_psram, &counters_in_psram));
+    if (!counters) {
+        Serial.printf("Failed to allocate %u byte counter arena\n", (unsigned)arena_bytes);
+        return false;
+    }
+    
+    bool scratch_in_psram = false;
+    size_t scratch_cells = static_cast<size_t>(SDM_BATCH_MAX) * row_stride;
+    size_t accum_sets = config.dual_core ? SDM_SCAN_WORKERS : 1;
+    delta_rows = static_cast<uint8_t*>(sdmAllocArena(SDM_BATCH_MAX * deltaBytes(), false, &scratch_in_psram));
+    read_accum = static_cast<int32_t*>(sdmAllocArena(accum_sets * scratch_cells * sizeof(int32_t), false, &scratch_in_psram));
+    if (!delta_rows || !read_accum) {
+        Serial.println("Failed to allocate SDM scratch rows");
+        releaseCounters();
+        return false;
+    }
+    
+    if (paged) {
+        page_slots.assign(config.cache_pages, PageSlot());
+        page_to_slot.assign((config.num_locations + SDM_PAGE_ROWS - 1) / SDM_PAGE_ROWS, SDM_NO_PAGE);
+        page_spill.assign(row_bytes, 0);
+        page_clock = 0;
+    }
+    return true;
+}
+
+void SparseDistributedMemory::releaseCounters() {
+    closePagedImage();
+    page_slots.clear();
+    page_to_slot.clear();
+    page_spill.clear();
+    sdmFreeArena(counters);
+    sdmFreeArena(delta_rows);
+    sdmFreeArena(read_accum);
+    counters = nullptr;
+    delta_rows = nullptr;
+    read_accum = nullptr;
+    counters_in_psram = false;
 }
 
 bool SparseDistributedMemory::initialize() {
     Serial.println("Initializing SDM...");
     
     // Load config from SD card if available
-    loadConfig();
+    if (config.persistent) {
+        loadConfig();
+    }
     
     // Initialize memory structures
+    stopWorkers();
+    if (config.counter_bits != 16 && config.counter_bits != 8 && config.counter_bits != 4) {
+        Serial.printf("Unsupported counter width %d, using 16-bit counters\n", config.counter_bits);
+        config.counter_bits = 16;
+    }
+    words_per_vector = SDMKernels::wordsForDim(config.vector_dim);
+    row_stride = counterStride(config.vector_dim, config.counter_bits);
+    row_bytes = row_stride * config.counter_bits / 8;
+    
     addresses.clear();
-    memory.clear();
+    address_bits.clear();
     access_counts.clear();
+    dirty_rows.assign((config.num_locations + 31) / 32, 0);
+    sync_rows.assign(dirty_rows.size(), ~0u);
+    relocated_rows.assign(dirty_rows.size(), 0);
+    address_map_crc = 0;
+    pending_writes = 0;
+    image_on_card = false;
+    journal_bytes = 0;
+    
+    // Page only when the cache is smaller than the table
+    uint32_t total_pages = (config.num_locations + SDM_PAGE_ROWS - 1) / SDM_PAGE_ROWS;
+    paged = false;
+    releaseCounters();
+    paged = config.persistent && config.cache_pages > 0 && config.cache_pages < total_pages;
+    
+    if (!allocateCounters()) {
+        return false;
+    }
+    
+    uint16_t num_ones = static_cast<uint16_t>(config.vector_dim * config.sparsity);
+    sparse_mode = config.sparse_addresses && num_ones <= config.vector_dim / 2;
+    address_ones = num_ones;
     
-    addresses.resize(config.num_locations);
-    memory.resize(config.num_locations);
     access_counts.resize(config.num_locations, 0);
+    packed_scratch.assign(words_per_vector, 0);
+    rebuildWeightTable();
+    address_index.clear();
+    candidate_scratch.clear();
+    
+    // Derive sparse addresses (3% density as recommended) from the seed
+    if (sparse_mode) {
+        address_bits.resize(static_cast<size_t>(config.num_locations) * address_ones);
+        for (uint16_t i = 0; i < config.num_locations; i++) {
+            generateAddress(i, packed_scratch.data());
+            uint16_t* bits = &address_bits[static_cast<size_t>(i) * address_ones];
+            for (uint16_t w = 0, k = 0; w < words_per_vector; w++) {
+                for (uint32_t word = packed_scratch[w]; word; word &= word - 1) {
+                    bits[k++] = w * 32 + __builtin_ctz(word);
+                }
+            }
+        }
+    } else {
+        addresses.resize(static_cast<size_t>(config.num_locations) * words_per_vector, 0);
+        for (uint16_t i = 0; i < config.num_locations; i++) {
+            generateAddress(i, &addresses[i * words_per_vector]);
+        }
+    }
     
-    // Generate random sparse addresses
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    // Locations moved by rebalance() on an earlier run
+    if (config.persistent) {
+        loadAddressMap();
+    }
+    buildAddressIndex();
     
-    for (uint16_t i = 0; i < config.num_locations; i++) {
-        addresses[i].resize(config.vector_dim, 0);
-        memory[i].resize(config.vector_dim, 0);
-        
-        // Generate sparse address (3% density as recommended)
-        generateSparseVector(addresses[i], config.sparsity);
+    if (config.dual_core && paged) {
+        // Page faults from both cores would race on the cache and the image file
+        Serial.println("Paged memory uses the single-core scan");
+    } else if (config.dual_core && !startWorkers()) {
+        Serial.println("Failed to start scan workers, using single-core scan");
     }
     
     // Try to load existing memory from SD card
-    if (!loadMemoryFromSD()) {
-        Serial.println("No existing memory found, starting fresh");
+    if (config.persistent && !loadMemoryFromSD()) {
+        if (paged) {
+            if (!createPagedImage()) {
+                Serial.println("Failed to create paged memory image");
+                releaseCounters();
+                return false;
+            }
+        } else {
+            Serial.println("No existing memory found, starting fresh");
+        }
     }
     
     Serial.printf("SDM initialized: %d locations, %d dimensions\n", 
@@ -52,29 +177,48 @@ bool SparseDistributedMemory::initialize() {
     return true;
 }
 
-void SparseDistributedMemory::generateSparseVector(std::vector<uint8_t>& vector, float sparsity) {
-    std::fill(vector.begin(), vector.end(), 0);
+void SparseDistributedMemory::buildAddressIndex() {
+    // Index address bits when addresses are sparse enough for postings to be cheap
+    uint16_t num_ones = static_cast<uint16_t>(config.vector_dim * config.sparsity);
+    address_index.clear();
+    if (config.use_index && num_ones > 0 && num_ones * 8 <= config.vector_dim) {
+        if (sparse_mode) {
+            address_index.buildFromPositions(address_bits.data(), config.num_locations,
+                                             address_ones, config.vector_dim);
+        } else {
+            address_index.build(addresses.data(), config.num_locations, config.vector_dim);
+        }
+        candidate_scratch.resize(config.num_locations);
+    }
+}
+
+void SparseDistributedMemory::generateAddress(uint16_t location, uint32_t* packed) const {
+    std::fill(packed, packed + words_per_vector, 0);
     
-    uint16_t num_ones = static_cast<uint16_t>(config.vector_dim * sparsity);
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    uint16_t num_ones = static_cast<uint16_t>(config.vector_dim * config.sparsity);
+    uint64_t state = (static_cast<uint64_t>(config.seed) << 32) ^ (location * 0xD1B54A32D192ED03ull);
     
-    // Randomly select positions to set to 1
-    std::vector<uint16_t> indices(config.vector_dim);
-    std::iota(indices.begin(), indices.end(), 0);
-    std::shuffle(indices.begin(), indices.end(), gen);
+    // Dense addresses: start from all ones and clear the complement instead
+    bool invert = num_ones > config.vector_dim / 2;
+    uint16_t picks = invert ? config.vector_dim - num_ones : num_ones;
     
-    for (uint16_t i = 0; i < num_ones && i < indices.size(); i++) {
-        vector[indices[i]] = 1;
+    // Rejection-sample distinct positions; O(picks) expected since picks <= dim / 2
+    uint16_t placed = 0;
+    while (placed < picks) {
+        uint16_t bit = SDMKernels::reduceRange(static_cast<uint32_t>(SDMKernels::splitmix64(state)), config.vector_dim);
+        if (SDMKernels::testBit(packed, bit)) continue;
+        SDMKernels::setBit(packed, bit);
+        placed++;
     }
-}
-
-uint16_t SparseDistributedMemory::hammingDistance(const std::vector<uint8_t>& v1, const std::vector<uint8_t>& v2) {
-    uint16_t distance = 0;
-    for (size_t i = 0; i < v1.size() && i < v2.size(); i++) {
-        if (v1[i] != v2[i]) distance++;
+    
+    if (invert) {
+        for (uint16_t w = 0; w < words_per_vector; w++) {
+            packed[w] = ~packed[w];
+        }
+        if (config.vector_dim % 32) {
+            packed[words_per_vector - 1] &= (1u << (config.vector_dim % 32)) - 1;
+        }
     }
-    return distance;
 }
 
 uint16_t SparseDistributedMemory::write(const std::vector<uint8_t>& input_vector, uint8_t strength) {
@@ -83,32 +227,154 @@ uint16_t SparseDistributedMemory::write(const std::vector<uint8_t>& input_vector
         return 0;
     }
     
-    uint16_t activated_locations = 0;
+    SDMKernels::pack(input_vector.data(), config.vector_dim, packed_scratch.data());
+    return write(packed_scratch.data(), strength);
+}
+
+uint16_t SparseDistributedMemory::write(const uint32_t* packed_input, uint8_t strength) {
+    return static_cast<uint16_t>(writeChunk(packed_input, 1, strength));
+}
+
+uint32_t SparseDistributedMemory::writeBatch(const uint32_t* packed_inputs, uint16_t count, uint8_t strength) {
+    uint32_t activated_locations = 0;
+    for (uint16_t first = 0; first < count; first += SDM_BATCH_MAX) {
+        uint8_t chunk = static_cast<uint8_t>(std::min<uint16_t>(count - first, SDM_BATCH_MAX));
+        activated_locations += writeChunk(packed_inputs + static_cast<size_t>(first) * words_per_vector,
+                                          chunk, strength);
+    }
+    return activated_locations;
+}
+
+void SparseDistributedMemory::buildDeltaRows(const uint32_t* packed_inputs, uint8_t count, uint8_t strength) {
+    // Narrow counters clamp the step to what a single lane can hold
+    for (uint8_t v = 0; v < count; v++) {
+        const uint32_t* input = packed_inputs + static_cast<size_t>(v) * words_per_vector;
+        uint8_t* delta = delta_rows + v * deltaBytes();
+        if (config.counter_bits == 16) {
+            SDMKernels::buildDeltaRow(input, config.vector_dim, row_stride, strength, reinterpret_cast<int16_t*>(delta));
+        } else {
+            uint8_t limit = config.counter_bits == 8 ? INT8_MAX : 7;
+            SDMKernels::buildDeltaRow8(input, config.vector_dim, row_stride,
+                                       static_cast<int8_t>(std::min(strength, limit)), reinterpret_cast<int8_t*>(delta));
+        }
+    }
+}
+
+uint32_t SparseDistributedMemory::writeChunk(const uint32_t* packed_inputs, uint8_t count, uint8_t strength) {
+    uint32_t started_us = SDMTelemetry::start();
+    
+    // Expand the +/-strength delta row of each input once; scan ranges only read them
+    buildDeltaRows(packed_inputs, count, strength);
+    
+    ScanPartial partial;
+    uint16_t min_overlap[SDM_BATCH_MAX] = {};
+    stats.last_radius = config.access_radius;
+    if (config.target_activations) {
+        // The radius depends on the query, so neither the index nor the range split applies
+        writeNearest(packed_inputs, count, partial);
+    } else if (indexedScanApplies(packed_inputs, count, min_overlap)) {
+        writeIndexed(packed_inputs, count, min_overlap, partial);
+    } else if (workers_running) {
+        // Workers own disjoint location ranges, so rows need no locking
+        dispatchScan(SCAN_WRITE, packed_inputs, count);
+        partial = workers[0].partial;
+        for (uint8_t w = 1; w < SDM_SCAN_WORKERS; w++) {
+            for (uint8_t v = 0; v < count; v++) {
+                partial.activated[v] += workers[w].partial.activated[v];
+            }
+        }
+    } else {
+        writeRange(packed_inputs, count, 0, config.num_locations, partial);
+    }
+    
+    uint32_t total_activated = 0;
+    for (uint8_t v = 0; v < count; v++) {
+        total_activated += partial.activated[v];
+        telemetry.recordActivated(partial.activated[v]);
+    }
+    
+    stats.total_writes += count;
+    stats.last_activated_locations = partial.activated[count - 1];
+    
+    last_write_ms = millis();
+    if (pending_writes == 0) first_pending_ms = last_write_ms;
+    pending_writes += count;
+    
+    telemetry.record(SDM_OP_WRITE, started_us, count);
+    return total_activated;
+}
+
+void SparseDistributedMemory::writeRange(const uint32_t* packed_inputs, uint8_t count,
+                                         uint16_t begin, uint16_t end, ScanPartial& partial) {
+    std::fill(partial.activated, partial.activated + count, 0);
     
-    for (uint16_t i = 0; i < config.num_locations; i++) {
-        uint16_t dist = hammingDistance(input_vector, addresses[i]);
+    // Single pass: each block of locations is tested against every vector in the
+    // chunk and activated rows are updated immediately. Per row, updates still
+    // happen in input order.
+    for (uint16_t block = begin; block < end; block += SDM_SCAN_BLOCK) {
+        uint16_t block_end = std::min<uint32_t>(block + SDM_SCAN_BLOCK, end);
         
-        if (dist <= config.access_radius) {
-            activated_locations++;
-            access_counts[i]++;
+        for (uint8_t v = 0; v < count; v++) {
+            const uint32_t* input = packed_inputs + static_cast<size_t>(v) * words_per_vector;
+            const uint8_t* delta = deltaRow(v);
+            uint16_t input_weight = queryWeight(input);
             
-            // Update memory with reinforcement
-            for (uint16_t j = 0; j < config.vector_dim; j++) {
-                if (input_vector[j] == 1) {
-                    int32_t updated = memory[i][j] + strength;
-                    memory[i][j] = (updated > INT16_MAX) ? INT16_MAX : updated;
-                } else {
-                    int32_t updated = memory[i][j] - strength;
-                    memory[i][j] = (updated < INT16_MIN) ? INT16_MIN : updated;
-                }
+            for (uint16_t i = block; i < block_end; i++) {
+                uint16_t dist = locationDistance(i, input, input_weight);
+                if (dist > config.access_radius) continue;
+                
+                partial.activated[v]++;
+                applyWrite(i, delta);
             }
         }
     }
+}
+
+void SparseDistributedMemory::writeIndexed(const uint32_t* packed_inputs, uint8_t count,
+                                           const uint16_t* min_overlap, ScanPartial& partial) {
+    std::fill(partial.activated, partial.activated + count, 0);
+    
+    // Only locations sharing enough set bits can be in range; confirm each exactly
+    for (uint8_t v = 0; v < count; v++) {
+        const uint32_t* input = packed_inputs + static_cast<size_t>(v) * words_per_vector;
+        const uint8_t* delta = deltaRow(v);
+        uint16_t input_weight = queryWeight(input);
+        uint16_t found = address_index.candidates(input, min_overlap[v], candidate_scratch.data());
+        
+        for (uint16_t c = 0; c < found; c++) {
+            uint16_t i = candidate_scratch[c];
+            if (locationDistance(i, input, input_weight) > config.access_radius) continue;
+            
+            partial.activated[v]++;
+            applyWrite(i, delta);
+        }
+    }
+}
+
+uint16_t SparseDistributedMemory::indexMinOverlap(const uint32_t* query) const {
+    if (address_index.empty()) return 0;
     
-    stats.total_writes++;
-    stats.last_activated_locations = activated_locations;
+    // distance = |a| + |q| - 2 * overlap, so an activated location needs
+    // overlap >= (|a| + |q| - radius) / 2. With no positive bound every
+    // location is a candidate and the index cannot help.
+    int32_t slack = static_cast<int32_t>(address_index.minWeight()) +
+                    SDMKernels::popcount(query, words_per_vector) - config.access_radius;
+    if (slack <= 0) return 0;
     
-    return activated_locations;
+    // Dense queries can visit more postings than a full scan does distance steps
+    uint32_t scan_cost = static_cast<uint32_t>(config.num_locations) * (sparse_mode ? address_ones : words_per_vector);
+    if (address_index.queryWork(query) >= scan_cost) return 0;
+    
+    return static_cast<uint16_t>((slack + 1) / 2);
+}
+
+bool SparseDistributedMemory::indexedScanApplies(const uint32_t* vectors, uint8_t count, uint16_t* min_overlap) const {
+    // All or nothing per chunk, so rows keep receiving updates in input order
+    for (uint8_t v = 0; v < count; v++) {
+        min_overlap[v] = indexMinOverlap(vectors + static_cast<size_t>(v) * words_per_vector);
+        if (min_overlap[v] == 0) return false;
+    }
+    return true;
 }
 
 std::pair<std::vector<uint8_t>, float> SparseDistributedMemory::read(const std::vector<uint8_t>& query_vector) {
@@ -117,50 +383,303 @@ std::pair<std::vector<uint8_t>, float> SparseDistributedMemory::read(const std::
         return {std::vector<uint8_t>(config.vector_dim, 0), 0.0f};
     }
     
-    std::vector<uint16_t> activated_indices;
-    std::vector<uint16_t> distances;
+    SDMKernels::pack(query_vector.data(), config.vector_dim, packed_scratch.data());
+    std::vector<uint32_t> packed_output(words_per_vector);
+    float confidence = read(packed_scratch.data(), packed_output.data());
+    
+    std::vector<uint8_t> output(config.vector_dim);
+    SDMKernels::unpack(packed_output.data(), config.vector_dim, output.data());
+    return {output, confidence};
+}
+
+void SparseDistributedMemory::rebuildWeightTable() {
+    // Adaptive activation can reach any distance
+    uint16_t max_distance = maxActivationDistance();
+    weight_table.resize(max_distance + 1);
+    for (uint16_t d = 0; d <= max_distance; d++) {
+        // Closer = higher weight, rounded, never zero
+        uint32_t weight = (SDM_READ_WEIGHT_ONE + (d + 1) / 2) / (d + 1);
+        weight_table[d] = weight > 0 ? weight : 1;
+    }
+}
+
+float SparseDistributedMemory::read(const uint32_t* packed_query, uint32_t* packed_output) {
+    float confidence = 0.0f;
+    readChunk(packed_query, 1, packed_output, &confidence);
+    return confidence;
+}
+
+void SparseDistributedMemory::readBatch(const uint32_t* packed_queries, uint16_t count,
+                                        uint32_t* packed_outputs, float* confidences) {
+    for (uint16_t first = 0; first < count; first += SDM_BATCH_MAX) {
+        uint8_t chunk = static_cast<uint8_t>(std::min<uint16_t>(count - first, SDM_BATCH_MAX));
+        size_t offset = static_cast<size_t>(first) * words_per_vector;
+        readChunk(packed_queries + offset, chunk, packed_outputs + offset,
+                  confidences ? confidences + first : nullptr);
+    }
+}
+
+void SparseDistributedMemory::readChunk(const uint32_t* packed_queries, uint8_t count,
+                                        uint32_t* packed_outputs, float* confidences) {
+    uint32_t started_us = SDMTelemetry::start();
+    
+    if (weight_table.size() != static_cast<size_t>(maxActivationDistance()) + 1) {
+        rebuildWeightTable();
+    }
+    
+    ScanPartial local;
+    ScanPartial* partial = &local;
+    uint16_t min_overlap[SDM_BATCH_MAX] = {};
+    stats.last_radius = config.access_radius;
+    if (config.target_activations) {
+        readNearest(packed_queries, count, local);
+    } else if (indexedScanApplies(packed_queries, count, min_overlap)) {
+        readIndexed(packed_queries, count, min_overlap, local);
+    } else if (workers_running) {
+        // Each worker accumulates into its own scratch set; reduce into the first
+        dispatchScan(SCAN_READ, packed_queries, count);
+        mergeReadPartials(count);
+        partial = &workers[0].partial;
+    } else {
+        readRange(packed_queries, count, 0, config.num_locations, read_accum, local);
+    }
     
-    // Find activated locations
-    for (uint16_t i = 0; i < config.num_locations; i++) {
-        uint16_t dist = hammingDistance(query_vector, addresses[i]);
-        if (dist <= config.access_radius) {
-            activated_indices.push_back(i);
-            distances.push_back(dist);
+    for (uint8_t v = 0; v < count; v++) {
+        uint32_t* output = packed_outputs + static_cast<size_t>(v) * words_per_vector;
+        const int32_t* accum = read_accum + static_cast<size_t>(v) * row_stride;
+        std::fill(output, output + words_per_vector, 0);
+        
+        float max_confidence = 0.0f;
+        if (partial->activated[v] > 0) {
+            // Threshold on the sign of the weighted sum; confidence is the largest normalized magnitude
+            int32_t max_magnitude = 0;
+            for (uint16_t j = 0; j < config.vector_dim; j++) {
+                int32_t sum = accum[j];
+                if (sum > 0) SDMKernels::setBit(output, j);
+                int32_t magnitude = sum < 0 ? -sum : sum;
+                if (magnitude > max_magnitude) max_magnitude = magnitude;
+            }
+            max_confidence = static_cast<float>(max_magnitude) / partial->total_weight[v];
+            
+            stats.total_reads++;
+            stats.last_confidence = max_confidence;
         }
+        
+        if (confidences) confidences[v] = max_confidence;
+        telemetry.recordActivated(partial->activated[v]);
     }
     
-    if (activated_indices.empty()) {
-        return {std::vector<uint8_t>(config.vector_dim, 0), 0.0f};
+    telemetry.record(SDM_OP_READ, started_us, count);
+}
+
+void SparseDistributedMemory::readRange(const uint32_t* packed_queries, uint8_t count,
+                                        uint16_t begin, uint16_t end,
+                                        int32_t* accum_base, ScanPartial& partial) {
+    std::fill(partial.activated, partial.activated + count, 0);
+    std::fill(partial.total_weight, partial.total_weight + count, 0);
+    std::fill(partial.weight_shift, partial.weight_shift + count, 0);
+    
+    // Find activated locations and accumulate their weighted counters in the same pass
+    for (uint16_t block = begin; block < end; block += SDM_SCAN_BLOCK) {
+        uint16_t block_end = std::min<uint32_t>(block + SDM_SCAN_BLOCK, end);
+        
+        for (uint8_t v = 0; v < count; v++) {
+            const uint32_t* query = packed_queries + static_cast<size_t>(v) * words_per_vector;
+            int32_t* accum = accum_base + static_cast<size_t>(v) * row_stride;
+            uint16_t query_weight = queryWeight(query);
+            
+            for (uint16_t i = block; i < block_end; i++) {
+                uint16_t dist = locationDistance(i, query, query_weight);
+                if (dist > config.access_radius) continue;
+                
+                applyRead(i, dist, accum, partial, v);
+            }
+        }
+    }
+}
+
+void SparseDistributedMemory::readIndexed(const uint32_t* packed_queries, uint8_t count,
+                                          const uint16_t* min_overlap, ScanPartial& partial) {
+    std::fill(partial.activated, partial.activated + count, 0);
+    std::fill(partial.total_weight, partial.total_weight + count, 0);
+    std::fill(partial.weight_shift, partial.weight_shift + count, 0);
+    
+    for (uint8_t v = 0; v < count; v++) {
+        const uint32_t* query = packed_queries + static_cast<size_t>(v) * words_per_vector;
+        int32_t* accum = read_accum + static_cast<size_t>(v) * row_stride;
+        uint16_t query_weight = queryWeight(query);
+        uint16_t found = address_index.candidates(query, min_overlap[v], candidate_scratch.data());
+        
+        for (uint16_t c = 0; c < found; c++) {
+            uint16_t i = candidate_scratch[c];
+            uint16_t dist = locationDistance(i, query, query_weight);
+            if (dist > config.access_radius) continue;
+            
+            applyRead(i, dist, accum, partial, v);
+        }
+    }
+}
+
+void SparseDistributedMemory::applyRead(uint16_t location, uint16_t dist, int32_t* accum,
+                                        ScanPartial& partial, uint8_t v) {
+    if (partial.activated[v] == 0) {
+        std::fill(accum, accum + row_stride, 0);
+    }
+    
+    int32_t weight = weight_table[dist] >> partial.weight_shift[v];
+    if (partial.total_weight[v] + weight > SDM_READ_WEIGHT_BUDGET) {
+        // Halve everything accumulated so far to keep int32 headroom
+        for (uint16_t j = 0; j < row_stride; j++) {
+            accum[j] >>= 1;
+        }
+        partial.total_weight[v] >>= 1;
+        partial.weight_shift[v]++;
+        weight = weight_table[dist] >> partial.weight_shift[v];
     }
+    if (weight == 0) weight = 1;
     
-    // Weighted sum based on distance
-    std::vector<float> total(config.vector_dim, 0.0f);
-    float total_weight = 0.0f;
+    const uint8_t* row = counterRow(location);
+    switch (config.counter_bits) {
+        case 8:
+            SDMKernels::accumulateWeightedRow8(accum, reinterpret_cast<const int8_t*>(row), weight, row_stride);
+            break;
+        case 4:
+            SDMKernels::accumulateWeightedRow4(accum, row, weight, row_stride);
+            break;
+        default:
+            SDMKernels::accumulateWeightedRow(accum, reinterpret_cast<const int16_t*>(row), weight, row_stride);
+            break;
+    }
+    partial.total_weight[v] += weight;
+    partial.activated[v]++;
+}
+
+void SparseDistributedMemory::mergeReadPartials(uint8_t count) {
+    ScanPartial& into = workers[0].partial;
+    size_t set_cells = static_cast<size_t>(SDM_BATCH_MAX) * row_stride;
     
-    for (size_t i = 0; i < activated_indices.size(); i++) {
-        float weight = 1.0f / (1.0f + distances[i]);  // Closer = higher weight
-        total_weight += weight;
+    for (uint8_t w = 1; w < SDM_SCAN_WORKERS; w++) {
+        const ScanPartial& from = workers[w].partial;
         
-        uint16_t loc_idx = activated_indices[i];
-        for (uint16_t j = 0; j < config.vector_dim; j++) {
-            total[j] += weight * memory[loc_idx][j];
+        for (uint8_t v = 0; v < count; v++) {
+            if (from.activated[v] == 0) continue;
+            
+            int32_t* dst = read_accum + static_cast<size_t>(v) * row_stride;
+            const int32_t* src = read_accum + w * set_cells + static_cast<size_t>(v) * row_stride;
+            
+            if (into.activated[v] == 0) {
+                std::copy(src, src + row_stride, dst);
+                into.total_weight[v] = from.total_weight[v];
+                into.weight_shift[v] = from.weight_shift[v];
+                into.activated[v] = from.activated[v];
+                continue;
+            }
+            
+            // Bring both halves to a common weight scale that keeps the sum in budget
+            uint8_t shift = std::max(into.weight_shift[v], from.weight_shift[v]);
+            while ((into.total_weight[v] >> (shift - into.weight_shift[v])) +
+                   (from.total_weight[v] >> (shift - from.weight_shift[v])) > SDM_READ_WEIGHT_BUDGET) {
+                shift++;
+            }
+            uint8_t dst_shift = shift - into.weight_shift[v];
+            uint8_t src_shift = shift - from.weight_shift[v];
+            
+            for (uint16_t j = 0; j < row_stride; j++) {
+                dst[j] = (dst[j] >> dst_shift) + (src[j] >> src_shift);
+            }
+            into.total_weight[v] = (into.total_weight[v] >> dst_shift) + (from.total_weight[v] >> src_shift);
+            into.weight_shift[v] = shift;
+            into.activated[v] += from.activated[v];
         }
     }
+}
+
+bool SparseDistributedMemory::startWorkers() {
+    if (workers_running) return true;
+    if (config.num_locations < SDM_SCAN_WORKERS * SDM_SCAN_BLOCK) return false;
     
-    // Normalize and threshold
-    std::vector<uint8_t> output(config.vector_dim);
-    float max_confidence = 0.0f;
+    workers_done = xSemaphoreCreateCounting(SDM_SCAN_WORKERS, 0);
+    if (!workers_done) return false;
+    
+    // Split on block boundaries so each worker scans whole blocks
+    uint16_t blocks = (config.num_locations + SDM_SCAN_BLOCK - 1) / SDM_SCAN_BLOCK;
+    for (uint8_t w = 0; w < SDM_SCAN_WORKERS; w++) {
+        ScanWorker& worker = workers[w];
+        worker.owner = this;
+        worker.index = w;
+        worker.begin = std::min<uint32_t>((blocks * w / SDM_SCAN_WORKERS) * SDM_SCAN_BLOCK, config.num_locations);
+        worker.end = std::min<uint32_t>((blocks * (w + 1) / SDM_SCAN_WORKERS) * SDM_SCAN_BLOCK, config.num_locations);
+        
+        if (xTaskCreatePinnedToCore(scanWorkerTask, "sdm_scan", 4096, &worker, 2, &worker.task, w) != pdPASS) {
+            worker.task = nullptr;
+            stopWorkers();
+            return false;
+        }
+    }
     
-    for (uint16_t i = 0; i < config.vector_dim; i++) {
-        float normalized_value = total[i] / total_weight;
-        output[i] = (normalized_value > 0) ? 1 : 0;
-        max_confidence = std::max(max_confidence, std::abs(normalized_value));
+    workers_running = true;
+    Serial.printf("SDM scan split across %d cores\n", SDM_SCAN_WORKERS);
+    return true;
+}
+
+void SparseDistributedMemory::stopWorkers() {
+    bool any_started = false;
+    for (uint8_t w = 0; w < SDM_SCAN_WORKERS; w++) {
+        any_started |= (workers[w].task != nullptr);
+    }
+    
+    if (any_started) {
+        scan_op = SCAN_EXIT;
+        for (uint8_t w = 0; w < SDM_SCAN_WORKERS; w++) {
+            if (workers[w].task) xTaskNotifyGive(workers[w].task);
+        }
+        for (uint8_t w = 0; w < SDM_SCAN_WORKERS; w++) {
+            if (workers[w].task) {
+                xSemaphoreTake(workers_done, portMAX_DELAY);
+                workers[w].task = nullptr;
+            }
+        }
+    }
+    
+    if (workers_done) {
+        vSemaphoreDelete(workers_done);
+        workers_done = nullptr;
     }
+    workers_running = false;
+}
+
+void SparseDistributedMemory::dispatchScan(ScanOp op, const uint32_t* vectors, uint8_t count) {
+    scan_op = op;
+    scan_vectors = vectors;
+    scan_count = count;
     
-    stats.total_reads++;
-    stats.last_confidence = max_confidence;
+    for (uint8_t w = 0; w < SDM_SCAN_WORKERS; w++) {
+        xTaskNotifyGive(workers[w].task);
+    }
+    for (uint8_t w = 0; w < SDM_SCAN_WORKERS; w++) {
+        xSemaphoreTake(workers_done, portMAX_DELAY);
+    }
+}
+
+void SparseDistributedMemory::scanWorkerTask(void* arg) {
+    ScanWorker* worker = static_cast<ScanWorker*>(arg);
+    SparseDistributedMemory* sdm = worker->owner;
+    int32_t* accum = sdm->read_accum + static_cast<size_t>(worker->index) * SDM_BATCH_MAX * sdm->row_stride;
+    
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        if (sdm->scan_op == SCAN_EXIT) break;
+        if (sdm->scan_op == SCAN_WRITE) {
+            sdm->writeRange(sdm->scan_vectors, sdm->scan_count, worker->begin, worker->end, worker->partial);
+        } else {
+            sdm->readRange(sdm->scan_vectors, sdm->scan_count, worker->begin, worker->end, accum, worker->partial);
+        }
+        xSemaphoreGive(sdm->workers_done);
+    }
     
-    return {output, max_confidence};
+    xSemaphoreGive(sdm->workers_done);
+    vTaskDelete(nullptr);
 }
 
 bool SparseDistributedMemory::loadConfig() {
@@ -189,7 +708,16 @@ bool SparseDistributedMemory::loadConfig() {
     config.vector_dim = doc["vector_dim"] | config.vector_dim;
     config.num_locations = doc["num_locations"] | config.num_locations;
     config.access_radius = doc["access_radius"] | config.access_radius;
+    config.target_activations = doc["target_activations"] | config.target_activations;
     config.sparsity = doc["sparsity"] | config.sparsity;
+    config.dual_core = doc["dual_core"] | config.dual_core;
+    config.sparse_addresses = doc["sparse_addresses"] | config.sparse_addresses;
+    config.counter_bits = doc["counter_bits"] | config.counter_bits;
+    config.checkpoint_writes = doc["checkpoint_writes"] | config.checkpoint_writes;
+    config.checkpoint_interval_ms = doc["checkpoint_interval_ms"] | config.checkpoint_interval_ms;
+    config.checkpoint_idle_ms = doc["checkpoint_idle_ms"] | config.checkpoint_idle_ms;
+    config.cache_pages = doc["cache_pages"] | config.cache_pages;
+    config.seed = doc["seed"] | config.seed;
     
     Serial.println("Config loaded successfully");
     return true;
@@ -200,7 +728,16 @@ bool SparseDistributedMemory::saveConfig() {
     doc["vector_dim"] = config.vector_dim;
     doc["num_locations"] = config.num_locations;
     doc["access_radius"] = config.access_radius;
+    doc["target_activations"] = config.target_activations;
     doc["sparsity"] = config.sparsity;
+    doc["dual_core"] = config.dual_core;
+    doc["sparse_addresses"] = config.sparse_addresses;
+    doc["counter_bits"] = config.counter_bits;
+    doc["checkpoint_writes"] = config.checkpoint_writes;
+    doc["checkpoint_interval_ms"] = config.checkpoint_interval_ms;
+    doc["checkpoint_idle_ms"] = config.checkpoint_idle_ms;
+    doc["cache_pages"] = config.cache_pages;
+    doc["seed"] = config.seed;
     doc["timestamp"] = millis();
     
     File file = SD.open(config.config_file, FILE_WRITE);
@@ -216,92 +753,358 @@ bool SparseDistributedMemory::saveConfig() {
     return true;
 }
 
+// Payloads move in SDM_IMAGE_BLOCK transfers straight from/to their buffers
+static bool writeImageBlocks(File& file, const void* data, size_t bytes) {
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    for (size_t done = 0; done < bytes; done += SDM_IMAGE_BLOCK) {
+        size_t chunk = std::min<size_t>(bytes - done, SDM_IMAGE_BLOCK);
+        if (file.write(src + done, chunk) != chunk) return false;
+    }
+    return true;
+}
+
+static bool readImageBlocks(File& file, void* data, size_t bytes, uint32_t& crc) {
+    uint8_t* dst = static_cast<uint8_t*>(data);
+    for (size_t done = 0; done < bytes; done += SDM_IMAGE_BLOCK) {
+        size_t chunk = std::min<size_t>(bytes - done, SDM_IMAGE_BLOCK);
+        if (file.read(dst + done, chunk) != chunk) return false;
+        crc = sdmCrc32(crc, dst + done, chunk);
+    }
+    return true;
+}
+
 bool SparseDistributedMemory::saveMemoryToSD() {
+    if (paged) {
+        return sealPagedImage();
+    }
+    
     // Create SDM directory if it doesn't exist
     if (!SD.exists("/sdm")) {
         SD.mkdir("/sdm");
     }
     
-    File file = SD.open(memory_file, FILE_WRITE);
+    // Queued journal appends land before the journal is removed below; the
+    // image covers their rows whatever their outcome
+    sdmWriter().flush();
+    journal_last_ticket = 0;
+    checkpoint_timing = false;
+    
+    // Write the whole image to a temp file first so a power cut never tears the live one
+    String temp_file = memory_file + ".tmp";
+    uint32_t payload_crc = 0;
+    if (!exportImage(temp_file, &payload_crc)) {
+        return false;
+    }
+    
+    // FAT has no atomic replace: keep the previous image as .bak until the new one is in place
+    String backup_file = memory_file + ".bak";
+    if (SD.exists(backup_file)) {
+        SD.remove(backup_file);
+    }
+    if (SD.exists(memory_file) && !SD.rename(memory_file, backup_file)) {
+        SD.remove(memory_file);
+    }
+    if (!SD.rename(temp_file, memory_file)) {
+        Serial.println("Failed to replace memory image");
+        return false;
+    }
+    
+    // The image now holds every row, so the journal is obsolete
+    image_on_card = true;
+    image_crc = payload_crc;
+    if (SD.exists(journal_file)) {
+        SD.remove(journal_file);
+    }
+    journal_bytes = 0;
+    markCheckpointed();
+    
+    Serial.println("Memory saved to SD card");
+    return true;
+}
+
+bool SparseDistributedMemory::exportImage(const String& path, uint32_t* payload_crc) {
+    if (paged || !counters) {
+        return false;
+    }
+    
+    size_t count_bytes = access_counts.size() * sizeof(uint16_t);
+    size_t arena_bytes = static_cast<size_t>(config.num_locations) * row_bytes;
+    
+    SDMImageHeader header;
+    header.seed = config.seed;
+    header.num_locations = config.num_locations;
+    header.vector_dim = config.vector_dim;
+    header.counter_bits = config.counter_bits;
+    header.flags = sparse_mode ? SDM_IMAGE_FLAG_SPARSE_ADDRESSES : 0;
+    header.address_ones = address_ones;
+    header.row_bytes = row_bytes;
+    header.payload_bytes = count_bytes + arena_bytes;
+    header.payload_crc = sdmCrc32(sdmCrc32(0, access_counts.data(), count_bytes), counters, arena_bytes);
+    sdmSealImageHeader(header);
+    
+    File file = SD.open(path, FILE_WRITE);
     if (!file) {
         Serial.println("Failed to create memory file");
         return false;
     }
     
-    // Write header
-    file.write((uint8_t*)&config.num_locations, sizeof(config.num_locations));
-    file.write((uint8_t*)&config.vector_dim, sizeof(config.vector_dim));
+    bool written = writeImageBlocks(file, &header, sizeof(header)) &&
+                   writeImageBlocks(file, access_counts.data(), count_bytes) &&
+                   writeImageBlocks(file, counters, arena_bytes);
+    file.close();
+    if (!written) {
+        Serial.println("Failed to write memory image");
+        SD.remove(path);
+        return false;
+    }
+    
+    if (payload_crc) *payload_crc = header.payload_crc;
+    Serial.printf("Wrote %u byte memory image %s\n", (unsigned)(sizeof(header) + header.payload_bytes), path.c_str());
+    return true;
+}
+
+bool SparseDistributedMemory::stackImage(const String& path, bool* partial) {
+    if (partial) *partial = false;
+    File file = SD.open(path);
+    if (!file) {
+        return false;
+    }
+    
+    SDMImageHeader header;
+    bool usable = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && sdmImageHeaderValid(header) &&
+                  matchesImage(header);
+    if (!usable) {
+        Serial.printf("%s does not match this memory\n", path.c_str());
+        file.close();
+        return false;
+    }
+    if (header.flags & SDM_IMAGE_FLAG_OPEN) {
+        // No valid payload CRC to check it against
+        Serial.printf("%s was not closed cleanly; not stacking it\n", path.c_str());
+        file.close();
+        return false;
+    }
     
-    // Write access counts
-    for (uint16_t i = 0; i < config.num_locations; i++) {
-        file.write((uint8_t*)&access_counts[i], sizeof(access_counts[i]));
+    // Rows arrive in aligned blocks and are added with the same saturating
+    // kernels as writes, in a second pass once the whole payload has checked out
+    uint16_t rows_per_block = std::max<uint16_t>(1, SDM_IMAGE_BLOCK / row_bytes);
+    size_t block_bytes = std::max<size_t>(static_cast<size_t>(rows_per_block) * row_bytes,
+                                          config.num_locations * sizeof(uint16_t));
+    bool block_in_psram = false;
+    uint8_t* block = static_cast<uint8_t*>(sdmAllocArena(block_bytes, false, &block_in_psram));
+    int8_t* nibble_lanes = config.counter_bits == 4 ? reinterpret_cast<int8_t*>(delta_rows) : nullptr;
+    if (!block) {
+        file.close();
+        return false;
+    }
+    
+    uint32_t crc = 0;
+    bool complete = true;
+    for (uint32_t remaining = header.payload_bytes; complete && remaining > 0;) {
+        size_t chunk = std::min<size_t>(remaining, block_bytes);
+        complete = readImageBlocks(file, block, chunk, crc);
+        remaining -= chunk;
+    }
+    if (!complete || crc != header.payload_crc || !file.seek(sizeof(header))) {
+        Serial.printf("%s is truncated or corrupt; nothing stacked\n", path.c_str());
+        file.close();
+        sdmFreeArena(block);
+        return false;
     }
     
-    // Write memory data
-    for (uint16_t i = 0; i < config.num_locations; i++) {
-        for (uint16_t j = 0; j < config.vector_dim; j++) {
-            file.write((uint8_t*)&memory[i][j], sizeof(memory[i][j]));
+    crc = 0;
+    size_t count_bytes = config.num_locations * sizeof(uint16_t);
+    complete = readImageBlocks(file, block, count_bytes, crc);
+    if (complete) {
+        const uint16_t* counts = reinterpret_cast<const uint16_t*>(block);
+        for (uint16_t i = 0; i < config.num_locations; i++) {
+            access_counts[i] = std::min<uint32_t>(UINT16_MAX, static_cast<uint32_t>(access_counts[i]) + counts[i]);
         }
     }
     
+    for (uint16_t first = 0; complete && first < config.num_locations; first += rows_per_block) {
+        uint16_t rows = std::min<uint16_t>(rows_per_block, config.num_locations - first);
+        complete = readImageBlocks(file, block, static_cast<size_t>(rows) * row_bytes, crc);
+        
+        for (uint16_t r = 0; complete && r < rows; r++) {
+            uint16_t location = first + r;
+            uint8_t* row = counterRow(location, true);
+            const uint8_t* other = block + static_cast<size_t>(r) * row_bytes;
+            markDirty(location);
+            switch (config.counter_bits) {
+                case 8:
+                    SDMKernels::saturatingAddRow8(reinterpret_cast<int8_t*>(row), reinterpret_cast<const int8_t*>(other), row_stride);
+                    break;
+                case 4:
+                    // Widen the packed nibbles into the delta scratch, then add as a write would
+                    for (uint16_t j = 0; j < row_stride; j++) {
+                        nibble_lanes[j] = SDMKernels::counterLane(other, 4, j);
+                    }
+                    SDMKernels::saturatingAddRow4(row, nibble_lanes, row_stride);
+                    break;
+                default:
+                    SDMKernels::saturatingAddRow(reinterpret_cast<int16_t*>(row), reinterpret_cast<const int16_t*>(other), row_stride);
+                    break;
+            }
+        }
+    }
     file.close();
-    Serial.println("Memory saved to SD card");
+    sdmFreeArena(block);
+    
+    if (!complete) {
+        // Verified a moment ago, so only a read error gets here
+        Serial.printf("Reading %s failed while stacking; part of it was added\n", path.c_str());
+        if (partial) *partial = true;
+        return false;
+    }
+    last_write_ms = millis();
+    if (pending_writes == 0) first_pending_ms = last_write_ms;
+    pending_writes += 1;
     return true;
 }
 
 bool SparseDistributedMemory::loadMemoryFromSD() {
-    if (!SD.exists(memory_file)) {
+    image_on_card = false;
+    journal_bytes = 0;
+    
+    if (paged) {
+        // Reopen the image; cached pages are dropped without writeback
+        if (!openPagedImage() && !recoverPagedImage()) return false;
+        if (replayJournal()) {
+            // Journals are a resident-mode artifact; fold one left behind into the image
+            sealPagedImage();
+        }
+        return true;
+    }
+    
+    bool loaded = loadMemoryImage(memory_file);
+    if (!loaded) {
+        // A save interrupted between renames leaves only the backup
+        String backup_file = memory_file + ".bak";
+        loaded = SD.exists(backup_file) && loadMemoryImage(backup_file);
+        if (loaded) {
+            Serial.println("Recovered memory from backup image");
+        }
+    }
+    if (!loaded) {
+        return false;
+    }
+    
+    image_on_card = true;
+    markCheckpointed();
+    replayJournal();
+    return true;
+}
+
+bool SparseDistributedMemory::loadMemoryImage(const String& path) {
+    if (!SD.exists(path)) {
         return false;
     }
     
-    File file = SD.open(memory_file);
+    File file = SD.open(path);
     if (!file) {
         return false;
     }
     
     // Read and verify header
-    uint16_t stored_locations, stored_dim;
-    file.read((uint8_t*)&stored_locations, sizeof(stored_locations));
-    file.read((uint8_t*)&stored_dim, sizeof(stored_dim));
+    SDMImageHeader header;
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || !sdmImageHeaderValid(header)) {
+        Serial.printf("%s is not a valid memory image\n", path.c_str());
+        file.close();
+        return false;
+    }
     
-    if (stored_locations != config.num_locations || stored_dim != config.vector_dim) {
+    if (header.num_locations != config.num_locations || header.vector_dim != config.vector_dim) {
         Serial.println("Memory file dimension mismatch");
         file.close();
         return false;
     }
-    
-    // Read access counts
-    for (uint16_t i = 0; i < config.num_locations; i++) {
-        file.read((uint8_t*)&access_counts[i], sizeof(access_counts[i]));
+    if (header.seed != config.seed) {
+        // Counters belong to addresses derived from another seed
+        Serial.println("Memory file seed mismatch");
+        file.close();
+        return false;
     }
-    
-    // Read memory data
-    for (uint16_t i = 0; i < config.num_locations; i++) {
-        for (uint16_t j = 0; j < config.vector_dim; j++) {
-            file.read((uint8_t*)&memory[i][j], sizeof(memory[i][j]));
-        }
+    if (header.counter_bits != config.counter_bits || header.row_bytes != row_bytes) {
+        Serial.printf("Memory file holds %d-bit counters, configured for %d\n", header.counter_bits, config.counter_bits);
+        file.close();
+        return false;
+    }
+    if (header.address_ones != address_ones ||
+        ((header.flags & SDM_IMAGE_FLAG_SPARSE_ADDRESSES) != 0) != sparse_mode) {
+        // Same seed, but addresses drawn at another sparsity or stored another way
+        Serial.println("Memory file sparsity mismatch");
+        file.close();
+        return false;
     }
     
+    size_t count_bytes = access_counts.size() * sizeof(uint16_t);
+    size_t arena_bytes = static_cast<size_t>(config.num_locations) * row_bytes;
+    uint32_t crc = 0;
+    bool complete = header.payload_bytes == count_bytes + arena_bytes &&
+                    readImageBlocks(file, access_counts.data(), count_bytes, crc) &&
+                    readImageBlocks(file, counters, arena_bytes, crc);
     file.close();
+    
+    // A paged memory that was not saved cleanly has no valid payload CRC
+    bool crc_known = !(header.flags & SDM_IMAGE_FLAG_OPEN);
+    if (complete && !crc_known) {
+        Serial.printf("%s was not closed cleanly; payload CRC not verified\n", path.c_str());
+    }
+    if (!complete || (crc_known && crc != header.payload_crc)) {
+        // Never run on a half-loaded arena
+        Serial.printf("%s is truncated or corrupt\n", path.c_str());
+        clearMemory();
+        return false;
+    }
+    
+    image_crc = crc;
     Serial.println("Memory loaded from SD card");
     return true;
 }
 
+void SparseDistributedMemory::clearMemory() {
+    if (paged) {
+        // The rows live on the card: start over from a zeroed image (the
+        // old one is kept as the backup)
+        std::fill(access_counts.begin(), access_counts.end(), 0);
+        if (!createPagedImage()) {
+            Serial.println("Failed to create paged memory image");
+        }
+        return;
+    }
+    
+    if (counters) {
+        memset(counters, 0, static_cast<size_t>(config.num_locations) * row_bytes);
+    }
+    std::fill(access_counts.begin(), access_counts.end(), 0);
+    
+    // Every row changed; the next checkpoint rewrites the image
+    markAllDirty();
+}
+
 bool SparseDistributedMemory::saveToSD() {
+    uint32_t started_us = SDMTelemetry::start();
     bool success = true;
     success &= saveConfig();
     success &= saveMemoryToSD();
     success &= saveStatsToSD();
+    telemetry.record(SDM_OP_SAVE, started_us);
     return success;
 }
 
 bool SparseDistributedMemory::loadFromSD() {
+    sdmWriter().flush();
     bool success = true;
     success &= loadConfig();
     success &= loadMemoryFromSD();
     return success;
 }
 
+void SparseDistributedMemory::resetStats() {
+    stats = SDMStats();
+}
+
 bool SparseDistributedMemory::saveStatsToSD() {
     DynamicJsonDocument doc(1024);
     doc["total_writes"] = stats.total_writes;
@@ -311,28 +1114,94 @@ bool SparseDistributedMemory::saveStatsToSD() {
     doc["avg_match_ratio"] = stats.avg_match_ratio;
     doc["timestamp"] = millis();
     
-    File file = SD.open(stats_file, FILE_WRITE);
-    if (!file) return false;
-    
-    serializeJson(doc, file);
-    file.close();
-    return true;
+    // Written by the writer task; the snapshot is taken now
+    String text;
+    serializeJson(doc, text);
+    return sdmWriter().write(stats_file, text.c_str(), text.length(), SDM_WRITE_REPLACE) != 0;
 }
 
 void SparseDistributedMemory::printMemoryUsage() {
+    uint32_t address_bytes = addresses.size() * sizeof(uint32_t) + address_bits.size() * sizeof(uint16_t);
+    uint32_t arena_bytes = paged ? static_cast<uint32_t>(page_slots.size()) * SDM_PAGE_ROWS * row_bytes
+                                 : static_cast<uint32_t>(config.num_locations) * row_bytes;
+    uint32_t count_bytes = access_counts.size() * sizeof(uint16_t);
+    
     Serial.println("=== SDM Memory Usage ===");
-    Serial.printf("Addresses: %d locations x %d dims = %d bytes\n", 
-                  config.num_locations, config.vector_dim, 
-                  config.num_locations * config.vector_dim);
-    Serial.printf("Memory: %d locations x %d dims x 2 bytes = %d bytes\n", 
-                  config.num_locations, config.vector_dim, 
-                  config.num_locations * config.vector_dim * 2);
-    Serial.printf("Access counts: %d x 2 bytes = %d bytes\n", 
-                  config.num_locations, config.num_locations * 2);
-    
-    uint32_t total_bytes = config.num_locations * config.vector_dim * 3 + config.num_locations * 2;
-    Serial.printf("Total SDM memory: %d bytes (%.1f KB)\n", total_bytes, total_bytes / 1024.0f);
+    if (sparse_mode) {
+        Serial.printf("Addresses: %d locations x %d positions x 2 bytes = %u bytes (sparse, internal)\n", 
+                      config.num_locations, address_ones, address_bytes);
+    } else {
+        Serial.printf("Addresses: %d locations x %d words x 4 bytes = %u bytes (bit-packed, internal)\n", 
+                      config.num_locations, words_per_vector, address_bytes);
+    }
+    Serial.printf("Counters: %d locations x %d stride x %d bits = %u bytes (%s)\n", 
+                  paged ? static_cast<int>(page_slots.size() * SDM_PAGE_ROWS) : config.num_locations,
+                  row_stride, config.counter_bits, arena_bytes, counters_in_psram ? "PSRAM" : "internal");
+    if (paged) {
+        Serial.printf("Paged: %d of %d pages cached, %u faults, %u writebacks (%u failed), %u bytes on SD\n",
+                      (int)page_slots.size(), (int)page_to_slot.size(), (unsigned)page_faults, (unsigned)page_writebacks,
+                      (unsigned)page_failures,
+                      (unsigned)(imageRowsOffset() + static_cast<uint32_t>(config.num_locations) * row_bytes));
+    }
+    Serial.printf("Access counts: %d x 2 bytes = %u bytes (internal)\n", 
+                  config.num_locations, count_bytes);
+    
+    uint32_t index_bytes = address_index.memoryBytes() + candidate_scratch.capacity() * sizeof(uint16_t);
+    if (!address_index.empty()) {
+        Serial.printf("Address index: %u bytes (internal)\n", index_bytes);
+    }
+    
+    uint32_t total_bytes = address_bytes + arena_bytes + count_bytes + index_bytes;
+    Serial.printf("Total SDM memory: %u bytes (%.1f KB)\n", total_bytes, total_bytes / 1024.0f);
     
     Serial.printf("Free heap: %d bytes\n", ESP.getFreeHeap());
     Serial.printf("Total heap: %d bytes\n", ESP.getHeapSize());
-}
\ No newline at end of file
+    Serial.printf("Free PSRAM: %d bytes\n", ESP.getFreePsram());
+}
+
+SDMFootprint SparseDistributedMemory::footprintFor(const SDMConfig& cfg) {
+    SDMFootprint fp;
+    uint32_t words = SDMKernels::wordsForDim(cfg.vector_dim);
+    uint8_t counter_bits = (cfg.counter_bits == 8 || cfg.counter_bits == 4) ? cfg.counter_bits : 16;
+    uint32_t stride = counterStride(cfg.vector_dim, counter_bits);
+    uint32_t num_ones = static_cast<uint32_t>(cfg.vector_dim * cfg.sparsity);
+    uint32_t address_bytes = (cfg.sparse_addresses && num_ones <= cfg.vector_dim / 2u)
+                                 ? num_ones * sizeof(uint16_t)
+                                 : words * sizeof(uint32_t);
+    
+    fp.internal_bytes = static_cast<uint32_t>(cfg.num_locations) * address_bytes +
+                        static_cast<uint32_t>(cfg.num_locations) * sizeof(uint16_t) +
+                        words * sizeof(uint32_t);
+    fp.arena_bytes = static_cast<uint32_t>(cfg.num_locations) * stride * counter_bits / 8;
+    
+    uint32_t total_pages = (cfg.num_locations + SDM_PAGE_ROWS - 1) / SDM_PAGE_ROWS;
+    if (cfg.cache_pages > 0 && cfg.cache_pages < total_pages) {
+        // Paged: only the page cache is resident, plus its slot and page tables
+        fp.arena_bytes = static_cast<uint32_t>(cfg.cache_pages) * SDM_PAGE_ROWS * stride * counter_bits / 8;
+        fp.internal_bytes += cfg.cache_pages * sizeof(PageSlot) + total_pages * sizeof(uint16_t);
+    }
+    
+    if (cfg.target_activations) {
+        // Per-location distances and the distance histogram
+        fp.internal_bytes += static_cast<uint32_t>(cfg.num_locations) * sizeof(uint16_t) +
+                             (cfg.vector_dim + 1) * sizeof(uint16_t);
+    }
+    
+    if (cfg.use_index && num_ones > 0 && num_ones * 8 <= cfg.vector_dim) {
+        // Postings, offsets, per-location overlap/touched/candidate scratch
+        fp.internal_bytes += static_cast<uint32_t>(cfg.num_locations) * num_ones * sizeof(uint16_t) +
+                             (cfg.vector_dim + 1) * sizeof(uint32_t) +
+                             static_cast<uint32_t>(cfg.num_locations) * 3 * sizeof(uint16_t);
+    }
+    return fp;
+}
+
+bool SparseDistributedMemory::fitsInMemory(const SDMConfig& cfg, uint32_t reserve_bytes) {
+    SDMFootprint fp = footprintFor(cfg);
+    uint32_t free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    bool arena_in_psram = sdmArenaUsesPsram(cfg.use_psram);
+    
+    uint32_t internal_needed = fp.internal_bytes + (arena_in_psram ? 0 : fp.arena_bytes);
+    if (static_cast<uint64_t>(internal_needed) + reserve_bytes > free_internal) return false;
+    return fp.arena_bytes <= sdmLargestArenaBlock(cfg.use_psram);
+}
@@ -7,42 +7,291 @@
 #include <numeric>
 #include <SD.h>
 #include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "sdm_kernels.h"
+#include "sdm_alloc.h"
+#include "sdm_index.h"
+#include "sdm_image.h"
+#include "sdm_telemetry.h"
+#include "sdm_writer.h"
+
+// Vectors processed together per pass over the location table by the batch API
+#define SDM_BATCH_MAX 8
+// Locations tested against a whole batch before moving to the next block
+#define SDM_SCAN_BLOCK 32
+// Scan workers used when SDMConfig::dual_core is set, one pinned to each core
+#define SDM_SCAN_WORKERS 2
+// Counter rows per page in paged mode (SDMConfig::cache_pages); one scan block per page
+#define SDM_PAGE_ROWS SDM_SCAN_BLOCK
+#define SDM_NO_PAGE 0xFFFF
+// Characters per n-gram hashed by SDMEncoder::encodeText past its positional prefix
+#define SDM_TEXT_NGRAM 3
+// Longest findOptimalConfig() spends starting new configs when no saved config exists
+#define SDM_BOOT_SEARCH_MS 60000
+// rebalance(): a location is cold below 1/SDM_COLD_SHARE of the mean access
+// count, hot above SDM_HOT_SHARE times it, and saturated with at least
+// 1/SDM_SATURATED_SHARE of its lanes at a rail
+#define SDM_COLD_SHARE 8
+#define SDM_HOT_SHARE 4
+#define SDM_SATURATED_SHARE 4
+
+// Workers split the table on block boundaries; whole dirty-bitmap words per block keeps them disjoint
+static_assert(SDM_SCAN_BLOCK % 32 == 0, "SDM_SCAN_BLOCK must cover whole dirty-bitmap words");
+// The n-gram window is kept in one uint32
+static_assert(SDM_TEXT_NGRAM >= 1 && SDM_TEXT_NGRAM <= 3, "SDM_TEXT_NGRAM must be 1..3");
 
 struct SDMConfig {
     uint16_t vector_dim = 128;
     uint16_t num_locations = 1000;
     uint16_t access_radius = 20;
+    uint16_t target_activations = 0;  // >0: activate this many nearest locations per op instead of a fixed radius
     float sparsity = 0.03f;  // 3% sparsity as recommended
+    uint32_t seed = 0x5DC0FFEE;  // Addresses are derived from (seed, location), so saved counters stay valid
+    bool use_psram = true;   // Place the counter arena in PSRAM when the board has it
+    bool dual_core = false;  // Split the location scan across worker tasks on both cores
+    bool use_index = true;   // Index address bits so scans skip locations that cannot activate
+    bool sparse_addresses = false;  // Store addresses as set-bit positions instead of packed words
+    uint8_t counter_bits = 16;      // Saturating counter width: 16, 8 or 4 (two per byte)
+    // Checkpoint policy for serviceCheckpoint(); any due condition triggers one (0 disables a condition)
+    uint16_t checkpoint_writes = 32;          // After this many unsaved writes
+    uint32_t checkpoint_interval_ms = 60000;  // Or this long after the first unsaved write
+    uint32_t checkpoint_idle_ms = 5000;       // Or once no write has arrived for this long
+    uint16_t cache_pages = 0;  // >0: counters stay in the SD image, cached in this many SDM_PAGE_ROWS-row pages
+    bool persistent = true;    // false: scratch instance that never reads or writes the SD card
     String config_file = "/sdm_config.json";
 };
 
+// Bytes a configuration needs, split by where it is allocated
+struct SDMFootprint {
+    uint32_t internal_bytes = 0;  // Addresses, access counts, scratch (always internal SRAM)
+    uint32_t arena_bytes = 0;     // Counter arena (PSRAM when available)
+    uint32_t total() const { return internal_bytes + arena_bytes; }
+};
+
 struct SDMStats {
     uint32_t total_writes = 0;
     uint32_t total_reads = 0;
     float last_confidence = 0.0f;
     uint16_t last_activated_locations = 0;
+    uint16_t last_radius = 0;  // Distance cut of the last op (access_radius unless target_activations is set)
     float avg_match_ratio = 0.0f;
 };
 
+// Location utilization from access_counts and counter saturation (see rebalance())
+struct SDMBalanceReport {
+    uint16_t cold_locations = 0;
+    uint16_t hot_locations = 0;
+    uint16_t saturated_locations = 0;  // Not checked in paged mode
+    uint16_t relocated_locations = 0;  // Addresses moved by rebalance() so far (address map entries)
+    uint16_t max_access_count = 0;
+    float mean_access_count = 0.0f;
+};
+
 class SparseDistributedMemory {
+    friend class SDMPerfHarness;  // Times the scan, update and accumulate phases in isolation
+    
 private:
     SDMStats stats;
+    SDMTelemetry telemetry;
+    
+    // Memory storage - addresses and metadata in internal SRAM, counters in one flat arena
+    InternalVector<uint32_t> addresses;               // Hard locations, bit-packed (words_per_vector per location)
+    InternalVector<uint16_t> address_bits;            // Or: address_ones set-bit positions per location (sparse_addresses)
+    uint16_t address_ones = 0;
+    bool sparse_mode = false;
+    uint8_t* counters = nullptr;                      // Signed counters, num_locations x row_bytes, row-major
+    InternalVector<uint16_t> access_counts;           // Usage tracking
+    uint16_t words_per_vector = 0;
+    uint16_t row_stride = 0;                          // Counter lanes per row: vector_dim rounded so rows fill 16 bytes
+    uint16_t row_bytes = 0;                           // row_stride lanes at config.counter_bits each
+    bool counters_in_psram = false;
+    InternalVector<uint32_t> packed_scratch;          // Packs byte-per-bit inputs for the packed API
+    uint8_t* delta_rows = nullptr;                    // +/-strength rows for the write kernel, SDM_BATCH_MAX x deltaBytes()
+    int32_t* read_accum = nullptr;                    // Weighted counter sums for read, SDM_BATCH_MAX x row_stride
+    InternalVector<uint16_t> weight_table;            // Fixed-point read weight per distance 0..access_radius
+    SDMBitIndex address_index;                        // Set-bit position -> locations (SDMConfig::use_index)
+    InternalVector<uint16_t> candidate_scratch;       // Index lookup results
+    
+    // Adaptive activation (SDMConfig::target_activations): every distance of
+    // one query, and a histogram of them to select the k nearest by counting
+    InternalVector<uint16_t> distance_scratch;
+    InternalVector<uint16_t> distance_histogram;
+    uint16_t maxActivationDistance() const { return config.target_activations ? config.vector_dim : config.access_radius; }
+    
+    // Rebalancing: locations whose address no longer comes from (seed, location),
+    // kept in the address map file
+    InternalVector<uint32_t> relocated_rows;          // One bit per location
+    uint32_t address_map_crc = 0;                     // Over the address map records, 0 = none moved
+    void updateAddressMapCrc();
+    void classifyLocations(SDMBalanceReport& report, InternalVector<uint16_t>* cold, InternalVector<uint16_t>* donors);
+    void relocate(uint16_t location, uint16_t donor);
+    void locationAddress(uint16_t location, uint32_t* packed) const;
+    void setLocationAddress(uint16_t location, const uint32_t* packed);  // Marks it relocated
+    void buildAddressIndex();
+    bool saveAddressMap();
+    bool loadAddressMap();
+    
+    // Incremental persistence: rows written since the last checkpoint, and the
+    // image on the card that the journal extends
+    InternalVector<uint32_t> dirty_rows;              // One bit per location
+    uint32_t pending_writes = 0;
+    uint32_t first_pending_ms = 0;
+    uint32_t last_write_ms = 0;
+    bool image_on_card = false;
+    uint32_t image_crc = 0;                           // payload_crc of that image
+    uint32_t journal_bytes = 0;                       // Valid journal length, 0 = no journal
+    uint32_t journal_first_ticket = 0;                // sdmWriter() jobs of the appends still in flight
+    uint32_t journal_last_ticket = 0;                 // 0 = none
+    volatile uint32_t journal_write_us = 0;           // Writer time spent on those appends
+    uint32_t checkpoint_copy_us = 0;                  // Loop time of the checkpoint they belong to
+    bool checkpoint_timing = false;                   // SDM_OP_CHECKPOINT waits for them to reach the card
+    void collectJournalWrites();
+    void markAllDirty();
+    
+    // Fleet sync: rows written since the last exportDelta() (all of them after boot)
+    InternalVector<uint32_t> sync_rows;
+    bool matchesImage(const SDMImageHeader& header) const;
+    void addLaneDeltas(uint8_t* row, int32_t* lanes);
     
-    // Memory storage - using dynamic allocation for ESP32
-    std::vector<std::vector<uint8_t>> addresses;      // Hard locations
-    std::vector<std::vector<int16_t>> memory;         // Signed counters
-    std::vector<uint16_t> access_counts;              // Usage tracking
+    // Paged mode: the counter arena is an LRU cache of image pages, kept in
+    // sync with memory.bin (open r+) by writeback on eviction and checkpoint
+    struct PageSlot {
+        uint16_t page = SDM_NO_PAGE;
+        bool dirty = false;
+        uint32_t last_use = 0;
+    };
+    bool paged = false;
+    InternalVector<PageSlot> page_slots;
+    InternalVector<uint16_t> page_to_slot;            // Cache slot per page, SDM_NO_PAGE if not resident
+    uint32_t page_clock = 0;
+    uint32_t page_faults = 0;
+    uint32_t page_writebacks = 0;
+    uint32_t page_failures = 0;                       // Writebacks that failed; the page stayed cached
+    InternalVector<uint8_t> page_spill;               // One row served uncached when no page can be evicted
+    bool image_marked_open = false;
+    File page_file;
+    
+    // Per-range scan results; with dual_core each worker fills its own and the
+    // caller reduces them, so workers never share writable state
+    struct ScanPartial {
+        uint16_t activated[SDM_BATCH_MAX];
+        int32_t total_weight[SDM_BATCH_MAX];
+        uint8_t weight_shift[SDM_BATCH_MAX];
+    };
+    enum ScanOp : uint8_t { SCAN_WRITE, SCAN_READ, SCAN_EXIT };
+    struct ScanWorker {
+        SparseDistributedMemory* owner = nullptr;
+        TaskHandle_t task = nullptr;
+        uint8_t index = 0;
+        uint16_t begin = 0;
+        uint16_t end = 0;
+        ScanPartial partial;
+    };
+    ScanWorker workers[SDM_SCAN_WORKERS];
+    SemaphoreHandle_t workers_done = nullptr;
+    bool workers_running = false;
+    ScanOp scan_op = SCAN_WRITE;
+    const uint32_t* scan_vectors = nullptr;
+    uint8_t scan_count = 0;
     
     // File paths
     String memory_file = "/sdm/memory.bin";
+    String journal_file = "/sdm/journal.bin";
     String stats_file = "/sdm/stats.json";
+    String sync_file = "/sdm/sync.bin";
+    String address_file = "/sdm/addresses.bin";
     String lib_path = "/lib/";
     
     // Helper functions
-    uint16_t hammingDistance(const std::vector<uint8_t>& v1, const std::vector<uint8_t>& v2);
+    uint16_t hammingDistance(const uint32_t* v1, const uint32_t* v2) const {
+        return SDMKernels::hammingDistance(v1, v2, words_per_vector);
+    }
+    const uint32_t* addressOf(uint16_t location) const { return &addresses[location * words_per_vector]; }
+    
+    // Distance from a query to a location in either address representation.
+    // Sparse form: |a| + |q| - 2 * overlap, probing the query bitmap per set bit.
+    uint16_t locationDistance(uint16_t location, const uint32_t* query, uint16_t query_weight) const {
+        if (!sparse_mode) return hammingDistance(query, addressOf(location));
+        
+        const uint16_t* bits = &address_bits[static_cast<size_t>(location) * address_ones];
+        uint16_t overlap = 0;
+        for (uint16_t k = 0; k < address_ones; k++) {
+            overlap += SDMKernels::testBit(query, bits[k]);
+        }
+        return address_ones + query_weight - 2 * overlap;
+    }
+    uint16_t queryWeight(const uint32_t* query) const {
+        return sparse_mode ? SDMKernels::popcount(query, words_per_vector) : 0;
+    }
+    uint8_t* counterRow(uint16_t location, bool for_write = false) {
+        if (paged) return pagedRow(location, for_write);
+        return counters + static_cast<size_t>(location) * row_bytes;
+    }
+    // Delta rows are int16 for 16-bit counters and int8 for the narrow widths
+    size_t deltaBytes() const { return static_cast<size_t>(row_stride) * (config.counter_bits == 16 ? 2 : 1); }
+    const uint8_t* deltaRow(uint8_t v) const { return delta_rows + v * deltaBytes(); }
+    bool allocateCounters();
+    void releaseCounters();
+    void rebuildWeightTable();
+    void buildDeltaRows(const uint32_t* packed_inputs, uint8_t count, uint8_t strength);
+    uint32_t writeChunk(const uint32_t* packed_inputs, uint8_t count, uint8_t strength);
+    void readChunk(const uint32_t* packed_queries, uint8_t count, uint32_t* packed_outputs, float* confidences);
+    void writeRange(const uint32_t* packed_inputs, uint8_t count, uint16_t begin, uint16_t end, ScanPartial& partial);
+    void readRange(const uint32_t* packed_queries, uint8_t count, uint16_t begin, uint16_t end,
+                   int32_t* accum, ScanPartial& partial);
+    void mergeReadPartials(uint8_t count);
+    uint16_t indexMinOverlap(const uint32_t* query) const;
+    bool indexedScanApplies(const uint32_t* vectors, uint8_t count, uint16_t* min_overlap) const;
+    void writeIndexed(const uint32_t* packed_inputs, uint8_t count, const uint16_t* min_overlap, ScanPartial& partial);
+    void readIndexed(const uint32_t* packed_queries, uint8_t count, const uint16_t* min_overlap, ScanPartial& partial);
+    uint16_t selectNearest(const uint32_t* query, uint16_t& ties);
+    void writeNearest(const uint32_t* packed_inputs, uint8_t count, ScanPartial& partial);
+    void readNearest(const uint32_t* packed_queries, uint8_t count, ScanPartial& partial);
+    void markDirty(uint16_t location) {
+        dirty_rows[location >> 5] |= 1u << (location & 31);
+        sync_rows[location >> 5] |= 1u << (location & 31);
+    }
+    void applyWrite(uint16_t location, const uint8_t* delta) {
+        access_counts[location]++;
+        markDirty(location);
+        uint8_t* row = counterRow(location, true);
+        switch (config.counter_bits) {
+            case 8:
+                SDMKernels::saturatingAddRow8(reinterpret_cast<int8_t*>(row), reinterpret_cast<const int8_t*>(delta), row_stride);
+                break;
+            case 4:
+                SDMKernels::saturatingAddRow4(row, reinterpret_cast<const int8_t*>(delta), row_stride);
+                break;
+            default:
+                SDMKernels::saturatingAddRow(reinterpret_cast<int16_t*>(row), reinterpret_cast<const int16_t*>(delta), row_stride);
+                break;
+        }
+    }
+    void applyRead(uint16_t location, uint16_t dist, int32_t* accum, ScanPartial& partial, uint8_t v);
+    bool startWorkers();
+    void stopWorkers();
+    void dispatchScan(ScanOp op, const uint32_t* vectors, uint8_t count);
+    static void scanWorkerTask(void* arg);
     bool saveMemoryToSD();
     bool loadMemoryFromSD();
-    void generateSparseVector(std::vector<uint8_t>& vector, float sparsity);
+    bool loadMemoryImage(const String& path);
+    bool appendJournal();
+    bool replayJournal();
+    void markCheckpointed();
+    uint8_t* pagedRow(uint16_t location, bool for_write);
+    uint16_t evictPage();
+    bool writeBackSlot(uint16_t slot);
+    bool flushPages();
+    bool openPagedImage();
+    bool createPagedImage();
+    bool recoverPagedImage();
+    bool sealPagedImage();
+    void closePagedImage();
+    uint32_t imageRowsOffset() const {
+        return sizeof(SDMImageHeader) + static_cast<uint32_t>(config.num_locations) * sizeof(uint16_t);
+    }
     
 public:
     SDMConfig config;  // Make config public so benchmark can access it
@@ -50,12 +299,28 @@ public:
     SparseDistributedMemory();
     SparseDistributedMemory(const SDMConfig& cfg);
     ~SparseDistributedMemory();
+    SparseDistributedMemory(const SparseDistributedMemory&) = delete;
+    SparseDistributedMemory& operator=(const SparseDistributedMemory&) = delete;
     
     // Core SDM operations
     bool initialize();
     uint16_t write(const std::vector<uint8_t>& input_vector, uint8_t strength = 1);
     std::pair<std::vector<uint8_t>, float> read(const std::vector<uint8_t>& query_vector);
     
+    // Packed variants: vectors hold wordsPerVector() uint32_t words (see sdm_kernels.h)
+    uint16_t write(const uint32_t* packed_input, uint8_t strength = 1);
+    float read(const uint32_t* packed_query, uint32_t* packed_output);
+    uint16_t wordsPerVector() const { return words_per_vector; }
+    
+    // Regenerate the hard-location address of a location from config.seed
+    void generateAddress(uint16_t location, uint32_t* packed) const;
+    
+    // Batched variants: count vectors stored back to back, wordsPerVector() words each.
+    // Each pass over the location table tests a block of locations against up to
+    // SDM_BATCH_MAX vectors; results match calling write()/read() in order.
+    uint32_t writeBatch(const uint32_t* packed_inputs, uint16_t count, uint8_t strength = 1);
+    void readBatch(const uint32_t* packed_queries, uint16_t count, uint32_t* packed_outputs, float* confidences = nullptr);
+    
     // Configuration management
     bool loadConfig();
     bool saveConfig();
@@ -66,6 +331,48 @@ public:
     bool loadFromSD();
     void clearMemory();
     
+    // Incremental persistence: dirty rows are appended to a journal next to the
+    // image, which is rewritten instead once the journal would outgrow it
+    bool checkpoint();
+    // Journal appends are snapshotted into sdmWriter() buffers and written by
+    // its task; a checkpoint is not due again until the previous one is on the card.
+    bool serviceCheckpoint();  // Checkpoint if the config policy says one is due; call from loop()
+    bool checkpointInFlight() const;
+    uint16_t dirtyRowCount() const;
+    
+    // Memory images at arbitrary paths (same format as memory.bin). stackImage()
+    // saturating-adds an image built for this config and seed onto the counters,
+    // only once its payload CRC checks out; partial is set if a read error
+    // after that left part of it added.
+    bool exportImage(const String& path, uint32_t* payload_crc = nullptr);
+    bool stackImage(const String& path, bool* partial = nullptr);
+    
+    // Fleet merge (sdm_image.h delta format). exportDelta() writes the rows that
+    // changed since the last export as deltas against a baseline image (the
+    // sync file unless baseline is given; all zero if there is none), then
+    // makes the current counters the new baseline. importDelta() saturating-adds
+    // a delta from any node with this config and seed; advance_baseline adds it
+    // to the baseline too, so merged contributions are not exported back.
+    bool exportDelta(const String& path, SDMDeltaEncoding encoding = SDM_DELTA_VARINT, const String& baseline = "");
+    bool importDelta(const String& path, bool advance_baseline = true, const String& baseline = "");
+    
+    // Utilization rebalancing. rebalance() moves up to max_moves cold locations
+    // next to the most used saturated or hot ones: each takes a perturbed copy
+    // of its donor's address and half of its counters and access count, so
+    // reads keep their sums while the pair splits later activations. Moved
+    // addresses are saved to the address map and restored by initialize().
+    // A rebalanced memory no longer shares hard locations with other nodes of
+    // its seed, so images and deltas only merge with its own; importDelta()
+    // refuses a delta whose address map CRC differs.
+    SDMBalanceReport balanceReport();
+    uint16_t rebalance(uint16_t max_moves);
+    // Identifies the current addresses next to the seed: library snapshots and
+    // fleet deltas only apply to memories with the same value
+    uint32_t addressMapCrc() const { return address_map_crc; }
+    // Take over the relocated addresses of a memory with the same configuration
+    // (scratch memories that must match this one's hard locations)
+    bool copyAddressMap(const SparseDistributedMemory& other);
+    
     // Pre-trained library management
     bool loadPretrainedLib(const String& lib_name);
     bool savePretrainedLib(const String& lib_name);
@@ -73,41 +380,164 @@ public:
     
     // Statistics and monitoring
     SDMStats getStats() const { return stats; }
+    uint16_t accessCount(uint16_t location) const { return access_counts[location]; }
     void resetStats();
     bool saveStatsToSD();
+    // Snapshot for the binary telemetry stream (sdm_telemetry.h). Gauges are
+    // read on the spot; saturation covers the next SDM_TELEMETRY_SAMPLE_ROWS rows.
+    void telemetryFrame(SDMTelemetryFrame& frame);
+    void resetTelemetry() { telemetry.reset(); }
     
     // Utility functions
     void printMemoryUsage();
+    SDMFootprint footprint() const { return footprintFor(config); }
+    bool countersInPsram() const { return counters_in_psram; }
+    bool isPaged() const { return paged; }
+    static SDMFootprint footprintFor(const SDMConfig& cfg);
+    static bool fitsInMemory(const SDMConfig& cfg, uint32_t reserve_bytes);
     bool testSDCardAccess();
 };
 
+// Item (cleanup) memory: labelled packed vectors, typically a pretrained
+// library, searched by Hamming distance to turn a noisy SDM read back into the
+// label it came from. With an index, queries bounded by max_distance only
+// visit items that share enough set bits to be within it.
+class SDMCleanupMemory {
+public:
+    struct Match {
+        uint16_t item;
+        uint16_t distance;
+    };
+    
+    // Replace the contents with a library's vectors and labels (labels.txt for v1 files)
+    bool loadLibrary(SparseDistributedMemory* sdm, const String& lib_name, bool use_index = true);
+    // Replace the contents with count packed vectors; label_text holds the labels
+    // back to back, label i spanning [label_offsets[i], label_offsets[i + 1])
+    bool assign(const uint32_t* packed, uint16_t count, uint16_t dim,
+                const uint32_t* label_offsets, const char* label_text, bool use_index = true);
+    void clear();
+    
+    uint16_t size() const { return item_count; }
+    uint16_t vectorDim() const { return vector_dim; }
+    String label(uint16_t item) const;
+    size_t memoryBytes() const;
+    
+    // Up to k items within max_distance of query, nearest first (ties by item
+    // id) in out; returns how many were found
+    uint16_t nearest(const uint32_t* query, Match* out, uint16_t k, uint16_t max_distance = 0xFFFF);
+    
+private:
+    uint16_t vector_dim = 0;
+    uint16_t words_per_vector = 0;
+    uint16_t item_count = 0;
+    InternalVector<uint32_t> items;          // Packed, item_count x words_per_vector
+    InternalVector<uint32_t> label_index;    // item_count + 1 offsets into label_chars
+    InternalVector<char> label_chars;
+    SDMBitIndex index;
+    InternalVector<uint16_t> candidate_scratch;
+    
+    void finishLoad(bool use_index);
+};
+
 // Encoder/Decoder for text and data
 class SDMEncoder {
 private:
     SparseDistributedMemory* sdm;
     uint16_t sequence_length = 32;  // Max sequence length
+    InternalVector<uint32_t> packed_scratch;  // Backs the byte-per-bit overloads
+    
+    // encodeText bit positions split into per-character and per-position
+    // offsets mod vector_dim, so a character costs three adds and ORs
+    InternalVector<uint16_t> char_offsets;      // 3 x 256
+    InternalVector<uint16_t> position_offsets;  // 3 x sequence_length
+    uint16_t table_dim = 0;                     // vector_dim the tables were built for
+    void buildTextTables();
+    
+    SDMCleanupMemory* cleanup = nullptr;
+    uint16_t cleanup_radius = 0;
     
 public:
     SDMEncoder(SparseDistributedMemory* sdm_instance);
     
-    // Text encoding/decoding
+    // Packed variants write or read sdm->wordsPerVector() words in a caller-owned
+    // buffer and never allocate, so they can feed write()/read() directly
+    
+    // Text encoding/decoding. The first sequence_length characters set three
+    // position-dependent bits each; later ones set three bits per hashed
+    // SDM_TEXT_NGRAM-character window, so text of any length streams through.
     std::vector<uint8_t> encodeText(const String& text);
+    void encodeText(const String& text, uint32_t* packed);
+    // With a cleanup memory attached, decodeText returns the label nearest to
+    // the vector within radius (empty if none); without one, a bit-count placeholder
     String decodeText(const std::vector<uint8_t>& vector);
+    String decodeText(const uint32_t* packed);
+    void setCleanupMemory(SDMCleanupMemory* memory, uint16_t radius) {
+        cleanup = memory;
+        cleanup_radius = radius;
+    }
     
     // Numeric encoding
     std::vector<uint8_t> encodeFloat(float value, float min_val = -100.0f, float max_val = 100.0f);
+    void encodeFloat(float value, uint32_t* packed, float min_val = -100.0f, float max_val = 100.0f);
     float decodeFloat(const std::vector<uint8_t>& vector, float min_val = -100.0f, float max_val = 100.0f);
+    float decodeFloat(const uint32_t* packed, float min_val = -100.0f, float max_val = 100.0f);
     
     // Sequence encoding (for time series or multi-dimensional data)
     std::vector<uint8_t> encodeSequence(const std::vector<float>& sequence);
+    void encodeSequence(const float* values, size_t count, uint32_t* packed);
     std::vector<float> decodeSequence(const std::vector<uint8_t>& vector);
+    // Fills up to max_values elements of values; returns how many were written
+    uint16_t decodeSequence(const uint32_t* packed, float* values, uint16_t max_values);
+    uint16_t sequenceLength() const { return sequence_length; }
+};
+
+// Streaming form of SDMEncoder::encodeSequence for continuous sensor input.
+// The window is a ring of window_length segments of bits_per_element bits;
+// push() rewrites only the newest sample's segment. window() rotates the ring
+// into time order. With the default window_length (SDMEncoder::sequenceLength())
+// and range this is exactly encodeSequence() of the last window_length samples,
+// oldest first, so stream and batch vectors can be mixed freely.
+class SDMStreamEncoder {
+private:
+    SparseDistributedMemory* sdm;
+    uint16_t window_length;
+    uint16_t write_stride;           // push() reports a write due every this many samples
+    float min_val;
+    float max_val;
+    uint16_t bits_per_element = 0;
+    uint16_t head = 0;               // Ring segment the next sample replaces
+    uint32_t samples = 0;
+    uint16_t since_due = 0;
+    InternalVector<uint32_t> ring;         // Segments in ring order
+    InternalVector<uint32_t> window_scratch;
+    
+public:
+    SDMStreamEncoder(SparseDistributedMemory* sdm_instance, uint16_t window_length = 32, uint16_t write_stride = 1,
+                     float min_val = -1.0f, float max_val = 1.0f);
+    
+    // Add one sample; returns true when write_stride samples have arrived
+    // since the last due write
+    bool push(float sample);
+    void reset();
+    
+    // Time-ordered window in sdm->wordsPerVector() packed words
+    void window(uint32_t* packed) const;
+    // Write or read the current window through a reused scratch vector
+    uint16_t writeWindow(uint8_t strength = 1);
+    float readWindow(uint32_t* packed_output);
+    
+    uint32_t sampleCount() const { return samples; }
+    bool full() const { return samples >= window_length; }
 };
 
 // Benchmark runner for ESP32-S3
+struct SDMSweepParams;
+
 class SDMBenchmark {
 private:
     String benchmark_results_file = "/sdm_benchmark_results.csv";
     String optimal_config_file = "/sdm_optimal_config.json";
+    String perf_results_file = "/sdm_perf_results.csv";
     
     struct BenchmarkParams {
         std::vector<uint16_t> vector_dims = {32, 64, 128, 256};
@@ -116,6 +546,9 @@ private:
         std::vector<uint8_t> reinforce_cycles = {1, 5, 10, 20, 30};
     };
     
+    // Sweep, log every point to results_file and save the best config
+    bool runSweep(const SDMSweepParams& params, const String& results_file, SDMConfig* best_config = nullptr);
+    
 public:
     SDMBenchmark();
     
@@ -123,13 +556,14 @@ public:
     bool runQuickBenchmark();         // Fast benchmark for basic optimization
     bool runComprehensiveBenchmark(); // Full parameter sweep
     bool runMemoryConstraintTest();   // Test ESP32-S3 memory limits
+    bool runPerfBenchmark(const SDMConfig& config);  // Per-phase latency of one config (SDMPerfHarness)
     
     // Results analysis
     SDMConfig findOptimalConfig();
     bool saveOptimalConfig(const SDMConfig& config);
     
     // Benchmark utilities
-    float testConfiguration(const SDMConfig& config, uint8_t num_tests = 10);
+    float testConfiguration(const SDMConfig& config, uint8_t num_tests = 10, uint8_t reinforcement = 10);
     void logBenchmarkResult(const SDMConfig& config, float performance, float duration);
     bool appendToCSV(const String& filename, const String& data);
 };
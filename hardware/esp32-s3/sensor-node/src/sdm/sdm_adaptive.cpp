@@ -0,0 +1,405 @@
+#include "sdm.h"
+
+uint16_t SparseDistributedMemory::selectNearest(const uint32_t* query, uint16_t& ties) {
+    if (distance_scratch.size() != config.num_locations) {
+        distance_scratch.resize(config.num_locations);
+    }
+    if (distance_histogram.size() != config.vector_dim + 1u) {
+        distance_histogram.resize(config.vector_dim + 1u);
+    }
+    std::fill(distance_histogram.begin(), distance_histogram.end(), 0);
+
+    uint16_t query_weight = queryWeight(query);
+    for (uint16_t i = 0; i < config.num_locations; i++) {
+        uint16_t dist = locationDistance(i, query, query_weight);
+        distance_scratch[i] = dist;
+        distance_histogram[dist]++;
+    }
+
+    // Counting selection: distances are bounded by vector_dim, so walking the
+    // histogram finds the k-th nearest without sorting. Locations at exactly
+    // the returned radius are taken lowest id first until there are k.
+    uint16_t k = std::min(config.target_activations, config.num_locations);
+    uint32_t inside = 0;
+    uint16_t radius = 0;
+    while (inside + distance_histogram[radius] < k) {
+        inside += distance_histogram[radius++];
+    }
+    ties = static_cast<uint16_t>(k - inside);
+    return radius;
+}
+
+void SparseDistributedMemory::writeNearest(const uint32_t* packed_inputs, uint8_t count, ScanPartial& partial) {
+    std::fill(partial.activated, partial.activated + count, 0);
+
+    for (uint8_t v = 0; v < count; v++) {
+        const uint32_t* input = packed_inputs + static_cast<size_t>(v) * words_per_vector;
+        const uint8_t* delta = deltaRow(v);
+        uint16_t ties;
+        uint16_t radius = selectNearest(input, ties);
+
+        for (uint16_t i = 0; i < config.num_locations; i++) {
+            uint16_t dist = distance_scratch[i];
+            if (dist > radius) continue;
+            if (dist == radius) {
+                if (ties == 0) continue;
+                ties--;
+            }
+
+            partial.activated[v]++;
+            applyWrite(i, delta);
+        }
+        stats.last_radius = radius;
+    }
+}
+
+void SparseDistributedMemory::readNearest(const uint32_t* packed_queries, uint8_t count, ScanPartial& partial) {
+    std::fill(partial.activated, partial.activated + count, 0);
+    std::fill(partial.total_weight, partial.total_weight + count, 0);
+    std::fill(partial.weight_shift, partial.weight_shift + count, 0);
+
+    for (uint8_t v = 0; v < count; v++) {
+        const uint32_t* query = packed_queries + static_cast<size_t>(v) * words_per_vector;
+        int32_t* accum = read_accum + static_cast<size_t>(v) * row_stride;
+        uint16_t ties;
+        uint16_t radius = selectNearest(query, ties);
+
+        for (uint16_t i = 0; i < config.num_locations; i++) {
+            uint16_t dist = distance_scratch[i];
+            if (dist > radius) continue;
+            if (dist == radius) {
+                if (ties == 0) continue;
+                ties--;
+            }
+
+            applyRead(i, dist, accum, partial, v);
+        }
+        stats.last_radius = radius;
+    }
+}
+
+void SparseDistributedMemory::locationAddress(uint16_t location, uint32_t* packed) const {
+    if (!sparse_mode) {
+        std::copy(addressOf(location), addressOf(location) + words_per_vector, packed);
+        return;
+    }
+    std::fill(packed, packed + words_per_vector, 0);
+    const uint16_t* bits = &address_bits[static_cast<size_t>(location) * address_ones];
+    for (uint16_t k = 0; k < address_ones; k++) {
+        SDMKernels::setBit(packed, bits[k]);
+    }
+}
+
+void SparseDistributedMemory::setLocationAddress(uint16_t location, const uint32_t* packed) {
+    if (sparse_mode) {
+        uint16_t* bits = &address_bits[static_cast<size_t>(location) * address_ones];
+        for (uint16_t w = 0, k = 0; w < words_per_vector; w++) {
+            for (uint32_t word = packed[w]; word; word &= word - 1) {
+                bits[k++] = w * 32 + __builtin_ctz(word);
+            }
+        }
+    } else {
+        std::copy(packed, packed + words_per_vector, &addresses[location * words_per_vector]);
+    }
+    relocated_rows[location >> 5] |= 1u << (location & 31);
+}
+
+void SparseDistributedMemory::updateAddressMapCrc() {
+    // The same bytes as the address map payload, so a saved map and the live
+    // addresses agree
+    address_map_crc = 0;
+    InternalVector<uint32_t> packed(words_per_vector);
+    for (uint16_t w = 0; w < relocated_rows.size(); w++) {
+        for (uint32_t bits = relocated_rows[w]; bits; bits &= bits - 1) {
+            SDMAddressRecord record;
+            record.location = w * 32 + __builtin_ctz(bits);
+            locationAddress(record.location, packed.data());
+            address_map_crc = sdmCrc32(address_map_crc, &record, sizeof(record));
+            address_map_crc = sdmCrc32(address_map_crc, packed.data(), packed.size() * sizeof(uint32_t));
+        }
+    }
+}
+
+bool SparseDistributedMemory::copyAddressMap(const SparseDistributedMemory& other) {
+    if (other.config.seed != config.seed || other.config.num_locations != config.num_locations ||
+        other.config.vector_dim != config.vector_dim || other.sparse_mode != sparse_mode ||
+        other.address_ones != address_ones) {
+        return false;
+    }
+    InternalVector<uint32_t> packed(words_per_vector);
+    for (uint16_t w = 0; w < other.relocated_rows.size(); w++) {
+        for (uint32_t bits = other.relocated_rows[w]; bits; bits &= bits - 1) {
+            uint16_t location = w * 32 + __builtin_ctz(bits);
+            other.locationAddress(location, packed.data());
+            setLocationAddress(location, packed.data());
+        }
+    }
+    buildAddressIndex();
+    updateAddressMapCrc();
+    return address_map_crc == other.address_map_crc;
+}
+
+void SparseDistributedMemory::classifyLocations(SDMBalanceReport& report, InternalVector<uint16_t>* cold,
+                                                InternalVector<uint16_t>* donors) {
+    report = SDMBalanceReport();
+    uint64_t total = 0;
+    for (uint16_t count : access_counts) {
+        total += count;
+        report.max_access_count = std::max(report.max_access_count, count);
+    }
+    report.mean_access_count = config.num_locations ? static_cast<float>(total) / config.num_locations : 0.0f;
+    for (uint32_t word : relocated_rows) {
+        report.relocated_locations += __builtin_popcount(word);
+    }
+
+    // Paged rows would have to be faulted in to check them
+    bool check_saturation = counters && !paged;
+    int16_t high = static_cast<int16_t>((1 << (config.counter_bits - 1)) - 1);
+    int16_t low = static_cast<int16_t>(-high - 1);
+
+    for (uint16_t i = 0; i < config.num_locations; i++) {
+        // Shares of the mean without dividing: count * num_locations against the total
+        uint64_t scaled = static_cast<uint64_t>(access_counts[i]) * config.num_locations;
+        bool is_cold = total > 0 && scaled * SDM_COLD_SHARE < total;
+        bool is_hot = total > 0 && scaled >= total * SDM_HOT_SHARE;
+
+        bool is_saturated = false;
+        if (check_saturation && access_counts[i] > 0) {
+            const uint8_t* row = counters + static_cast<size_t>(i) * row_bytes;
+            uint16_t at_rail = 0;
+            for (uint16_t lane = 0; lane < config.vector_dim; lane++) {
+                int16_t value = SDMKernels::counterLane(row, config.counter_bits, lane);
+                at_rail += (value == high || value == low);
+            }
+            is_saturated = static_cast<uint32_t>(at_rail) * SDM_SATURATED_SHARE >= config.vector_dim;
+        }
+
+        report.cold_locations += is_cold;
+        report.hot_locations += is_hot;
+        report.saturated_locations += is_saturated;
+        if (is_cold) {
+            if (cold) cold->push_back(i);
+        } else if ((is_hot || is_saturated) && donors) {
+            donors->push_back(i);
+        }
+    }
+
+    // Least used locations move first, next to the most used donors
+    if (cold) {
+        std::stable_sort(cold->begin(), cold->end(),
+                         [this](uint16_t a, uint16_t b) { return access_counts[a] < access_counts[b]; });
+    }
+    if (donors) {
+        std::stable_sort(donors->begin(), donors->end(),
+                         [this](uint16_t a, uint16_t b) { return access_counts[a] > access_counts[b]; });
+    }
+}
+
+SDMBalanceReport SparseDistributedMemory::balanceReport() {
+    SDMBalanceReport report;
+    classifyLocations(report, nullptr, nullptr);
+    return report;
+}
+
+void SparseDistributedMemory::relocate(uint16_t location, uint16_t donor) {
+    // The donor's address with a few set bits swapped for clear ones: same
+    // weight (sparse addresses need it), a short step away from the donor
+    InternalVector<uint32_t> base(words_per_vector);
+    locationAddress(donor, base.data());
+    uint32_t* packed = packed_scratch.data();
+    std::copy(base.begin(), base.end(), packed);
+
+    uint16_t ones = SDMKernels::popcount(base.data(), words_per_vector);
+    uint16_t room = std::min<uint16_t>(ones, config.vector_dim - ones);
+    uint16_t swaps = room ? std::max<uint16_t>(1, room / 8) : 0;
+    uint64_t state = (static_cast<uint64_t>(config.seed) << 32) ^ (location * 0xD1B54A32D192ED03ull) ^
+                     (static_cast<uint64_t>(donor) << 16);
+    for (uint16_t s = 0; s < swaps; s++) {
+        // Only bits the donor had set are cleared and only ones it had clear are
+        // set, so no swap undoes another; expected tries are dim / room per bit
+        for (;;) {
+            uint16_t bit = SDMKernels::reduceRange(static_cast<uint32_t>(SDMKernels::splitmix64(state)), config.vector_dim);
+            if (!SDMKernels::testBit(packed, bit) || !SDMKernels::testBit(base.data(), bit)) continue;
+            packed[bit >> 5] &= ~(1u << (bit & 31));
+            break;
+        }
+        for (;;) {
+            uint16_t bit = SDMKernels::reduceRange(static_cast<uint32_t>(SDMKernels::splitmix64(state)), config.vector_dim);
+            if (SDMKernels::testBit(packed, bit) || SDMKernels::testBit(base.data(), bit)) continue;
+            SDMKernels::setBit(packed, bit);
+            break;
+        }
+    }
+
+    setLocationAddress(location, packed);
+
+    // Halve the donor's counters and give the new neighbour the same half:
+    // the pair reads back about what the donor held, with headroom in both
+    uint8_t* donor_row = counterRow(donor, true);
+    InternalVector<int32_t> lanes(row_stride);
+    for (uint16_t j = 0; j < row_stride; j++) {
+        int32_t value = SDMKernels::counterLane(donor_row, config.counter_bits, j);
+        lanes[j] = value / 2 - value;
+    }
+    addLaneDeltas(donor_row, lanes.data());
+    memcpy(counterRow(location, true), donor_row, row_bytes);
+
+    uint16_t moved = access_counts[donor] / 2;
+    access_counts[location] = moved;
+    access_counts[donor] -= moved;
+    markDirty(location);
+    markDirty(donor);
+}
+
+uint16_t SparseDistributedMemory::rebalance(uint16_t max_moves) {
+    // Moves copy between two rows at once; in paged mode the second fault could evict the first
+    if (paged || !counters) {
+        return 0;
+    }
+
+    SDMBalanceReport report;
+    InternalVector<uint16_t> cold;
+    InternalVector<uint16_t> donors;
+    classifyLocations(report, &cold, &donors);
+
+    uint16_t moves = static_cast<uint16_t>(std::min<size_t>(max_moves, std::min(cold.size(), donors.size())));
+    if (moves == 0) {
+        return 0;
+    }
+    for (uint16_t m = 0; m < moves; m++) {
+        relocate(cold[m], donors[m]);
+    }
+    buildAddressIndex();
+    updateAddressMapCrc();
+
+    // The moved rows go out with the next checkpoint
+    last_write_ms = millis();
+    if (pending_writes == 0) first_pending_ms = last_write_ms;
+    pending_writes += moves;
+
+    if (config.persistent && !saveAddressMap()) {
+        Serial.println("Failed to save SDM address map");
+    }
+    Serial.printf("Rebalanced %u cold locations (%u cold, %u hot, %u saturated)\n", (unsigned)moves,
+                  (unsigned)report.cold_locations, (unsigned)report.hot_locations, (unsigned)report.saturated_locations);
+    return moves;
+}
+
+bool SparseDistributedMemory::saveAddressMap() {
+    // Written directly like the image, after anything still queued
+    sdmWriter().flush();
+
+    SDMAddressHeader header;
+    header.seed = config.seed;
+    header.num_locations = config.num_locations;
+    header.vector_dim = config.vector_dim;
+    for (uint32_t word : relocated_rows) {
+        header.location_count += __builtin_popcount(word);
+    }
+    if (header.location_count == 0) {
+        if (SD.exists(address_file)) SD.remove(address_file);
+        return true;
+    }
+
+    if (!SD.exists("/sdm")) {
+        SD.mkdir("/sdm");
+    }
+    // Built next to the old map and swapped in, so a torn write keeps the previous one
+    String temp_file = address_file + ".tmp";
+    File file = SD.open(temp_file, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    bool written = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+
+    size_t record_bytes = sizeof(SDMAddressRecord) + static_cast<size_t>(words_per_vector) * sizeof(uint32_t);
+    InternalVector<uint8_t> block;
+    block.reserve(std::max<size_t>(SDM_IMAGE_BLOCK, record_bytes));
+    InternalVector<uint32_t> packed(words_per_vector);
+    for (uint16_t w = 0; written && w < relocated_rows.size(); w++) {
+        for (uint32_t bits = relocated_rows[w]; written && bits; bits &= bits - 1) {
+            SDMAddressRecord record;
+            record.location = w * 32 + __builtin_ctz(bits);
+            locationAddress(record.location, packed.data());
+
+            if (!block.empty() && block.size() + record_bytes > SDM_IMAGE_BLOCK) {
+                header.payload_crc = sdmCrc32(header.payload_crc, block.data(), block.size());
+                written = file.write(block.data(), block.size()) == block.size();
+                block.clear();
+            }
+            const uint8_t* at = reinterpret_cast<const uint8_t*>(&record);
+            block.insert(block.end(), at, at + sizeof(record));
+            at = reinterpret_cast<const uint8_t*>(packed.data());
+            block.insert(block.end(), at, at + packed.size() * sizeof(uint32_t));
+        }
+    }
+    if (written && !block.empty()) {
+        header.payload_crc = sdmCrc32(header.payload_crc, block.data(), block.size());
+        written = file.write(block.data(), block.size()) == block.size();
+    }
+
+    sdmSealAddressHeader(header);
+    written = written && file.seek(0) && file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+    file.close();
+    if (!written) {
+        SD.remove(temp_file);
+        return false;
+    }
+    if (SD.exists(address_file)) SD.remove(address_file);
+    return SD.rename(temp_file, address_file);
+}
+
+bool SparseDistributedMemory::loadAddressMap() {
+    if (!SD.exists(address_file)) {
+        return false;
+    }
+    File file = SD.open(address_file);
+    if (!file) {
+        return false;
+    }
+
+    SDMAddressHeader header;
+    size_t record_bytes = sizeof(SDMAddressRecord) + static_cast<size_t>(words_per_vector) * sizeof(uint32_t);
+    bool usable = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                  sdmAddressHeaderValid(header) && header.seed == config.seed &&
+                  header.num_locations == config.num_locations && header.vector_dim == config.vector_dim &&
+                  header.location_count <= config.num_locations;
+
+    // Check the whole map before moving anything
+    InternalVector<uint8_t> block(std::max<size_t>(SDM_IMAGE_BLOCK, record_bytes));
+    uint32_t crc = 0;
+    for (uint32_t remaining = usable ? header.location_count * record_bytes : 0; usable && remaining > 0;) {
+        size_t chunk = std::min<size_t>(remaining, block.size());
+        usable = file.read(block.data(), chunk) == chunk;
+        crc = sdmCrc32(crc, block.data(), chunk);
+        remaining -= chunk;
+    }
+    if (!usable || crc != header.payload_crc || !file.seek(sizeof(header))) {
+        // Seed-derived addresses stay; rows moved on that run read from where they were generated
+        file.close();
+        Serial.println("Ignoring unusable SDM address map");
+        return false;
+    }
+
+    uint16_t applied = 0;
+    SDMAddressRecord record;
+    uint32_t* packed = packed_scratch.data();
+    for (uint32_t r = 0; r < header.location_count; r++) {
+        if (file.read((uint8_t*)&record, sizeof(record)) != sizeof(record) ||
+            file.read((uint8_t*)packed, words_per_vector * sizeof(uint32_t)) != words_per_vector * sizeof(uint32_t)) {
+            break;
+        }
+        if (record.location >= config.num_locations) continue;
+        // A move keeps the address weight; anything else was not written for this sparsity
+        uint16_t weight = sparse_mode ? address_ones : SDMKernels::popcount(addressOf(record.location), words_per_vector);
+        if (SDMKernels::popcount(packed, words_per_vector) != weight) continue;
+
+        setLocationAddress(record.location, packed);
+        applied++;
+    }
+    file.close();
+    updateAddressMapCrc();
+
+    Serial.printf("Restored %u relocated addresses\n", (unsigned)applied);
+    return true;
+}
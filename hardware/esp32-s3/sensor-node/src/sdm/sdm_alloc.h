@@ -0,0 +1,79 @@
+#ifndef SDM_ALLOC_H
+#define SDM_ALLOC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <vector>
+#include <esp_heap_caps.h>
+
+// Counter rows are aligned to 16 bytes so the SIMD kernels can use aligned
+// 128-bit loads and stores.
+#define SDM_ARENA_ALIGN 16
+
+// Allocator that pins a container to internal SRAM. With PSRAM enabled the
+// Arduino core may serve large malloc() calls from PSRAM, which is too slow
+// for data touched on every scan (addresses, access counts).
+template <typename T>
+struct SDMInternalAllocator {
+    typedef T value_type;
+
+    SDMInternalAllocator() = default;
+    template <typename U> SDMInternalAllocator(const SDMInternalAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        void* p = heap_caps_malloc(n * sizeof(T), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!p) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, size_t) { heap_caps_free(p); }
+
+    template <typename U> bool operator==(const SDMInternalAllocator<U>&) const { return true; }
+    template <typename U> bool operator!=(const SDMInternalAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using InternalVector = std::vector<T, SDMInternalAllocator<T>>;
+
+// Allocate a zeroed, aligned arena. When prefer_psram is set and the board has
+// PSRAM the arena is placed there, otherwise it falls back to internal RAM.
+inline void* sdmAllocArena(size_t bytes, bool prefer_psram, bool* in_psram) {
+    void* arena = nullptr;
+    *in_psram = false;
+
+#if defined(BOARD_HAS_PSRAM)
+    if (prefer_psram) {
+        arena = heap_caps_aligned_calloc(SDM_ARENA_ALIGN, 1, bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        *in_psram = (arena != nullptr);
+    }
+#else
+    (void)prefer_psram;
+#endif
+
+    if (!arena) {
+        arena = heap_caps_aligned_calloc(SDM_ARENA_ALIGN, 1, bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    return arena;
+}
+
+inline void sdmFreeArena(void* arena) {
+    if (arena) heap_caps_free(arena);
+}
+
+// Whether an arena requested with prefer_psram would currently land in PSRAM
+inline bool sdmArenaUsesPsram(bool prefer_psram) {
+#if defined(BOARD_HAS_PSRAM)
+    return prefer_psram && heap_caps_get_free_size(MALLOC_CAP_SPIRAM) > 0;
+#else
+    (void)prefer_psram;
+    return false;
+#endif
+}
+
+// Largest arena that could currently be placed, used for capacity planning
+inline size_t sdmLargestArenaBlock(bool prefer_psram) {
+    return heap_caps_get_largest_free_block(sdmArenaUsesPsram(prefer_psram) ? MALLOC_CAP_SPIRAM
+                                                                             : MALLOC_CAP_INTERNAL);
+}
+
+#endif
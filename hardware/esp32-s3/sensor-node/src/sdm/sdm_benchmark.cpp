@@ -1,4 +1,6 @@
 #include "sdm.h"
+#include "sdm_perf.h"
+#include "sdm_sweep.h"
 
 SDMBenchmark::SDMBenchmark() {
     // Initialize benchmark results directory
@@ -11,122 +13,88 @@ bool SDMBenchmark::runQuickBenchmark() {
     Serial.println("=== Running Quick SDM Benchmark ===");
     
     // Quick test with limited parameters to find baseline
-    std::vector<uint16_t> quick_dims = {32, 64};
-    std::vector<uint16_t> quick_locations = {100, 200};
-    std::vector<float> quick_factors = {0.2f, 0.4f, 0.6f};
-    
-    float best_performance = 0.0f;
-    SDMConfig best_config;
-    
-    File csvFile = SD.open(benchmark_results_file, FILE_WRITE);
-    if (!csvFile) {
-        Serial.println("Failed to open benchmark results file");
+    SDMSweepParams quick;
+    quick.vector_dims = {32, 64};
+    quick.num_locations = {100, 200};
+    quick.radius_factors = {0.2f, 0.4f, 0.6f};
+    quick.reinforce_cycles = {5, 15, 30};
+    quick.num_tests = 5;
+    quick.reserve_bytes = 50000; // Keep 50KB free
+    
+    return runSweep(quick, benchmark_results_file);
+}
+
+bool SDMBenchmark::runPerfBenchmark(const SDMConfig& config) {
+    Serial.println("=== Running SDM Phase Timing ===");
+    
+    // The harness builds a second memory of the same size next to the live one
+    SDMConfig perf_config = config;
+    perf_config.cache_pages = 0;
+    if (!SparseDistributedMemory::fitsInMemory(perf_config, 50000)) {
+        Serial.println("Not enough memory for a scratch copy of this config");
         return false;
     }
     
-    // Write CSV header
-    csvFile.println("vector_dim,num_locations,access_radius,radius_factor,reinforcement,match_ratio,confidence,duration_ms,memory_usage");
-    
-    uint16_t test_count = 0;
-    uint16_t total_tests = quick_dims.size() * quick_locations.size() * quick_factors.size() * 3; // 3 reinforcement levels
-    
-    for (uint16_t dim : quick_dims) {
-        for (uint16_t locations : quick_locations) {
-            for (float factor : quick_factors) {
-                for (uint8_t reinforce : {5, 15, 30}) {
-                    test_count++;
-                    
-                    SDMConfig test_config;
-                    test_config.vector_dim = dim;
-                    test_config.num_locations = locations;
-                    test_config.access_radius = static_cast<uint16_t>(dim * factor);
-                    
-                    Serial.printf("Test %d/%d: dim=%d, locs=%d, radius=%d, reinforce=%d\n", 
-                                  test_count, total_tests, dim, locations, test_config.access_radius, reinforce);
-                    
-                    unsigned long start_time = millis();
-                    float performance = testConfiguration(test_config, 5); // 5 test iterations
-                    unsigned long duration = millis() - start_time;
-                    
-                    // Calculate memory usage
-                    uint32_t memory_usage = locations * dim * 3 + locations * 2; // bytes
-                    
-                    // Log to CSV
-                    String csv_line = String(dim) + "," + String(locations) + "," + 
-                                      String(test_config.access_radius) + "," + String(factor, 2) + "," +
-                                      String(reinforce) + "," + String(performance, 3) + "," +
-                                      String(0.0f, 2) + "," + String(duration) + "," + String(memory_usage);
-                    csvFile.println(csv_line);
-                    csvFile.flush();
-                    
-                    if (performance > best_performance) {
-                        best_performance = performance;
-                        best_config = test_config;
-                    }
-                    
-                    // Memory check
-                    if (ESP.getFreeHeap() < 50000) { // Keep 50KB free
-                        Serial.println("Memory getting low, stopping benchmark");
-                        break;
-                    }
-                }
-            }
+    // Counter width is the main kernel variable; time each one that fits
+    SDMPerfHarness harness;
+    for (uint8_t bits : {16, 8, 4}) {
+        perf_config.counter_bits = bits;
+        if (!SparseDistributedMemory::fitsInMemory(perf_config, 50000) || !harness.run(perf_config)) {
+            Serial.printf("Skipped %d-bit counters\n", bits);
         }
     }
     
-    csvFile.close();
-    
-    Serial.printf("Best performance: %.3f with dim=%d, locations=%d, radius=%d\n", 
-                  best_performance, best_config.vector_dim, best_config.num_locations, best_config.access_radius);
-    
-    // Save optimal config
-    saveOptimalConfig(best_config);
-    
-    return true;
+    harness.print();
+    return harness.saveCSV(perf_results_file);
 }
 
-float SDMBenchmark::testConfiguration(const SDMConfig& config, uint8_t num_tests) {
-    SparseDistributedMemory test_sdm(config);
+float SDMBenchmark::testConfiguration(const SDMConfig& config, uint8_t num_tests, uint8_t reinforcement) {
+    // Scratch memory: must neither pick up nor overwrite the node's saved config and image
+    SDMConfig scratch_config = config;
+    scratch_config.persistent = false;
+    SparseDistributedMemory test_sdm(scratch_config);
     if (!test_sdm.initialize()) {
         return 0.0f;
     }
     
-    float total_match_ratio = 0.0f;
+    uint16_t words = test_sdm.wordsPerVector();
+    std::vector<uint32_t> test_vectors(static_cast<size_t>(num_tests) * words, 0);
+    std::vector<uint32_t> output_vectors(test_vectors.size(), 0);
+    
+    uint16_t num_ones = static_cast<uint16_t>(config.vector_dim * config.sparsity);
+    std::vector<uint16_t> indices(config.vector_dim);
     
     for (uint8_t test = 0; test < num_tests; test++) {
         // Generate random sparse test vector
-        std::vector<uint8_t> test_vector(config.vector_dim, 0);
-        uint16_t num_ones = static_cast<uint16_t>(config.vector_dim * config.sparsity);
+        uint32_t* test_vector = &test_vectors[test * words];
         
         // Randomly set bits (ensure no duplicates)
-        std::vector<uint16_t> indices;
         for (uint16_t i = 0; i < config.vector_dim; i++) {
-            indices.push_back(i);
+            indices[i] = i;
         }
         
         // Shuffle and take first num_ones elements
         for (uint16_t i = 0; i < num_ones && i < config.vector_dim; i++) {
             uint16_t swap_idx = random(config.vector_dim - i) + i;
             std::swap(indices[i], indices[swap_idx]);
-            test_vector[indices[i]] = 1;
-        }
-        
-        // Write pattern multiple times (reinforcement)
-        for (uint8_t i = 0; i < 10; i++) {
-            test_sdm.write(test_vector);
-        }
-        
-        // Read back and calculate match ratio
-        auto [output_vector, confidence] = test_sdm.read(test_vector);
-        
-        uint16_t matches = 0;
-        for (uint16_t i = 0; i < config.vector_dim; i++) {
-            if (test_vector[i] == output_vector[i]) {
-                matches++;
-            }
+            SDMKernels::setBit(test_vector, indices[i]);
         }
+    }
+    
+    // Write all patterns multiple times (reinforcement), one batch per cycle
+    for (uint8_t i = 0; i < reinforcement; i++) {
+        test_sdm.writeBatch(test_vectors.data(), num_tests);
+    }
+    
+    // Read all patterns back and calculate match ratio
+    test_sdm.readBatch(test_vectors.data(), num_tests, output_vectors.data());
+    
+    float total_match_ratio = 0.0f;
+    for (uint8_t test = 0; test < num_tests; test++) {
+        uint16_t mismatches = SDMKernels::hammingDistance(&test_vectors[test * words],
+                                                          &output_vectors[test * words], words);
         
-        float match_ratio = static_cast<float>(matches) / config.vector_dim;
+        float match_ratio = static_cast<float>(config.vector_dim - mismatches) / config.vector_dim;
         total_match_ratio += match_ratio;
     }
     
@@ -135,88 +103,45 @@ float SDMBenchmark::testConfiguration(const SDMConfig& config, uint8_t num_tests
 
 bool SDMBenchmark::runComprehensiveBenchmark() {
     Serial.println("=== Running Comprehensive SDM Benchmark ===");
-    Serial.println("Warning: This may take several hours!");
     
     BenchmarkParams params;
-    uint32_t total_configs = params.vector_dims.size() * params.num_locations.size() * 
-                             params.radius_factors.size() * params.reinforce_cycles.size();
-    
-    Serial.printf("Total configurations to test: %d\n", total_configs);
-    Serial.printf("Estimated time: %.1f hours\n", total_configs * 30.0f / 3600.0f); // 30 sec per test
-    
-    File csvFile = SD.open("/sdm_comprehensive_benchmark.csv", FILE_WRITE);
-    if (!csvFile) {
-        Serial.println("Failed to create comprehensive benchmark file");
+    SDMSweepParams sweep;
+    sweep.vector_dims = params.vector_dims;
+    sweep.num_locations = params.num_locations;
+    sweep.radius_factors = params.radius_factors;
+    sweep.reinforce_cycles = params.reinforce_cycles;
+    sweep.num_tests = 3; // 3 patterns for speed
+    
+    return runSweep(sweep, "/sdm_comprehensive_benchmark.csv");
+}
+
+bool SDMBenchmark::runSweep(const SDMSweepParams& params, const String& results_file, SDMConfig* best_config) {
+    SDMSweep sweep;
+    if (!sweep.run(params)) {
+        Serial.println("No benchmark configuration could be run");
         return false;
     }
-    
-    csvFile.println("vector_dim,num_locations,access_radius,radius_factor,reinforcement,match_ratio,confidence,duration_ms,memory_usage,free_heap");
-    
-    uint32_t config_count = 0;
-    float best_performance = 0.0f;
-    SDMConfig best_config;
-    
-    for (uint16_t dim : params.vector_dims) {
-        for (uint16_t locations : params.num_locations) {
-            // Check memory constraints
-            uint32_t required_memory = locations * dim * 3 + locations * 2;
-            if (required_memory > (ESP.getFreeHeap() - 100000)) { // Keep 100KB free
-                Serial.printf("Skipping dim=%d, locations=%d (insufficient memory)\n", dim, locations);
-                continue;
-            }
-            
-            for (float factor : params.radius_factors) {
-                for (uint8_t reinforce : params.reinforce_cycles) {
-                    config_count++;
-                    
-                    SDMConfig test_config;
-                    test_config.vector_dim = dim;
-                    test_config.num_locations = locations;
-                    test_config.access_radius = static_cast<uint16_t>(dim * factor);
-                    
-                    Serial.printf("Config %d/%d: dim=%d, locs=%d, r=%d, reinforce=%d\n", 
-                                  config_count, total_configs, dim, locations, test_config.access_radius, reinforce);
-                    
-                    unsigned long start_time = millis();
-                    float performance = testConfiguration(test_config, 3); // 3 iterations for speed
-                    unsigned long duration = millis() - start_time;
-                    
-                    uint32_t memory_usage = required_memory;
-                    uint32_t free_heap = ESP.getFreeHeap();
-                    
-                    // Save result
-                    String csv_line = String(dim) + "," + String(locations) + "," + 
-                                      String(test_config.access_radius) + "," + String(factor, 2) + "," +
-                                      String(reinforce) + "," + String(performance, 4) + "," +
-                                      String(0.0f, 2) + "," + String(duration) + "," + 
-                                      String(memory_usage) + "," + String(free_heap);
-                    csvFile.println(csv_line);
-                    csvFile.flush();
-                    
-                    if (performance > best_performance) {
-                        best_performance = performance;
-                        best_config = test_config;
-                    }
-                    
-                    // Progress update every 20 configs
-                    if (config_count % 20 == 0) {
-                        Serial.printf("Progress: %d/%d (%.1f%%), Best: %.3f\n", 
-                                      config_count, total_configs, 
-                                      100.0f * config_count / total_configs, best_performance);
-                    }
-                }
-            }
-        }
+    if (!sweep.saveCSV(results_file)) {
+        Serial.println("Failed to write benchmark results file");
     }
     
-    csvFile.close();
+    SDMSweepResult best;
+    sweep.best(&best);
+    SDMConfig config;
+    config.vector_dim = best.config.vector_dim;
+    config.num_locations = best.config.num_locations;
+    config.access_radius = best.config.access_radius;
+    config.sparsity = best.config.sparsity;
+    config.seed = best.config.seed;
+    config.counter_bits = best.config.counter_bits;
     
-    Serial.printf("Comprehensive benchmark complete!\n");
-    Serial.printf("Best performance: %.3f\n", best_performance);
-    Serial.printf("Best config: dim=%d, locations=%d, radius=%d\n", 
-                  best_config.vector_dim, best_config.num_locations, best_config.access_radius);
+    Serial.printf("Best performance: %.3f (match %.3f) with dim=%d, locations=%d, radius=%d, reinforce=%d\n",
+                  best.score, best.match_ratio, config.vector_dim, config.num_locations,
+                  config.access_radius, best.reinforcement);
     
-    saveOptimalConfig(best_config);
+    // Save optimal config
+    saveOptimalConfig(config);
+    if (best_config) *best_config = config;
     return true;
 }
 
@@ -226,30 +151,37 @@ bool SDMBenchmark::runMemoryConstraintTest() {
     File csvFile = SD.open("/sdm_memory_test.csv", FILE_WRITE);
     if (!csvFile) return false;
     
-    csvFile.println("vector_dim,num_locations,memory_required,free_heap_before,free_heap_after,initialization_success,test_performance");
+    csvFile.println("vector_dim,num_locations,memory_required,internal_bytes,arena_bytes,arena_in_psram,free_heap_before,free_heap_after,free_psram_before,free_psram_after,initialization_success,test_performance");
     
     std::vector<uint16_t> test_dims = {32, 64, 128, 256, 512, 1024};
     std::vector<uint16_t> test_locations = {100, 500, 1000, 2000, 5000, 8000, 10000};
     
     for (uint16_t dim : test_dims) {
         for (uint16_t locations : test_locations) {
-            uint32_t required_memory = locations * dim * 3 + locations * 2;
+            SDMConfig test_config;
+            test_config.vector_dim = dim;
+            test_config.num_locations = locations;
+            test_config.access_radius = dim / 4; // 25% radius
+            test_config.persistent = false;
+            
+            SDMFootprint fp = SparseDistributedMemory::footprintFor(test_config);
             uint32_t free_heap_before = ESP.getFreeHeap();
+            uint32_t free_psram_before = ESP.getFreePsram();
             
-            Serial.printf("Testing dim=%d, locations=%d (%.1f KB required)\n", 
-                          dim, locations, required_memory / 1024.0f);
+            Serial.printf("Testing dim=%d, locations=%d (%.1f KB internal + %.1f KB counters)\n", 
+                          dim, locations, fp.internal_bytes / 1024.0f, fp.arena_bytes / 1024.0f);
             
             bool success = false;
+            bool in_psram = false;
             float performance = 0.0f;
             
-            if (required_memory < (free_heap_before - 50000)) { // Keep 50KB free
-                SDMConfig test_config;
-                test_config.vector_dim = dim;
-                test_config.num_locations = locations;
-                test_config.access_radius = dim / 4; // 25% radius
-                
-                SparseDistributedMemory test_sdm(test_config);
-                success = test_sdm.initialize();
+            if (SparseDistributedMemory::fitsInMemory(test_config, 50000)) { // Keep 50KB free
+                // Probe allocation, then release it before the functional test allocates its own
+                {
+                    SparseDistributedMemory test_sdm(test_config);
+                    success = test_sdm.initialize();
+                    in_psram = test_sdm.countersInPsram();
+                }
                 
                 if (success) {
                     performance = testConfiguration(test_config, 2); // Quick test
@@ -257,11 +189,14 @@ bool SDMBenchmark::runMemoryConstraintTest() {
             }
             
             uint32_t free_heap_after = ESP.getFreeHeap();
+            uint32_t free_psram_after = ESP.getFreePsram();
             
             String csv_line = String(dim) + "," + String(locations) + "," + 
-                              String(required_memory) + "," + String(free_heap_before) + "," +
-                              String(free_heap_after) + "," + String(success ? 1 : 0) + "," + 
-                              String(performance, 3);
+                              String(fp.total()) + "," + String(fp.internal_bytes) + "," +
+                              String(fp.arena_bytes) + "," + String(in_psram ? 1 : 0) + "," +
+                              String(free_heap_before) + "," + String(free_heap_after) + "," +
+                              String(free_psram_before) + "," + String(free_psram_after) + "," +
+                              String(success ? 1 : 0) + "," + String(performance, 3);
             csvFile.println(csv_line);
             csvFile.flush();
             
@@ -292,7 +227,10 @@ SDMConfig SDMBenchmark::findOptimalConfig() {
                 config.vector_dim = doc["vector_dim"];
                 config.num_locations = doc["num_locations"];
                 config.access_radius = doc["access_radius"];
+                config.target_activations = doc["target_activations"] | config.target_activations;
                 config.sparsity = doc["sparsity"];
+                config.seed = doc["seed"] | config.seed;
+                config.counter_bits = doc["counter_bits"] | config.counter_bits;
                 
                 Serial.println("Loaded optimal config from file");
                 return config;
@@ -300,8 +238,23 @@ SDMConfig SDMBenchmark::findOptimalConfig() {
         }
     }
     
-    // Skip benchmark for ESP32-S3, use safe defaults
-    Serial.println("No optimal config found, using ESP32-S3 safe defaults");
+    // No saved result: search a bounded grid now. Recall only needs a few
+    // patterns; the time budget keeps boot from stalling on a slow card.
+    Serial.println("No optimal config found, running boot-time search");
+    SDMSweepParams search;
+    search.vector_dims = {64, 128, 256};
+    search.num_locations = {500, 1000, 2000};
+    search.radius_factors = {0.03f, 0.05f, 0.1f, 0.2f};
+    search.reinforce_cycles = {1, 5, 10};
+    search.num_tests = 8;
+    search.time_budget_ms = SDM_BOOT_SEARCH_MS;
+    
+    SDMConfig found;
+    if (runSweep(search, benchmark_results_file, &found)) {
+        return found;
+    }
+    
+    Serial.println("Boot search failed, using ESP32-S3 safe defaults");
 
     SDMConfig default_config;
     default_config.vector_dim = 16;        // Very small - only ~800 bytes
@@ -319,7 +272,10 @@ bool SDMBenchmark::saveOptimalConfig(const SDMConfig& config) {
     doc["vector_dim"] = config.vector_dim;
     doc["num_locations"] = config.num_locations;
     doc["access_radius"] = config.access_radius;
+    doc["target_activations"] = config.target_activations;
     doc["sparsity"] = config.sparsity;
+    doc["seed"] = config.seed;
+    doc["counter_bits"] = config.counter_bits;
     doc["timestamp"] = millis();
     doc["version"] = "1.0";
     
@@ -345,13 +301,8 @@ void SDMBenchmark::logBenchmarkResult(const SDMConfig& config, float performance
 }
 
 bool SDMBenchmark::appendToCSV(const String& filename, const String& data) {
-    File file = SD.open(filename, FILE_APPEND);
-    if (!file) {
-        Serial.printf("Failed to append to %s\n", filename.c_str());
-        return false;
-    }
-    
-    file.println(data);
-    file.close();
-    return true;
+    // Queued for the writer task so logging doesn't stall the measurement;
+    // a failed append is reported by the writer
+    String line = data + "\r\n";
+    return sdmWriter().write(filename, line.c_str(), line.length(), SDM_WRITE_APPEND) != 0;
 }
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "sdm.h"
+
+uint16_t SparseDistributedMemory::dirtyRowCount() const {
+    uint32_t count = 0;
+    for (uint32_t word : dirty_rows) {
+        count += __builtin_popcount(word);
+    }
+    return static_cast<uint16_t>(count);
+}
+
+void SparseDistributedMemory::markCheckpointed() {
+    std::fill(dirty_rows.begin(), dirty_rows.end(), 0);
+    pending_writes = 0;
+}
+
+void SparseDistributedMemory::markAllDirty() {
+    std::fill(dirty_rows.begin(), dirty_rows.end(), ~0u);
+    if (config.num_locations % 32 && !dirty_rows.empty()) {
+        dirty_rows.back() = (1u << (config.num_locations % 32)) - 1;
+    }
+    std::fill(sync_rows.begin(), sync_rows.end(), ~0u);
+}
+
+bool SparseDistributedMemory::checkpointInFlight() const {
+    return journal_last_ticket && !sdmWriter().done(journal_last_ticket);
+}
+
+void SparseDistributedMemory::collectJournalWrites() {
+    if (!journal_last_ticket || checkpointInFlight()) return;
+
+    if (sdmWriter().failedSince(journal_first_ticket)) {
+        // The tail may be torn and the rows were already marked clean: rewrite
+        // the whole image at the next deadline instead
+        Serial.println("SDM journal append failed");
+        image_on_card = false;
+        markAllDirty();
+        if (pending_writes == 0) {
+            pending_writes = 1;
+            first_pending_ms = last_write_ms = millis();
+        }
+    }
+    if (checkpoint_timing) {
+        telemetry.recordElapsed(SDM_OP_CHECKPOINT, checkpoint_copy_us + journal_write_us);
+        checkpoint_timing = false;
+    }
+    journal_last_ticket = 0;
+}
+
+bool SparseDistributedMemory::checkpoint() {
+    uint16_t dirty = dirtyRowCount();
+    if (dirty == 0) {
+        pending_writes = 0;
+        return true;
+    }
+
+    // Paged rows already live in the image; write back the dirty pages in place
+    if (paged) {
+        return flushPages();
+    }
+
+    // Rewrite the image when there is none to extend, or when the journal
+    // would grow past the image and cost more to replay than to rewrite
+    uint32_t record_bytes = sizeof(SDMJournalRecord) + row_bytes;
+    uint32_t image_bytes = sizeof(SDMImageHeader) +
+                           static_cast<uint32_t>(config.num_locations) * (sizeof(uint16_t) + row_bytes);
+    if (!image_on_card || journal_bytes + static_cast<uint32_t>(dirty) * record_bytes > image_bytes) {
+        return saveMemoryToSD();
+    }
+    return appendJournal();
+}
+
+bool SparseDistributedMemory::serviceCheckpoint() {
+    collectJournalWrites();
+    if (pending_writes == 0 || !config.persistent) return false;
+    // Back-pressure: rows written while the last checkpoint is still being
+    // flushed stay dirty and go out with the next one
+    if (checkpointInFlight()) return false;
+
+    uint32_t now = millis();
+    bool due = (config.checkpoint_writes && pending_writes >= config.checkpoint_writes) ||
+               (config.checkpoint_interval_ms && now - first_pending_ms >= config.checkpoint_interval_ms) ||
+               (config.checkpoint_idle_ms && now - last_write_ms >= config.checkpoint_idle_ms);
+    if (!due) return false;
+
+    uint32_t started_us = SDMTelemetry::start();
+    bool checkpointed = checkpoint();
+    if (checkpointInFlight()) {
+        // The journal append is still with the writer task; it is recorded
+        // with the writer's SD time once on the card (collectJournalWrites())
+        checkpoint_copy_us = SDMTelemetry::start() - started_us;
+        checkpoint_timing = true;
+    } else {
+        telemetry.record(SDM_OP_CHECKPOINT, started_us);
+    }
+    if (!checkpointed) {
+        // Dirty rows are kept; retry at the next interval/idle deadline instead of every loop
+        Serial.println("SDM checkpoint failed");
+        pending_writes = 1;
+        first_pending_ms = last_write_ms = now;
+        return false;
+    }
+    return true;
+}
+
+bool SparseDistributedMemory::appendJournal() {
+    SDMWriter& writer = sdmWriter();
+    if (!journal_last_ticket) journal_write_us = 0;
+    SDMWriteBuffer* buffer = writer.acquire();
+    SDMWriteMode mode = SDM_WRITE_APPEND;
+    if (journal_bytes == 0) {
+        SDMJournalHeader header;
+        header.seed = config.seed;
+        header.num_locations = config.num_locations;
+        header.vector_dim = config.vector_dim;
+        header.counter_bits = config.counter_bits;
+        header.row_bytes = row_bytes;
+        header.base_crc = image_crc;
+        sdmSealJournalHeader(header);
+        buffer->append(&header, sizeof(header));
+        mode = SDM_WRITE_REPLACE;
+    }
+
+    // Snapshot the dirty rows into writer buffers; while one is being written
+    // the next fills, and one record is never split across buffers
+    size_t record_bytes = sizeof(SDMJournalRecord) + row_bytes;
+    uint32_t appended = buffer->length;
+    uint32_t first_ticket = 0;
+
+    for (uint16_t w = 0; w < dirty_rows.size(); w++) {
+        for (uint32_t bits = dirty_rows[w]; bits; bits &= bits - 1) {
+            uint16_t location = w * 32 + __builtin_ctz(bits);
+
+            SDMJournalRecord record;
+            record.location = location;
+            record.access_count = access_counts[location];
+            record.crc = sdmCrc32(sdmCrc32(0, &record, offsetof(SDMJournalRecord, crc)), counterRow(location), row_bytes);
+
+            if (buffer->length > 0 && buffer->length + record_bytes > SDM_WRITER_BUFFER_BYTES) {
+                buffer->write_us = &journal_write_us;
+                uint32_t ticket = writer.submit(buffer, journal_file, mode);
+                if (!first_ticket) first_ticket = ticket;
+                mode = SDM_WRITE_APPEND;
+                buffer = writer.acquire();
+            }
+            uint8_t* at = buffer->extend(record_bytes);
+            memcpy(at, &record, sizeof(record));
+            memcpy(at + sizeof(record), counterRow(location), row_bytes);
+            appended += record_bytes;
+        }
+    }
+    buffer->write_us = &journal_write_us;
+    uint32_t ticket = writer.submit(buffer, journal_file, mode);
+    if (!journal_last_ticket) {
+        journal_first_ticket = first_ticket ? first_ticket : ticket;
+    }
+    journal_last_ticket = ticket;
+
+    journal_bytes += appended;
+    markCheckpointed();
+    // Already written when the writer task isn't running
+    collectJournalWrites();
+    return image_on_card;
+}
+
+bool SparseDistributedMemory::replayJournal() {
+    if (!SD.exists(journal_file)) {
+        return false;
+    }
+
+    File file = SD.open(journal_file);
+    if (!file) {
+        return false;
+    }
+
+    SDMJournalHeader header;
+    bool usable = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                  sdmJournalHeaderValid(header) &&
+                  header.base_crc == image_crc && header.seed == config.seed &&
+                  header.num_locations == config.num_locations && header.vector_dim == config.vector_dim &&
+                  header.counter_bits == config.counter_bits && header.row_bytes == row_bytes;
+    if (!usable) {
+        // Written against another image (e.g. the backup was loaded); it can't be applied
+        file.close();
+        SD.remove(journal_file);
+        Serial.println("Discarded stale SDM journal");
+        return false;
+    }
+
+    InternalVector<uint8_t> row(row_bytes);
+    uint32_t replayed = 0;
+    uint32_t valid_bytes = sizeof(header);
+    bool torn = false;
+
+    SDMJournalRecord record;
+    while (file.available() > 0) {
+        if (file.read((uint8_t*)&record, sizeof(record)) != sizeof(record) ||
+            file.read(row.data(), row_bytes) != row_bytes ||
+            record.location >= config.num_locations ||
+            record.crc != sdmCrc32(sdmCrc32(0, &record, offsetof(SDMJournalRecord, crc)), row.data(), row_bytes)) {
+            torn = true;
+            break;
+        }
+        memcpy(counterRow(record.location, true), row.data(), row_bytes);
+        access_counts[record.location] = record.access_count;
+        valid_bytes += sizeof(record) + row_bytes;
+        replayed++;
+    }
+    file.close();
+
+    journal_bytes = valid_bytes;
+    Serial.printf("Replayed %u journaled rows\n", (unsigned)replayed);
+
+    if (torn) {
+        // Appending after a torn record would hide later ones; fold everything into the image now
+        Serial.println("SDM journal has a torn tail, compacting");
+        saveMemoryToSD();
+    }
+    return true;
+}
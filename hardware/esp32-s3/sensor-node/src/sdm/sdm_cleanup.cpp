@@ -0,0 +1,97 @@
+#include "sdm.h"
+
+bool SDMCleanupMemory::assign(const uint32_t* packed, uint16_t count, uint16_t dim,
+                              const uint32_t* label_offsets, const char* label_text, bool use_index) {
+    clear();
+    vector_dim = dim;
+    words_per_vector = SDMKernels::wordsForDim(dim);
+    item_count = count;
+    items.assign(packed, packed + static_cast<size_t>(count) * words_per_vector);
+    if (label_offsets) {
+        label_index.assign(label_offsets, label_offsets + count + 1);
+        label_chars.assign(label_text, label_text + label_offsets[count]);
+    }
+    finishLoad(use_index);
+    return true;
+}
+
+void SDMCleanupMemory::finishLoad(bool use_index) {
+    // Missing or inconsistent labels: keep the vectors, report empty labels
+    bool labels_valid = label_index.size() == static_cast<size_t>(item_count) + 1 &&
+                        label_index[item_count] <= label_chars.size();
+    for (uint16_t i = 0; labels_valid && i < item_count; i++) {
+        labels_valid = label_index[i] <= label_index[i + 1];
+    }
+    if (!labels_valid) {
+        label_index.assign(static_cast<size_t>(item_count) + 1, 0);
+        label_chars.clear();
+    }
+    
+    if (use_index && item_count > 0) {
+        index.build(items.data(), item_count, vector_dim);
+        candidate_scratch.resize(item_count);
+    }
+}
+
+void SDMCleanupMemory::clear() {
+    vector_dim = 0;
+    words_per_vector = 0;
+    item_count = 0;
+    items = InternalVector<uint32_t>();
+    label_index = InternalVector<uint32_t>();
+    label_chars = InternalVector<char>();
+    index.clear();
+    candidate_scratch = InternalVector<uint16_t>();
+}
+
+String SDMCleanupMemory::label(uint16_t item) const {
+    if (item >= item_count) return String();
+    uint32_t begin = label_index[item];
+    uint32_t end = label_index[item + 1];
+    String text;
+    text.reserve(end - begin);
+    for (uint32_t c = begin; c < end; c++) {
+        text += label_chars[c];
+    }
+    return text;
+}
+
+size_t SDMCleanupMemory::memoryBytes() const {
+    return items.size() * sizeof(uint32_t) + label_index.size() * sizeof(uint32_t) + label_chars.size() +
+           (index.empty() ? 0 : index.memoryBytes()) + candidate_scratch.size() * sizeof(uint16_t);
+}
+
+uint16_t SDMCleanupMemory::nearest(const uint32_t* query, Match* out, uint16_t k, uint16_t max_distance) {
+    if (k == 0 || item_count == 0) return 0;
+    
+    // Keep out[0..found) sorted by distance; equal distances stay in id order
+    uint16_t found = 0;
+    auto offer = [&](uint16_t item) {
+        uint16_t distance = SDMKernels::hammingDistance(query, &items[static_cast<size_t>(item) * words_per_vector],
+                                                        words_per_vector);
+        if (distance > max_distance || (found == k && distance >= out[k - 1].distance)) return;
+        uint16_t slot = found < k ? found++ : k - 1;
+        while (slot > 0 && out[slot - 1].distance > distance) {
+            out[slot] = out[slot - 1];
+            slot--;
+        }
+        out[slot] = {item, distance};
+    };
+    
+    // Same bound as the activation scan: within max_distance needs
+    // overlap >= (|a| + |q| - max_distance) / 2, visited through the postings
+    int32_t slack = index.empty() ? 0 :
+                    static_cast<int32_t>(index.minWeight()) + SDMKernels::popcount(query, words_per_vector) - max_distance;
+    uint32_t scan_cost = static_cast<uint32_t>(item_count) * words_per_vector;
+    if (slack > 0 && index.queryWork(query) < scan_cost) {
+        uint16_t count = index.candidates(query, static_cast<uint16_t>((slack + 1) / 2), candidate_scratch.data());
+        for (uint16_t c = 0; c < count; c++) {
+            offer(candidate_scratch[c]);
+        }
+    } else {
+        for (uint16_t item = 0; item < item_count; item++) {
+            offer(item);
+        }
+    }
+    return found;
+}
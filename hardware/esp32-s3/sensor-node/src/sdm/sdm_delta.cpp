@@ -0,0 +1,381 @@
+#include "sdm.h"
+
+namespace {
+
+uint32_t zigzag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+int32_t unzigzag(uint32_t value) {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+void putVarint(InternalVector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (uint8_t shift = 0; p < end && shift < 35; shift += 7) {
+        uint8_t byte = *p++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// Largest change between two counters of a width; anything past it is corrupt
+int32_t laneSpan(uint8_t counter_bits) {
+    return counter_bits == 8 ? 255 : (counter_bits == 4 ? 15 : 65535);
+}
+
+// Bytes per SDM_DELTA_RAW lane: int16 holds an 8- or 4-bit span, 16-bit needs int32
+uint8_t rawLaneBytes(uint8_t counter_bits) {
+    return counter_bits == 16 ? 4 : 2;
+}
+
+void encodeLanes(const int32_t* lanes, uint16_t count, SDMDeltaEncoding encoding, uint8_t counter_bits,
+                 InternalVector<uint8_t>& out) {
+    if (encoding == SDM_DELTA_RAW) {
+        uint8_t lane_bytes = rawLaneBytes(counter_bits);
+        for (uint16_t j = 0; j < count; j++) {
+            uint32_t lane = static_cast<uint32_t>(lanes[j]);
+            for (uint8_t b = 0; b < lane_bytes; b++) {
+                out.push_back(static_cast<uint8_t>(lane >> (8 * b)));
+            }
+        }
+        return;
+    }
+    for (uint16_t j = 0; j < count;) {
+        if (lanes[j] != 0) {
+            putVarint(out, zigzag(lanes[j++]));
+            continue;
+        }
+        uint16_t run = 1;
+        while (j + run < count && lanes[j + run] == 0) run++;
+        out.push_back(0);
+        putVarint(out, run - 1);
+        j += run;
+    }
+}
+
+bool decodeLanes(const uint8_t* p, size_t bytes, SDMDeltaEncoding encoding, uint8_t counter_bits,
+                 int32_t* lanes, uint16_t count) {
+    const uint8_t* end = p + bytes;
+    int32_t span = laneSpan(counter_bits);
+    if (encoding == SDM_DELTA_RAW) {
+        uint8_t lane_bytes = rawLaneBytes(counter_bits);
+        if (bytes != static_cast<size_t>(count) * lane_bytes) return false;
+        for (uint16_t j = 0; j < count; j++) {
+            uint32_t lane = 0;
+            for (uint8_t b = 0; b < lane_bytes; b++) {
+                lane |= static_cast<uint32_t>(*p++) << (8 * b);
+            }
+            int32_t value = lane_bytes == 4 ? static_cast<int32_t>(lane) : static_cast<int16_t>(lane);
+            lanes[j] = std::max(-span, std::min(span, value));
+        }
+        return true;
+    }
+    uint16_t j = 0;
+    while (p < end) {
+        uint32_t value;
+        if (!getVarint(p, end, value)) return false;
+        if (value != 0) {
+            if (j >= count) return false;
+            lanes[j++] = std::max(-span, std::min(span, unzigzag(value)));
+            continue;
+        }
+        uint32_t run;
+        if (!getVarint(p, end, run) || run >= static_cast<uint32_t>(count - j)) return false;
+        for (uint32_t r = 0; r <= run; r++) lanes[j++] = 0;
+    }
+    return j == count;
+}
+
+} // namespace
+
+bool SparseDistributedMemory::matchesImage(const SDMImageHeader& header) const {
+    return header.seed == config.seed && header.num_locations == config.num_locations &&
+           header.vector_dim == config.vector_dim && header.counter_bits == config.counter_bits &&
+           header.row_bytes == row_bytes &&
+           header.payload_bytes == config.num_locations * (sizeof(uint16_t) + row_bytes) &&
+           header.address_ones == address_ones &&
+           ((header.flags & SDM_IMAGE_FLAG_SPARSE_ADDRESSES) != 0) == sparse_mode;
+}
+
+void SparseDistributedMemory::addLaneDeltas(uint8_t* row, int32_t* lanes) {
+    // Staged through the write kernel's aligned delta row. A change wider than
+    // the staging lanes (up to twice a counter's range) goes in several steps.
+    int32_t limit = config.counter_bits == 16 ? INT16_MAX : INT8_MAX;
+    int16_t* wide = reinterpret_cast<int16_t*>(delta_rows);
+    int8_t* narrow = reinterpret_cast<int8_t*>(delta_rows);
+    for (bool remaining = true; remaining;) {
+        remaining = false;
+        for (uint16_t j = 0; j < row_stride; j++) {
+            int32_t step = std::max(-limit - 1, std::min(limit, lanes[j]));
+            lanes[j] -= step;
+            remaining |= lanes[j] != 0;
+            if (config.counter_bits == 16) wide[j] = static_cast<int16_t>(step);
+            else narrow[j] = static_cast<int8_t>(step);
+        }
+        switch (config.counter_bits) {
+            case 8:
+                SDMKernels::saturatingAddRow8(reinterpret_cast<int8_t*>(row), narrow, row_stride);
+                break;
+            case 4:
+                SDMKernels::saturatingAddRow4(row, narrow, row_stride);
+                break;
+            default:
+                SDMKernels::saturatingAddRow(reinterpret_cast<int16_t*>(row), wide, row_stride);
+                break;
+        }
+    }
+}
+
+bool SparseDistributedMemory::exportDelta(const String& path, SDMDeltaEncoding encoding, const String& baseline) {
+    // The new baseline is written with exportImage(), which needs the whole arena
+    if (paged || !counters) {
+        return false;
+    }
+    String base_path = baseline.isEmpty() ? sync_file : baseline;
+
+    // A missing or foreign baseline stands for all-zero counters: every row is exported
+    SDMImageHeader base_header;
+    InternalVector<uint16_t> base_counts(config.num_locations, 0);
+    File base = SD.open(base_path);
+    bool have_base = base && base.read((uint8_t*)&base_header, sizeof(base_header)) == sizeof(base_header) &&
+                     sdmImageHeaderValid(base_header) && matchesImage(base_header) &&
+                     base.read((uint8_t*)base_counts.data(), base_counts.size() * sizeof(uint16_t)) ==
+                         base_counts.size() * sizeof(uint16_t);
+    if (base && !have_base) {
+        Serial.printf("%s is not a baseline for this memory; exporting every row\n", base_path.c_str());
+        std::fill(base_counts.begin(), base_counts.end(), 0);
+    }
+
+    File out = SD.open(path, FILE_WRITE);
+    if (!out) {
+        if (base) base.close();
+        return false;
+    }
+    SDMDeltaHeader header;
+    header.seed = config.seed;
+    header.num_locations = config.num_locations;
+    header.vector_dim = config.vector_dim;
+    header.counter_bits = config.counter_bits;
+    header.encoding = encoding;
+    header.row_stride = row_stride;
+    header.base_crc = have_base ? base_header.payload_crc : 0;
+    header.address_crc = address_map_crc;
+    header.address_ones = address_ones;
+    header.flags = sparse_mode ? SDM_IMAGE_FLAG_SPARSE_ADDRESSES : 0;
+    bool written = out.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+
+    // Records are staged into SDM_IMAGE_BLOCK writes
+    InternalVector<uint8_t> base_row(row_bytes, 0);
+    InternalVector<int32_t> lanes(row_stride);
+    InternalVector<uint8_t> block;
+    block.reserve(SDM_IMAGE_BLOCK + sizeof(SDMDeltaRecord) + static_cast<size_t>(row_stride) * 4);
+
+    for (uint16_t location = 0; written && location < config.num_locations; location++) {
+        // Only rows written since the last export can differ from a baseline
+        if (have_base && !(sync_rows[location >> 5] & (1u << (location & 31)))) continue;
+        if (have_base && (!base.seek(imageRowsOffset() + static_cast<uint32_t>(location) * row_bytes) ||
+                          base.read(base_row.data(), row_bytes) != row_bytes)) {
+            written = false;
+            break;
+        }
+
+        const uint8_t* row = counterRow(location);
+        bool changed = false;
+        for (uint16_t j = 0; j < row_stride; j++) {
+            lanes[j] = SDMKernels::counterLane(row, config.counter_bits, j) -
+                       SDMKernels::counterLane(base_row.data(), config.counter_bits, j);
+            changed |= lanes[j] != 0;
+        }
+        uint16_t access_delta = access_counts[location] > base_counts[location]
+                                    ? access_counts[location] - base_counts[location] : 0;
+        if (!changed && access_delta == 0) continue;
+
+        size_t record_at = block.size();
+        block.resize(record_at + sizeof(SDMDeltaRecord));
+        encodeLanes(lanes.data(), row_stride, encoding, config.counter_bits, block);
+        SDMDeltaRecord record;
+        record.location = location;
+        record.access_delta = access_delta;
+        record.encoded_bytes = static_cast<uint16_t>(block.size() - record_at - sizeof(SDMDeltaRecord));
+        memcpy(&block[record_at], &record, sizeof(record));
+        header.row_count++;
+
+        if (block.size() >= SDM_IMAGE_BLOCK) {
+            header.payload_crc = sdmCrc32(header.payload_crc, block.data(), block.size());
+            header.payload_bytes += block.size();
+            written = out.write(block.data(), block.size()) == block.size();
+            block.clear();
+        }
+    }
+    if (base) base.close();
+    if (written && !block.empty()) {
+        header.payload_crc = sdmCrc32(header.payload_crc, block.data(), block.size());
+        header.payload_bytes += block.size();
+        written = out.write(block.data(), block.size()) == block.size();
+    }
+
+    sdmSealDeltaHeader(header);
+    written = written && out.seek(0) && out.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+    out.close();
+    if (!written) {
+        Serial.printf("Failed to write delta %s\n", path.c_str());
+        SD.remove(path);
+        return false;
+    }
+
+    // What was exported becomes the baseline; until the swap succeeds the old
+    // baseline stays and the next export repeats these rows
+    String temp_file = base_path + ".tmp";
+    if (!exportImage(temp_file)) {
+        return false;
+    }
+    if (SD.exists(base_path)) SD.remove(base_path);
+    if (!SD.rename(temp_file, base_path)) {
+        Serial.println("Failed to replace sync baseline");
+        return false;
+    }
+    std::fill(sync_rows.begin(), sync_rows.end(), 0);
+
+    Serial.printf("Exported %u changed rows (%u bytes) to %s\n", (unsigned)header.row_count,
+                  (unsigned)(sizeof(header) + header.payload_bytes), path.c_str());
+    return true;
+}
+
+bool SparseDistributedMemory::importDelta(const String& path, bool advance_baseline, const String& baseline) {
+    if (!counters) {
+        return false;
+    }
+    File file = SD.open(path);
+    if (!file) {
+        return false;
+    }
+
+    SDMDeltaHeader header;
+    bool usable = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && sdmDeltaHeaderValid(header) &&
+                  header.seed == config.seed && header.num_locations == config.num_locations &&
+                  header.vector_dim == config.vector_dim && header.counter_bits == config.counter_bits &&
+                  header.row_stride == row_stride && header.encoding <= SDM_DELTA_RAW &&
+                  header.address_ones == address_ones &&
+                  ((header.flags & SDM_IMAGE_FLAG_SPARSE_ADDRESSES) != 0) == sparse_mode;
+    if (usable && header.address_crc != address_map_crc) {
+        // Same seed, but rebalance() moved locations on one side: rows would land on other addresses
+        Serial.printf("%s was exported with other hard locations\n", path.c_str());
+        file.close();
+        return false;
+    }
+
+    // Check the payload before touching any counter
+    InternalVector<uint8_t> block(SDM_IMAGE_BLOCK);
+    uint32_t crc = 0;
+    uint32_t remaining = header.payload_bytes;
+    while (usable && remaining > 0) {
+        size_t chunk = std::min<size_t>(remaining, block.size());
+        usable = file.read(block.data(), chunk) == chunk;
+        crc = sdmCrc32(crc, block.data(), chunk);
+        remaining -= chunk;
+    }
+    if (!usable || crc != header.payload_crc || !file.seek(sizeof(header))) {
+        Serial.printf("%s is not a delta for this memory\n", path.c_str());
+        file.close();
+        return false;
+    }
+
+    // The baseline takes the same changes, so they are not exported back
+    String base_path = baseline.isEmpty() ? sync_file : baseline;
+    SDMImageHeader base_header;
+    File base;
+    if (advance_baseline && SD.exists(base_path)) {
+        base = SD.open(base_path, "r+");
+        if (base && !(base.read((uint8_t*)&base_header, sizeof(base_header)) == sizeof(base_header) &&
+                      sdmImageHeaderValid(base_header) && matchesImage(base_header))) {
+            base.close();
+        }
+    }
+    bool base_row_in_psram = false;
+    uint8_t* base_row = base ? static_cast<uint8_t*>(sdmAllocArena(row_bytes, false, &base_row_in_psram)) : nullptr;
+
+    InternalVector<int32_t> lanes(row_stride);
+    InternalVector<int32_t> base_lanes(row_stride);
+    InternalVector<uint8_t> encoded;
+    uint32_t applied = 0;
+    bool intact = true;
+
+    for (uint32_t r = 0; r < header.row_count; r++) {
+        SDMDeltaRecord record;
+        intact = file.read((uint8_t*)&record, sizeof(record)) == sizeof(record) &&
+                 record.location < config.num_locations;
+        if (intact) {
+            encoded.resize(record.encoded_bytes);
+            intact = file.read(encoded.data(), encoded.size()) == encoded.size() &&
+                     decodeLanes(encoded.data(), encoded.size(), static_cast<SDMDeltaEncoding>(header.encoding),
+                                 config.counter_bits, lanes.data(), row_stride);
+        }
+        if (!intact) break;
+
+        if (base_row) {
+            base_lanes = lanes;
+        }
+        addLaneDeltas(counterRow(record.location, true), lanes.data());
+        access_counts[record.location] = std::min<uint32_t>(UINT16_MAX, access_counts[record.location] + record.access_delta);
+        markDirty(record.location);
+        applied++;
+
+        if (base_row) {
+            uint32_t row_at = imageRowsOffset() + static_cast<uint32_t>(record.location) * row_bytes;
+            uint32_t count_at = sizeof(SDMImageHeader) + static_cast<uint32_t>(record.location) * sizeof(uint16_t);
+            uint16_t count = 0;
+            bool updated = base.seek(row_at) && base.read(base_row, row_bytes) == row_bytes;
+            if (updated) {
+                addLaneDeltas(base_row, base_lanes.data());
+                updated = base.seek(row_at) && base.write(base_row, row_bytes) == row_bytes &&
+                          base.seek(count_at) && base.read((uint8_t*)&count, sizeof(count)) == sizeof(count);
+            }
+            if (updated) {
+                count = std::min<uint32_t>(UINT16_MAX, static_cast<uint32_t>(count) + record.access_delta);
+                updated = base.seek(count_at) && base.write((const uint8_t*)&count, sizeof(count)) == sizeof(count);
+            }
+            if (!updated) {
+                // The rows left out will be exported again; harmless, only redundant
+                Serial.printf("Failed to update %s; continuing without it\n", base_path.c_str());
+                base.close();
+                sdmFreeArena(base_row);
+                base_row = nullptr;
+            }
+        }
+    }
+    file.close();
+
+    if (base_row) {
+        // Rows changed in place: payload_crc no longer describes the file
+        base_header.flags |= SDM_IMAGE_FLAG_OPEN;
+        sdmSealImageHeader(base_header);
+        if (!base.seek(0) || base.write((const uint8_t*)&base_header, sizeof(base_header)) != sizeof(base_header)) {
+            Serial.printf("Failed to update %s\n", base_path.c_str());
+        }
+        base.close();
+        sdmFreeArena(base_row);
+    }
+
+    if (applied > 0) {
+        last_write_ms = millis();
+        if (pending_writes == 0) first_pending_ms = last_write_ms;
+        pending_writes += 1;
+    }
+    if (!intact) {
+        Serial.printf("%s has a malformed record; applied %u rows of %u\n", path.c_str(), (unsigned)applied,
+                      (unsigned)header.row_count);
+        return false;
+    }
+    Serial.printf("Merged %u rows from %s\n", (unsigned)applied, path.c_str());
+    return true;
+}
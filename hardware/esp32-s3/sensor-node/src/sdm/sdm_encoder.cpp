@@ -5,44 +5,112 @@ SDMEncoder::SDMEncoder(SparseDistributedMemory* sdm_instance) : sdm(sdm_instance
     // Initialize encoder with SDM instance
 }
 
+// Scratch for the byte-per-bit overloads; sized once, reused by every call
+static uint32_t* scratchFor(InternalVector<uint32_t>& scratch, uint16_t vector_dim) {
+    scratch.resize(SDMKernels::wordsForDim(vector_dim));
+    return scratch.data();
+}
+
+// Pack a byte-per-bit vector that may be shorter than vector_dim
+static const uint32_t* packInto(InternalVector<uint32_t>& scratch, const std::vector<uint8_t>& vector,
+                                uint16_t vector_dim) {
+    uint32_t* packed = scratchFor(scratch, vector_dim);
+    std::fill(scratch.begin(), scratch.end(), 0);
+    uint16_t bits = std::min<size_t>(vector.size(), vector_dim);
+    for (uint16_t i = 0; i < bits; i++) {
+        if (vector[i]) SDMKernels::setBit(packed, i);
+    }
+    return packed;
+}
+
 std::vector<uint8_t> SDMEncoder::encodeText(const String& text) {
+    std::vector<uint8_t> encoded(sdm->config.vector_dim);
+    uint32_t* packed = scratchFor(packed_scratch, sdm->config.vector_dim);
+    encodeText(text, packed);
+    SDMKernels::unpack(packed, sdm->config.vector_dim, encoded.data());
+    return encoded;
+}
+
+// Multipliers of the positional text hash (c * char + i * position) % vector_dim
+static const uint8_t kTextCharMul[3] = {17, 23, 41};
+static const uint8_t kTextPositionMul[3] = {31, 47, 53};
+// Odd multipliers mixing an n-gram window before the range reduction
+static const uint32_t kTextGramMul[3] = {0x9E3779B1u, 0x85EBCA77u, 0xC2B2AE3Du};
+
+void SDMEncoder::buildTextTables() {
+    uint16_t dim = sdm->config.vector_dim;
+    char_offsets.resize(3 * 256);
+    position_offsets.resize(3 * sequence_length);
+    for (uint8_t k = 0; k < 3; k++) {
+        for (uint16_t c = 0; c < 256; c++) {
+            char_offsets[k * 256 + c] = (c * kTextCharMul[k]) % dim;
+        }
+        for (uint16_t i = 0; i < sequence_length; i++) {
+            position_offsets[k * sequence_length + i] = (static_cast<uint32_t>(i) * kTextPositionMul[k]) % dim;
+        }
+    }
+    table_dim = dim;
+}
+
+void SDMEncoder::encodeText(const String& text, uint32_t* packed) {
     // Simple character-based encoding for demonstration
     // In practice, you'd use more sophisticated NLP encoding
     
-    std::vector<uint8_t> encoded(sdm->config.vector_dim, 0);
+    uint16_t dim = sdm->config.vector_dim;
+    if (table_dim != dim) buildTextTables();
+    std::fill(packed, packed + SDMKernels::wordsForDim(dim), 0);
     
-    // Hash-based character encoding
-    for (int i = 0; i < text.length() && i < sequence_length; i++) {
-        char c = text[i];
-        
-        // Simple hash function for character positioning
-        uint16_t hash1 = (c * 17 + i * 31) % sdm->config.vector_dim;
-        uint16_t hash2 = (c * 23 + i * 47) % sdm->config.vector_dim;
-        uint16_t hash3 = (c * 41 + i * 53) % sdm->config.vector_dim;
-        
+    const uint8_t* chars = reinterpret_cast<const uint8_t*>(text.c_str());
+    size_t length = text.length();
+    size_t prefix = std::min<size_t>(length, sequence_length);
+    
+    // Hash-based character encoding: both offsets are < dim, so one
+    // conditional subtract completes the modulo
+    for (size_t i = 0; i < prefix; i++) {
         // Set multiple bits per character for redundancy
-        encoded[hash1] = 1;
-        encoded[hash2] = 1;
-        encoded[hash3] = 1;
+        for (uint8_t k = 0; k < 3; k++) {
+            uint16_t bit = char_offsets[k * 256 + chars[i]] + position_offsets[k * sequence_length + i];
+            SDMKernels::setBit(packed, bit >= dim ? bit - dim : bit);
+        }
     }
     
-    return encoded;
+    // Past the prefix, hash a rolling window of the last SDM_TEXT_NGRAM characters
+    uint32_t window = 0;
+    for (size_t i = 0; i < length; i++) {
+        window = ((window << 8) | chars[i]) & ((1u << (8 * SDM_TEXT_NGRAM)) - 1);
+        if (i < prefix) continue;
+        for (uint8_t k = 0; k < 3; k++) {
+            SDMKernels::setBit(packed, SDMKernels::reduceRange((window + 1) * kTextGramMul[k], dim));
+        }
+    }
 }
 
 String SDMEncoder::decodeText(const std::vector<uint8_t>& vector) {
-    // This is a simplified decoder - real implementation would be more complex
-    // For now, return a placeholder indicating successful decoding
-    
-    uint16_t active_bits = 0;
-    for (uint8_t bit : vector) {
-        if (bit) active_bits++;
+    return decodeText(packInto(packed_scratch, vector, sdm->config.vector_dim));
+}
+
+String SDMEncoder::decodeText(const uint32_t* packed) {
+    if (cleanup && cleanup->size() > 0 && cleanup->vectorDim() == sdm->config.vector_dim) {
+        SDMCleanupMemory::Match match;
+        return cleanup->nearest(packed, &match, 1, cleanup_radius) ? cleanup->label(match.item) : String();
     }
     
+    // No item memory to clean up against: report the bit count as a placeholder
+    uint16_t active_bits = SDMKernels::popcount(packed, SDMKernels::wordsForDim(sdm->config.vector_dim));
+    
     return "Decoded_" + String(active_bits) + "_bits";
 }
 
 std::vector<uint8_t> SDMEncoder::encodeFloat(float value, float min_val, float max_val) {
-    std::vector<uint8_t> encoded(sdm->config.vector_dim, 0);
+    std::vector<uint8_t> encoded(sdm->config.vector_dim);
+    uint32_t* packed = scratchFor(packed_scratch, sdm->config.vector_dim);
+    encodeFloat(value, packed, min_val, max_val);
+    SDMKernels::unpack(packed, sdm->config.vector_dim, encoded.data());
+    return encoded;
+}
+
+void SDMEncoder::encodeFloat(float value, uint32_t* packed, float min_val, float max_val) {
+    std::fill(packed, packed + SDMKernels::wordsForDim(sdm->config.vector_dim), 0);
     
     // Normalize value to [0, 1] range
     float normalized = (value - min_val) / (max_val - min_val);
@@ -52,19 +120,20 @@ std::vector<uint8_t> SDMEncoder::encodeFloat(float value, float min_val, float m
     uint16_t position = static_cast<uint16_t>(normalized * (sdm->config.vector_dim - 1));
     
     // Set bits from 0 to position (thermometer encoding)
-    for (uint16_t i = 0; i <= position && i < sdm->config.vector_dim; i++) {
-        encoded[i] = 1;
-    }
-    
-    return encoded;
+    SDMKernels::setBitRange(packed, 0, std::min<uint16_t>(position + 1, sdm->config.vector_dim));
 }
 
 float SDMEncoder::decodeFloat(const std::vector<uint8_t>& vector, float min_val, float max_val) {
+    return decodeFloat(packInto(packed_scratch, vector, sdm->config.vector_dim), min_val, max_val);
+}
+
+float SDMEncoder::decodeFloat(const uint32_t* packed, float min_val, float max_val) {
     // Find the highest set bit position (thermometer decoding)
     uint16_t highest_bit = 0;
-    for (uint16_t i = 0; i < vector.size(); i++) {
-        if (vector[i] == 1) {
-            highest_bit = i;
+    for (uint16_t w = SDMKernels::wordsForDim(sdm->config.vector_dim); w > 0; w--) {
+        if (packed[w - 1]) {
+            highest_bit = (w - 1) * 32 + 31 - __builtin_clz(packed[w - 1]);
+            break;
         }
     }
     
@@ -76,52 +145,54 @@ float SDMEncoder::decodeFloat(const std::vector<uint8_t>& vector, float min_val,
 }
 
 std::vector<uint8_t> SDMEncoder::encodeSequence(const std::vector<float>& sequence) {
-    std::vector<uint8_t> encoded(sdm->config.vector_dim, 0);
-    
-    if (sequence.empty()) return encoded;
+    std::vector<uint8_t> encoded(sdm->config.vector_dim);
+    uint32_t* packed = scratchFor(packed_scratch, sdm->config.vector_dim);
+    encodeSequence(sequence.data(), sequence.size(), packed);
+    SDMKernels::unpack(packed, sdm->config.vector_dim, encoded.data());
+    return encoded;
+}
+
+void SDMEncoder::encodeSequence(const float* values, size_t count, uint32_t* packed) {
+    std::fill(packed, packed + SDMKernels::wordsForDim(sdm->config.vector_dim), 0);
     
     // Encode sequence using distributed representation
     uint16_t bits_per_element = sdm->config.vector_dim / sequence_length;
     
-    for (size_t i = 0; i < sequence.size() && i < sequence_length; i++) {
+    for (size_t i = 0; i < count && i < sequence_length; i++) {
         // Normalize each element
-        float normalized = (sequence[i] + 1.0f) / 2.0f;  // Assume [-1, 1] range
+        float normalized = (values[i] + 1.0f) / 2.0f;  // Assume [-1, 1] range
         normalized = constrain(normalized, 0.0f, 1.0f);
         
         // Set bits in allocated segment
         uint16_t start_bit = i * bits_per_element;
         uint16_t num_bits = static_cast<uint16_t>(normalized * bits_per_element);
         
-        for (uint16_t j = 0; j < num_bits && (start_bit + j) < sdm->config.vector_dim; j++) {
-            encoded[start_bit + j] = 1;
-        }
+        SDMKernels::setBitRange(packed, start_bit, std::min<uint16_t>(start_bit + num_bits, sdm->config.vector_dim));
     }
-    
-    return encoded;
 }
 
 std::vector<float> SDMEncoder::decodeSequence(const std::vector<uint8_t>& vector) {
-    std::vector<float> sequence;
-    
+    std::vector<float> sequence(sequence_length);
+    sequence.resize(decodeSequence(packInto(packed_scratch, vector, sdm->config.vector_dim),
+                                   sequence.data(), sequence_length));
+    return sequence;
+}
+
+uint16_t SDMEncoder::decodeSequence(const uint32_t* packed, float* values, uint16_t max_values) {
     uint16_t bits_per_element = sdm->config.vector_dim / sequence_length;
+    uint16_t count = std::min(sequence_length, max_values);
     
-    for (uint16_t i = 0; i < sequence_length; i++) {
+    for (uint16_t i = 0; i < count; i++) {
         uint16_t start_bit = i * bits_per_element;
-        uint16_t active_bits = 0;
         
         // Count active bits in this segment
-        for (uint16_t j = 0; j < bits_per_element && (start_bit + j) < vector.size(); j++) {
-            if (vector[start_bit + j] == 1) {
-                active_bits++;
-            }
-        }
+        uint16_t end_bit = std::min<uint16_t>(start_bit + bits_per_element, sdm->config.vector_dim);
+        uint16_t active_bits = SDMKernels::popcountRange(packed, start_bit, end_bit);
         
         // Convert back to normalized value
         float normalized = static_cast<float>(active_bits) / bits_per_element;
-        float value = normalized * 2.0f - 1.0f;  // Scale to [-1, 1]
-        
-        sequence.push_back(value);
+        values[i] = normalized * 2.0f - 1.0f;  // Scale to [-1, 1]
     }
     
-    return sequence;
-}
\ No newline at end of file
+    return count;
+}
@@ -0,0 +1,86 @@
+#include "sdm_image.h"
+
+#if defined(ESP_PLATFORM)
+#include <esp_rom_crc.h>
+#endif
+
+uint32_t sdmCrc32(uint32_t crc, const void* data, size_t length) {
+#if defined(ESP_PLATFORM)
+    // ROM implementation, same init/final inversion convention as zlib
+    return esp_rom_crc32_le(crc, static_cast<const uint8_t*>(data), length);
+#else
+    // Nibble-table fallback for host builds
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+#endif
+}
+
+void sdmSealImageHeader(SDMImageHeader& header) {
+    header.header_bytes = sizeof(SDMImageHeader);
+    header.header_crc = sdmCrc32(0, &header, offsetof(SDMImageHeader, header_crc));
+}
+
+bool sdmImageHeaderValid(const SDMImageHeader& header) {
+    if (header.magic != SDM_IMAGE_MAGIC) return false;
+    if (header.version != SDM_IMAGE_VERSION) return false;
+    if (header.header_bytes != sizeof(SDMImageHeader)) return false;
+    return header.header_crc == sdmCrc32(0, &header, offsetof(SDMImageHeader, header_crc));
+}
+
+void sdmSealJournalHeader(SDMJournalHeader& header) {
+    header.header_bytes = sizeof(SDMJournalHeader);
+    header.header_crc = sdmCrc32(0, &header, offsetof(SDMJournalHeader, header_crc));
+}
+
+bool sdmJournalHeaderValid(const SDMJournalHeader& header) {
+    if (header.magic != SDM_JOURNAL_MAGIC) return false;
+    if (header.version != SDM_JOURNAL_VERSION) return false;
+    if (header.header_bytes != sizeof(SDMJournalHeader)) return false;
+    return header.header_crc == sdmCrc32(0, &header, offsetof(SDMJournalHeader, header_crc));
+}
+
+void sdmSealDeltaHeader(SDMDeltaHeader& header) {
+    header.header_bytes = sizeof(SDMDeltaHeader);
+    header.header_crc = sdmCrc32(0, &header, offsetof(SDMDeltaHeader, header_crc));
+}
+
+bool sdmDeltaHeaderValid(const SDMDeltaHeader& header) {
+    if (header.magic != SDM_DELTA_MAGIC) return false;
+    if (header.version != SDM_DELTA_VERSION) return false;
+    if (header.header_bytes != sizeof(SDMDeltaHeader)) return false;
+    return header.header_crc == sdmCrc32(0, &header, offsetof(SDMDeltaHeader, header_crc));
+}
+
+void sdmSealAddressHeader(SDMAddressHeader& header) {
+    header.header_bytes = sizeof(SDMAddressHeader);
+    header.header_crc = sdmCrc32(0, &header, offsetof(SDMAddressHeader, header_crc));
+}
+
+bool sdmAddressHeaderValid(const SDMAddressHeader& header) {
+    if (header.magic != SDM_ADDRESS_MAGIC) return false;
+    if (header.version != SDM_ADDRESS_VERSION) return false;
+    if (header.header_bytes != sizeof(SDMAddressHeader)) return false;
+    return header.header_crc == sdmCrc32(0, &header, offsetof(SDMAddressHeader, header_crc));
+}
+
+void sdmSealLibraryHeader(SDMLibraryHeader& header) {
+    header.header_bytes = sizeof(SDMLibraryHeader);
+    header.header_crc = sdmCrc32(0, &header, offsetof(SDMLibraryHeader, header_crc));
+}
+
+bool sdmLibraryHeaderValid(const SDMLibraryHeader& header) {
+    if (header.magic != SDM_LIBRARY_MAGIC) return false;
+    if (header.version != SDM_LIBRARY_VERSION) return false;
+    if (header.header_bytes != sizeof(SDMLibraryHeader)) return false;
+    return header.header_crc == sdmCrc32(0, &header, offsetof(SDMLibraryHeader, header_crc));
+}
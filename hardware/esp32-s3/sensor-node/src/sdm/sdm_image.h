@@ -0,0 +1,181 @@
+#ifndef SDM_IMAGE_H
+#define SDM_IMAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// On-card memory image (/sdm/memory.bin):
+//   SDMImageHeader
+//   access counts   num_locations x uint16
+//   counter rows    num_locations x row_bytes, copied verbatim from the arena
+// All fields are little-endian. payload_crc covers everything after the
+// header; header_crc covers the header up to (not including) itself.
+// Paged memories update rows in place and set SDM_IMAGE_FLAG_OPEN until the
+// payload CRC is recomputed on a clean save. Addresses are derived from the
+// seed and address_ones (vector_dim * sparsity), so both must match to load.
+#define SDM_IMAGE_MAGIC 0x494D4453u  // "SDMI"
+#define SDM_IMAGE_VERSION 2
+// SD transfer size for image payloads; large blocks keep the card in multi-sector writes
+#define SDM_IMAGE_BLOCK 4096
+#define SDM_IMAGE_FLAG_OPEN 0x01  // Rows were written in place since payload_crc was computed
+#define SDM_IMAGE_FLAG_SPARSE_ADDRESSES 0x02  // Written by a memory storing addresses as set-bit positions
+
+struct SDMImageHeader {
+    uint32_t magic = SDM_IMAGE_MAGIC;
+    uint16_t version = SDM_IMAGE_VERSION;
+    uint16_t header_bytes = 0;
+    uint32_t seed = 0;
+    uint32_t num_locations = 0;
+    uint32_t vector_dim = 0;
+    uint8_t counter_bits = 0;
+    uint8_t flags = 0;
+    uint16_t address_ones = 0;  // Set bits per seed-derived address
+    uint32_t row_bytes = 0;
+    uint32_t payload_bytes = 0;
+    uint32_t payload_crc = 0;
+    uint32_t header_crc = 0;
+};
+
+// Append-only journal (/sdm/journal.bin) of rows checkpointed since the image
+// was last written: SDMJournalHeader, then records of SDMJournalRecord + the
+// full counter row. Replaying records in order over the base image whose
+// payload_crc equals base_crc restores the checkpointed state; a record with a
+// bad CRC marks a torn tail and ends the replay.
+#define SDM_JOURNAL_MAGIC 0x4A4D4453u  // "SDMJ"
+#define SDM_JOURNAL_VERSION 1
+
+struct SDMJournalHeader {
+    uint32_t magic = SDM_JOURNAL_MAGIC;
+    uint16_t version = SDM_JOURNAL_VERSION;
+    uint16_t header_bytes = 0;
+    uint32_t seed = 0;
+    uint32_t num_locations = 0;
+    uint32_t vector_dim = 0;
+    uint8_t counter_bits = 0;
+    uint8_t reserved[3] = {0, 0, 0};
+    uint32_t row_bytes = 0;
+    uint32_t base_crc = 0;
+    uint32_t header_crc = 0;
+};
+
+struct SDMJournalRecord {
+    uint16_t location = 0;
+    uint16_t access_count = 0;
+    uint32_t crc = 0;  // Over location, access_count and the row that follows
+};
+
+// Counter delta for merging memories across nodes that share a seed:
+//   SDMDeltaHeader
+//   records       row_count x (SDMDeltaRecord + encoded_bytes of lane deltas)
+// A record holds one row's change against the exporter's sync baseline, lane
+// by lane (row_stride lanes, in counter units) plus the access count change.
+// SDM_DELTA_VARINT lanes are zigzag LEB128 varints, with a zero followed by a
+// varint n standing for n + 1 unchanged lanes; SDM_DELTA_RAW lanes are int32
+// for 16-bit counters and int16 for narrower ones. Deltas add: applying
+// several with saturation merges the memories. address_ones and flags
+// describe the addresses as in SDMImageHeader. base_crc is the payload_crc of
+// the baseline the delta was taken against, so a receiver can tell
+// consecutive exports apart from a gap.
+// address_crc is the exporter's address map CRC (0 for seed-derived
+// addresses); a delta only applies to a memory with the same one.
+#define SDM_DELTA_MAGIC 0x444D4453u  // "SDMD"
+#define SDM_DELTA_VERSION 3
+
+enum SDMDeltaEncoding : uint8_t {
+    SDM_DELTA_VARINT = 0,
+    SDM_DELTA_RAW = 1,
+};
+
+struct SDMDeltaHeader {
+    uint32_t magic = SDM_DELTA_MAGIC;
+    uint16_t version = SDM_DELTA_VERSION;
+    uint16_t header_bytes = 0;
+    uint32_t seed = 0;
+    uint32_t num_locations = 0;
+    uint32_t vector_dim = 0;
+    uint8_t counter_bits = 0;
+    uint8_t encoding = SDM_DELTA_VARINT;
+    uint16_t row_stride = 0;
+    uint32_t row_count = 0;
+    uint32_t base_crc = 0;
+    uint32_t payload_bytes = 0;
+    uint32_t payload_crc = 0;
+    uint32_t address_crc = 0;
+    uint16_t address_ones = 0;
+    uint8_t flags = 0;  // SDM_IMAGE_FLAG_SPARSE_ADDRESSES
+    uint8_t reserved = 0;
+    uint32_t header_crc = 0;
+};
+
+struct SDMDeltaRecord {
+    uint16_t location = 0;
+    uint16_t access_delta = 0;
+    uint16_t encoded_bytes = 0;
+    uint16_t reserved = 0;
+};
+
+// Address map (/sdm/addresses.bin) of the locations rebalance() moved:
+//   SDMAddressHeader
+//   records       location_count x (SDMAddressRecord + words_per_vector packed uint32)
+// Locations without a record keep the address generated from (seed, location).
+// payload_crc covers the records.
+#define SDM_ADDRESS_MAGIC 0x414D4453u  // "SDMA"
+#define SDM_ADDRESS_VERSION 1
+
+struct SDMAddressHeader {
+    uint32_t magic = SDM_ADDRESS_MAGIC;
+    uint16_t version = SDM_ADDRESS_VERSION;
+    uint16_t header_bytes = 0;
+    uint32_t seed = 0;
+    uint32_t num_locations = 0;
+    uint32_t vector_dim = 0;
+    uint32_t location_count = 0;
+    uint32_t payload_crc = 0;
+    uint32_t header_crc = 0;
+};
+
+struct SDMAddressRecord {
+    uint16_t location = 0;
+    uint16_t reserved = 0;
+};
+
+// Pretrained library (/lib/<name>/vectors.bin), version 2:
+//   SDMLibraryHeader
+//   vectors       num_vectors x words_per_vector uint32, packed as in sdm_kernels.h
+//   label index   num_vectors + 1 uint32 offsets into the label text (labels_offset != 0 only)
+//   label text    labels back to back, no terminators
+// Version 1 files have no header beyond (num_vectors, vector_dim) and store
+// one byte per bit; SDM_LIBRARY_MAGIC can never be a plausible v1 count.
+#define SDM_LIBRARY_MAGIC 0x4C4D4453u  // "SDML"
+#define SDM_LIBRARY_VERSION 2
+
+struct SDMLibraryHeader {
+    uint32_t magic = SDM_LIBRARY_MAGIC;
+    uint16_t version = SDM_LIBRARY_VERSION;
+    uint16_t header_bytes = 0;
+    uint32_t num_vectors = 0;
+    uint32_t vector_dim = 0;
+    uint32_t words_per_vector = 0;
+    uint32_t labels_offset = 0;  // File offset of the label index, 0 = no labels
+    uint32_t vectors_crc = 0;    // CRC32 of the packed vector block
+    uint32_t header_crc = 0;
+};
+
+// CRC-32 (IEEE 802.3, as zlib.crc32). Start with crc = 0 and pass the
+// previous result to continue over further data.
+uint32_t sdmCrc32(uint32_t crc, const void* data, size_t length);
+
+// Fill in header_bytes and header_crc for a header whose other fields are set
+void sdmSealImageHeader(SDMImageHeader& header);
+// Magic, version, size and header CRC checks; field values are left to the caller
+bool sdmImageHeaderValid(const SDMImageHeader& header);
+void sdmSealJournalHeader(SDMJournalHeader& header);
+bool sdmJournalHeaderValid(const SDMJournalHeader& header);
+void sdmSealDeltaHeader(SDMDeltaHeader& header);
+bool sdmDeltaHeaderValid(const SDMDeltaHeader& header);
+void sdmSealAddressHeader(SDMAddressHeader& header);
+bool sdmAddressHeaderValid(const SDMAddressHeader& header);
+void sdmSealLibraryHeader(SDMLibraryHeader& header);
+bool sdmLibraryHeaderValid(const SDMLibraryHeader& header);
+
+#endif
@@ -0,0 +1,113 @@
+#include "sdm_index.h"
+#include <algorithm>
+
+template <typename ForEachBit>
+void SDMBitIndex::buildWith(uint16_t count, uint16_t dim, ForEachBit for_each_bit) {
+    clear();
+    vector_dim = dim;
+    words_per_vector = SDMKernels::wordsForDim(dim);
+    item_count = count;
+
+    // Count postings per bit, then prefix-sum into offsets
+    offsets.assign(static_cast<size_t>(dim) + 1, 0);
+    min_weight = count > 0 ? dim : 0;
+    for (uint16_t item = 0; item < count; item++) {
+        uint16_t weight = 0;
+        for_each_bit(item, [&](uint16_t bit) {
+            offsets[bit + 1]++;
+            weight++;
+        });
+        min_weight = std::min(min_weight, weight);
+    }
+    for (uint16_t bit = 0; bit < dim; bit++) {
+        offsets[bit + 1] += offsets[bit];
+    }
+
+    // Fill postings; items are visited in order so every list is sorted
+    postings.resize(offsets[dim]);
+    InternalVector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (uint16_t item = 0; item < count; item++) {
+        for_each_bit(item, [&](uint16_t bit) {
+            postings[cursor[bit]++] = item;
+        });
+    }
+
+    overlap.assign(count, 0);
+    touched.reserve(count);
+}
+
+void SDMBitIndex::build(const uint32_t* vectors, uint16_t count, uint16_t dim) {
+    uint16_t words = SDMKernels::wordsForDim(dim);
+    buildWith(count, dim, [&](uint16_t item, auto&& emit) {
+        const uint32_t* vec = vectors + static_cast<size_t>(item) * words;
+        for (uint16_t w = 0; w < words; w++) {
+            uint32_t bits = vec[w];
+            while (bits) {
+                emit(w * 32 + __builtin_ctz(bits));
+                bits &= bits - 1;
+            }
+        }
+    });
+}
+
+void SDMBitIndex::buildFromPositions(const uint16_t* positions, uint16_t count, uint16_t ones, uint16_t dim) {
+    buildWith(count, dim, [&](uint16_t item, auto&& emit) {
+        const uint16_t* bits = positions + static_cast<size_t>(item) * ones;
+        for (uint16_t k = 0; k < ones; k++) {
+            emit(bits[k]);
+        }
+    });
+}
+
+void SDMBitIndex::clear() {
+    offsets.clear();
+    postings.clear();
+    overlap.clear();
+    touched.clear();
+    item_count = 0;
+    min_weight = 0;
+}
+
+size_t SDMBitIndex::memoryBytes() const {
+    return offsets.capacity() * sizeof(uint32_t) + postings.capacity() * sizeof(uint16_t) +
+           overlap.capacity() * sizeof(uint16_t) + touched.capacity() * sizeof(uint16_t);
+}
+
+uint32_t SDMBitIndex::queryWork(const uint32_t* query) const {
+    uint32_t work = 0;
+    for (uint16_t w = 0; w < words_per_vector; w++) {
+        uint32_t bits = query[w];
+        while (bits) {
+            uint16_t bit = w * 32 + __builtin_ctz(bits);
+            work += offsets[bit + 1] - offsets[bit];
+            bits &= bits - 1;
+        }
+    }
+    return work;
+}
+
+uint16_t SDMBitIndex::candidates(const uint32_t* query, uint16_t min_overlap, uint16_t* out) {
+    touched.clear();
+
+    for (uint16_t w = 0; w < words_per_vector; w++) {
+        uint32_t bits = query[w];
+        while (bits) {
+            uint16_t bit = w * 32 + __builtin_ctz(bits);
+            for (uint32_t p = offsets[bit]; p < offsets[bit + 1]; p++) {
+                uint16_t item = postings[p];
+                if (overlap[item] == 0) touched.push_back(item);
+                overlap[item]++;
+            }
+            bits &= bits - 1;
+        }
+    }
+
+    // Keep items over the threshold and reset the scratch counters
+    uint16_t found = 0;
+    for (uint16_t item : touched) {
+        if (overlap[item] >= min_overlap) out[found++] = item;
+        overlap[item] = 0;
+    }
+    std::sort(out, out + found);
+    return found;
+}
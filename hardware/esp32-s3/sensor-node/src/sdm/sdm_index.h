@@ -0,0 +1,47 @@
+#ifndef SDM_INDEX_H
+#define SDM_INDEX_H
+
+#include <stdint.h>
+#include "sdm_kernels.h"
+#include "sdm_alloc.h"
+
+// Inverted index over sparse packed vectors: for every bit position, the ids
+// of the vectors that have that bit set (CSR layout). Counting shared set bits
+// through the posting lists of a query's bits yields every vector whose
+// overlap reaches a threshold without touching the others, which for sparse
+// vectors means the Hamming ball around the query:
+//     distance(a, q) = |a| + |q| - 2 * overlap(a, q)
+class SDMBitIndex {
+private:
+    uint16_t vector_dim = 0;
+    uint16_t words_per_vector = 0;
+    uint16_t item_count = 0;
+    uint16_t min_weight = 0;                  // Smallest popcount of any indexed vector
+    InternalVector<uint32_t> offsets;         // vector_dim + 1 entries into postings
+    InternalVector<uint16_t> postings;        // Item ids grouped by bit position
+    InternalVector<uint16_t> overlap;         // Per-item overlap counters, up to vector_dim (query scratch)
+    InternalVector<uint16_t> touched;         // Items with a non-zero counter (query scratch)
+
+    template <typename ForEachBit>
+    void buildWith(uint16_t count, uint16_t dim, ForEachBit for_each_bit);
+
+public:
+    // Index count packed vectors stored back to back
+    void build(const uint32_t* vectors, uint16_t count, uint16_t dim);
+    // Index count vectors given as `ones` set-bit positions each, back to back
+    void buildFromPositions(const uint16_t* positions, uint16_t count, uint16_t ones, uint16_t dim);
+    void clear();
+    bool empty() const { return item_count == 0; }
+
+    uint16_t minWeight() const { return min_weight; }
+    size_t memoryBytes() const;
+
+    // Posting entries a query would visit; compare against a full scan's cost
+    uint32_t queryWork(const uint32_t* query) const;
+
+    // Write ids of items sharing at least min_overlap set bits with query into
+    // out (capacity = indexed item count), in ascending id order. Returns the count.
+    uint16_t candidates(const uint32_t* query, uint16_t min_overlap, uint16_t* out);
+};
+
+#endif
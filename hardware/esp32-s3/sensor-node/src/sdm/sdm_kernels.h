@@ -0,0 +1,348 @@
+#ifndef SDM_KERNELS_H
+#define SDM_KERNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(ESP_PLATFORM)
+#include "sdkconfig.h"
+#endif
+
+// ESP32-S3 PIE (128-bit SIMD) kernels; define SDM_DISABLE_SIMD to force the portable path
+#if defined(CONFIG_IDF_TARGET_ESP32S3) && !defined(SDM_DISABLE_SIMD)
+#define SDM_USE_PIE 1
+#else
+#define SDM_USE_PIE 0
+#endif
+
+// Host (native env) equivalents: AVX2 on x86-64, NEON on AArch64
+#if !SDM_USE_PIE && !defined(SDM_DISABLE_SIMD) && defined(__AVX2__)
+#define SDM_USE_AVX2 1
+#include <immintrin.h>
+#else
+#define SDM_USE_AVX2 0
+#endif
+
+#if !SDM_USE_PIE && !defined(SDM_DISABLE_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#define SDM_USE_NEON 1
+#include <arm_neon.h>
+#else
+#define SDM_USE_NEON 0
+#endif
+
+// Low-level bit-vector kernels shared by the SDM engine, encoder and libraries.
+// Packed vectors store bit i in word (i / 32), bit position (i % 32); unused
+// tail bits of the last word are always kept at zero.
+namespace SDMKernels {
+
+inline uint16_t wordsForDim(uint16_t vector_dim) {
+    return (vector_dim + 31) / 32;
+}
+
+inline bool testBit(const uint32_t* packed, uint16_t bit) {
+    return (packed[bit >> 5] >> (bit & 31)) & 1u;
+}
+
+inline void setBit(uint32_t* packed, uint16_t bit) {
+    packed[bit >> 5] |= (1u << (bit & 31));
+}
+
+#if SDM_USE_AVX2
+// Per-byte popcount by nibble lookup, summed into four 64-bit lanes
+inline __m256i popcount256(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_nibble));
+    __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibble));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+inline uint32_t sumLanes64(__m256i v) {
+    return static_cast<uint32_t>(_mm256_extract_epi64(v, 0) + _mm256_extract_epi64(v, 1) +
+                                 _mm256_extract_epi64(v, 2) + _mm256_extract_epi64(v, 3));
+}
+#endif
+
+// Wide paths take 256 bits (AVX2) or 128 bits (NEON) per step, unaligned
+// loads; the remaining words go through the scalar loop
+inline uint16_t hammingDistance(const uint32_t* a, const uint32_t* b, uint16_t words) {
+    uint32_t distance = 0;
+    uint16_t w = 0;
+#if SDM_USE_AVX2
+    if (words >= 8) {
+        __m256i sums = _mm256_setzero_si256();
+        for (; w + 8 <= words; w += 8) {
+            __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + w)),
+                                         _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + w)));
+            sums = _mm256_add_epi64(sums, popcount256(x));
+        }
+        distance = sumLanes64(sums);
+    }
+#elif SDM_USE_NEON
+    for (; w + 4 <= words; w += 4) {
+        uint32x4_t x = veorq_u32(vld1q_u32(a + w), vld1q_u32(b + w));
+        distance += vaddvq_u8(vcntq_u8(vreinterpretq_u8_u32(x)));
+    }
+#endif
+    for (; w < words; w++) {
+        distance += __builtin_popcount(a[w] ^ b[w]);
+    }
+    return static_cast<uint16_t>(distance);
+}
+
+inline uint16_t popcount(const uint32_t* packed, uint16_t words) {
+    uint32_t count = 0;
+    uint16_t w = 0;
+#if SDM_USE_AVX2
+    if (words >= 8) {
+        __m256i sums = _mm256_setzero_si256();
+        for (; w + 8 <= words; w += 8) {
+            sums = _mm256_add_epi64(sums, popcount256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(packed + w))));
+        }
+        count = sumLanes64(sums);
+    }
+#elif SDM_USE_NEON
+    for (; w + 4 <= words; w += 4) {
+        count += vaddvq_u8(vcntq_u8(vreinterpretq_u8_u32(vld1q_u32(packed + w))));
+    }
+#endif
+    for (; w < words; w++) {
+        count += __builtin_popcount(packed[w]);
+    }
+    return static_cast<uint16_t>(count);
+}
+
+// Mask of bits [begin, end) within one word; 0 <= begin < end <= 32
+inline uint32_t wordMask(uint16_t begin, uint16_t end) {
+    return (end >= 32 ? ~0u : (1u << end) - 1u) & ~((1u << begin) - 1u);
+}
+
+// Set bits [begin, end) a word at a time (thermometer codes)
+inline void setBitRange(uint32_t* packed, uint16_t begin, uint16_t end) {
+    while (begin < end) {
+        uint16_t word_end = (begin & ~31) + 32;
+        if (word_end > end) word_end = end;
+        packed[begin >> 5] |= wordMask(begin & 31, word_end - (begin & ~31));
+        begin = word_end;
+    }
+}
+
+inline void clearBitRange(uint32_t* packed, uint16_t begin, uint16_t end) {
+    while (begin < end) {
+        uint16_t word_end = (begin & ~31) + 32;
+        if (word_end > end) word_end = end;
+        packed[begin >> 5] &= ~wordMask(begin & 31, word_end - (begin & ~31));
+        begin = word_end;
+    }
+}
+
+// OR count bits of src starting at src_bit into dst starting at dst_bit, up
+// to 32 at a time; dst bits in the range should start clear
+inline void copyBitRange(uint32_t* dst, uint16_t dst_bit, const uint32_t* src, uint16_t src_bit, uint16_t count) {
+    while (count > 0) {
+        uint16_t chunk = 32 - (dst_bit & 31);
+        if (chunk > count) chunk = count;
+        uint16_t shift = src_bit & 31;
+        uint32_t value = src[src_bit >> 5] >> shift;
+        if (shift + chunk > 32) value |= src[(src_bit >> 5) + 1] << (32 - shift);
+        dst[dst_bit >> 5] |= (value & wordMask(0, chunk)) << (dst_bit & 31);
+        dst_bit += chunk;
+        src_bit += chunk;
+        count -= chunk;
+    }
+}
+
+// Number of set bits in [begin, end)
+inline uint16_t popcountRange(const uint32_t* packed, uint16_t begin, uint16_t end) {
+    uint32_t count = 0;
+    while (begin < end) {
+        uint16_t word_end = (begin & ~31) + 32;
+        if (word_end > end) word_end = end;
+        count += __builtin_popcount(packed[begin >> 5] & wordMask(begin & 31, word_end - (begin & ~31)));
+        begin = word_end;
+    }
+    return static_cast<uint16_t>(count);
+}
+
+// splitmix64: tiny counter-based PRNG, used to derive addresses from (seed, location)
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Uniform value in [0, range) by multiply-shift instead of modulo
+inline uint16_t reduceRange(uint32_t random, uint16_t range) {
+    return static_cast<uint16_t>((static_cast<uint64_t>(random) * range) >> 32);
+}
+
+// Convert between one-byte-per-bit vectors and the packed word layout
+inline void pack(const uint8_t* bits, uint16_t vector_dim, uint32_t* packed) {
+    uint16_t words = wordsForDim(vector_dim);
+    for (uint16_t w = 0; w < words; w++) packed[w] = 0;
+    for (uint16_t i = 0; i < vector_dim; i++) {
+        if (bits[i]) setBit(packed, i);
+    }
+}
+
+inline void unpack(const uint32_t* packed, uint16_t vector_dim, uint8_t* bits) {
+    for (uint16_t i = 0; i < vector_dim; i++) {
+        bits[i] = testBit(packed, i) ? 1 : 0;
+    }
+}
+
+// Expand a packed input into a per-dimension delta row of +strength (bit set)
+// or -strength (bit clear). Lanes between vector_dim and stride are zeroed so
+// row padding is never modified.
+inline void buildDeltaRow(const uint32_t* packed, uint16_t vector_dim, uint16_t stride,
+                          int16_t strength, int16_t* delta) {
+    for (uint16_t j = 0; j < vector_dim; j++) {
+        delta[j] = testBit(packed, j) ? strength : static_cast<int16_t>(-strength);
+    }
+    for (uint16_t j = vector_dim; j < stride; j++) {
+        delta[j] = 0;
+    }
+}
+
+// row[j] = saturate_int16(row[j] + delta[j]) over a full row. Both pointers
+// must be 16-byte aligned and stride a multiple of 8 (see SDM_ARENA_ALIGN).
+inline void saturatingAddRow(int16_t* row, const int16_t* delta, uint16_t stride) {
+#if SDM_USE_PIE
+    for (uint16_t block = 0; block < stride / 8; block++) {
+        asm volatile(
+            "ee.vld.128.ip q0, %0, 0\n"
+            "ee.vld.128.ip q1, %1, 16\n"
+            "ee.vadds.s16 q0, q0, q1\n"
+            "ee.vst.128.ip q0, %0, 16\n"
+            : "+r"(row), "+r"(delta)
+            :
+            : "memory");
+    }
+#elif SDM_USE_AVX2
+    uint16_t j = 0;
+    for (; j + 16 <= stride; j += 16) {
+        __m256i* lanes = reinterpret_cast<__m256i*>(row + j);
+        _mm256_storeu_si256(lanes, _mm256_adds_epi16(_mm256_loadu_si256(lanes),
+                                                     _mm256_loadu_si256(reinterpret_cast<const __m256i*>(delta + j))));
+    }
+    if (j < stride) {
+        __m128i* lanes = reinterpret_cast<__m128i*>(row + j);
+        _mm_store_si128(lanes, _mm_adds_epi16(_mm_load_si128(lanes), _mm_load_si128(reinterpret_cast<const __m128i*>(delta + j))));
+    }
+#elif SDM_USE_NEON
+    for (uint16_t j = 0; j < stride; j += 8) {
+        vst1q_s16(row + j, vqaddq_s16(vld1q_s16(row + j), vld1q_s16(delta + j)));
+    }
+#else
+    for (uint16_t j = 0; j < stride; j++) {
+        int32_t updated = static_cast<int32_t>(row[j]) + delta[j];
+        updated = updated > INT16_MAX ? INT16_MAX : updated;
+        updated = updated < INT16_MIN ? INT16_MIN : updated;
+        row[j] = static_cast<int16_t>(updated);
+    }
+#endif
+}
+
+// acc[j] += weight * row[j] over a full row (int32 accumulation)
+inline void accumulateWeightedRow(int32_t* acc, const int16_t* row, int32_t weight, uint16_t stride) {
+    for (uint16_t j = 0; j < stride; j++) {
+        acc[j] += weight * row[j];
+    }
+}
+
+// Narrow counter rows. int8 rows hold one lane per byte; 4-bit rows pack two
+// signed lanes per byte (even lane in the low nibble), range -8..7. Both take
+// int8 delta rows built by buildDeltaRow8, and stride stays the lane count.
+inline int8_t nibbleValue(uint8_t nibble) {
+    return static_cast<int8_t>(static_cast<uint8_t>(nibble << 4)) >> 4;
+}
+
+inline void buildDeltaRow8(const uint32_t* packed, uint16_t vector_dim, uint16_t stride,
+                           int8_t strength, int8_t* delta) {
+    for (uint16_t j = 0; j < vector_dim; j++) {
+        delta[j] = testBit(packed, j) ? strength : static_cast<int8_t>(-strength);
+    }
+    for (uint16_t j = vector_dim; j < stride; j++) {
+        delta[j] = 0;
+    }
+}
+
+// row[j] = saturate_int8(row[j] + delta[j]); same alignment rules as the int16
+// kernel with stride a multiple of 16
+inline void saturatingAddRow8(int8_t* row, const int8_t* delta, uint16_t stride) {
+#if SDM_USE_PIE
+    for (uint16_t block = 0; block < stride / 16; block++) {
+        asm volatile(
+            "ee.vld.128.ip q0, %0, 0\n"
+            "ee.vld.128.ip q1, %1, 16\n"
+            "ee.vadds.s8 q0, q0, q1\n"
+            "ee.vst.128.ip q0, %0, 16\n"
+            : "+r"(row), "+r"(delta)
+            :
+            : "memory");
+    }
+#elif SDM_USE_AVX2
+    uint16_t j = 0;
+    for (; j + 32 <= stride; j += 32) {
+        __m256i* lanes = reinterpret_cast<__m256i*>(row + j);
+        _mm256_storeu_si256(lanes, _mm256_adds_epi8(_mm256_loadu_si256(lanes),
+                                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(delta + j))));
+    }
+    if (j < stride) {
+        __m128i* lanes = reinterpret_cast<__m128i*>(row + j);
+        _mm_store_si128(lanes, _mm_adds_epi8(_mm_load_si128(lanes), _mm_load_si128(reinterpret_cast<const __m128i*>(delta + j))));
+    }
+#elif SDM_USE_NEON
+    for (uint16_t j = 0; j < stride; j += 16) {
+        vst1q_s8(row + j, vqaddq_s8(vld1q_s8(row + j), vld1q_s8(delta + j)));
+    }
+#else
+    for (uint16_t j = 0; j < stride; j++) {
+        int16_t updated = static_cast<int16_t>(row[j]) + delta[j];
+        updated = updated > INT8_MAX ? INT8_MAX : updated;
+        updated = updated < INT8_MIN ? INT8_MIN : updated;
+        row[j] = static_cast<int8_t>(updated);
+    }
+#endif
+}
+
+// Nibble lanes are clamped to -8..7; two lanes per byte, stride must be even
+inline void saturatingAddRow4(uint8_t* row, const int8_t* delta, uint16_t stride) {
+    for (uint16_t j = 0; j < stride; j += 2) {
+        uint8_t byte = row[j >> 1];
+        int16_t lo = nibbleValue(byte & 0x0F) + delta[j];
+        int16_t hi = nibbleValue(byte >> 4) + delta[j + 1];
+        lo = lo > 7 ? 7 : (lo < -8 ? -8 : lo);
+        hi = hi > 7 ? 7 : (hi < -8 ? -8 : hi);
+        row[j >> 1] = static_cast<uint8_t>((lo & 0x0F) | ((hi & 0x0F) << 4));
+    }
+}
+
+inline void accumulateWeightedRow8(int32_t* acc, const int8_t* row, int32_t weight, uint16_t stride) {
+    for (uint16_t j = 0; j < stride; j++) {
+        acc[j] += weight * row[j];
+    }
+}
+
+inline void accumulateWeightedRow4(int32_t* acc, const uint8_t* row, int32_t weight, uint16_t stride) {
+    for (uint16_t j = 0; j < stride; j += 2) {
+        uint8_t byte = row[j >> 1];
+        acc[j] += weight * nibbleValue(byte & 0x0F);
+        acc[j + 1] += weight * nibbleValue(byte >> 4);
+    }
+}
+
+// Counter value of one lane in a row of any supported width (16, 8 or 4 bits)
+inline int16_t counterLane(const uint8_t* row, uint8_t counter_bits, uint16_t lane) {
+    switch (counter_bits) {
+        case 8:  return reinterpret_cast<const int8_t*>(row)[lane];
+        case 4:  return nibbleValue((lane & 1) ? (row[lane >> 1] >> 4) : (row[lane >> 1] & 0x0F));
+        default: return reinterpret_cast<const int16_t*>(row)[lane];
+    }
+}
+
+} // namespace SDMKernels
+
+#endif
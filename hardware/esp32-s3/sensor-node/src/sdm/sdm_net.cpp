@@ -0,0 +1,116 @@
+#include "sdm_net.h"
+#include "sdm.h"
+#include <new>
+
+bool SDMNetService::begin(SparseDistributedMemory* sdm_instance, SemaphoreHandle_t lock, uint16_t port) {
+    if (task || !sdm_instance || !lock) return false;
+    sdm = sdm_instance;
+    sdm_lock = lock;
+    
+    queue = xQueueCreate(SDM_NET_QUEUE_DEPTH, sizeof(Request*));
+    if (!queue) return false;
+    
+    // Same core as loop(): the scan workers, when enabled, keep core 0 for themselves
+    if (xTaskCreatePinnedToCore(serviceTask, "sdm_net", SDM_NET_STACK, this, 1, &task, 1) != pdPASS) {
+        task = nullptr;
+        vQueueDelete(queue);
+        queue = nullptr;
+        return false;
+    }
+    
+    if (!udp.listen(port)) {
+        end();
+        return false;
+    }
+    udp.onPacket([this](AsyncUDPPacket& packet) { onPacket(packet); });
+    
+    Serial.printf("SDM network service on UDP port %u\n", port);
+    return true;
+}
+
+void SDMNetService::end() {
+    udp.close();
+    if (task) {
+        // A null request wakes the task and tells it to exit
+        Request* wake = nullptr;
+        xQueueSend(queue, &wake, portMAX_DELAY);
+        while (task) delay(1);
+    }
+    if (queue) {
+        // Requests still queued belong to nobody now
+        Request* left;
+        while (xQueueReceive(queue, &left, 0) == pdTRUE) delete left;
+        vQueueDelete(queue);
+        queue = nullptr;
+    }
+}
+
+static uint16_t frameSequence(const uint8_t* data, size_t length) {
+    return length >= 6 ? data[4] | (data[5] << 8) : 0;
+}
+
+void SDMNetService::onPacket(AsyncUDPPacket& packet) {
+    // Runs in the UDP stack's task: copy and hand off, nothing else
+    if (packet.length() == 0 || packet.length() > SDM_NET_MAX_DATAGRAM) {
+        reject(packet, SDM_STATUS_TOO_LARGE);
+        return;
+    }
+    
+    Request* request = new (std::nothrow) Request;
+    if (!request) {
+        reject(packet, SDM_STATUS_BUSY);
+        return;
+    }
+    request->address = static_cast<uint32_t>(packet.remoteIP());
+    request->port = packet.remotePort();
+    request->length = static_cast<uint16_t>(packet.length());
+    memcpy(request->data, packet.data(), packet.length());
+    // The task owns the request once queued
+    if (xQueueSend(queue, &request, 0) != pdTRUE) {
+        delete request;
+        reject(packet, SDM_STATUS_BUSY);
+    }
+}
+
+void SDMNetService::reject(AsyncUDPPacket& packet, SDMFrameStatus status) {
+    requests_dropped++;
+    std::vector<uint8_t> reply;
+    sdmStatusFrame(reply, SDM_FRAME_NAK, frameSequence(packet.data(), packet.length()), status);
+    packet.write(reply.data(), reply.size());
+}
+
+void SDMNetService::serviceTask(void* arg) {
+    static_cast<SDMNetService*>(arg)->serviceLoop();
+}
+
+void SDMNetService::serviceLoop() {
+    std::vector<uint8_t> reply;
+    reply.reserve(SDM_NET_MAX_DATAGRAM);
+    uint16_t max_payload = SDM_NET_MAX_DATAGRAM - SDM_FRAME_HEADER - 4;
+    
+    Request* request;
+    while (xQueueReceive(queue, &request, portMAX_DELAY) == pdTRUE && request) {
+        SDMFrame frame;
+        SDMFrameStatus status = sdmDecodeFrame(request->data, request->length, frame);
+        if (status != SDM_STATUS_OK) {
+            requests_dropped++;
+            sdmStatusFrame(reply, SDM_FRAME_NAK, frameSequence(request->data, request->length), status);
+        } else {
+            xSemaphoreTake(sdm_lock, portMAX_DELAY);
+            bool served = sdmServeFrame(*sdm, frame, max_payload, reply);
+            xSemaphoreGive(sdm_lock);
+            if (served) {
+                requests_served++;
+            } else {
+                // Library uploads need an ordered stream; they stay on the serial link
+                requests_dropped++;
+                sdmStatusFrame(reply, frame.type, frame.sequence, SDM_STATUS_BAD_REQUEST);
+            }
+        }
+        udp.writeTo(reply.data(), reply.size(), IPAddress(request->address), request->port);
+        delete request;
+    }
+    
+    task = nullptr;
+    vTaskDelete(nullptr);
+}
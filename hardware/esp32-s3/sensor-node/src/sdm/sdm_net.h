@@ -0,0 +1,57 @@
+#ifndef SDM_NET_H
+#define SDM_NET_H
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "sdm_protocol.h"
+
+// UDP port of the network SDM service
+#define SDM_NET_PORT 5710
+// One frame per datagram; kept under the Ethernet MTU because lwIP does not
+// reassemble fragmented datagrams by default
+#define SDM_NET_MAX_DATAGRAM 1472
+// Requests waiting for the service task; further ones are answered BUSY
+#define SDM_NET_QUEUE_DEPTH 4
+#define SDM_NET_STACK 6144
+
+// Network SDM endpoint. Datagrams carry the serial frames of sdm_protocol.h
+// (INFO, WRITE, READ); each reply goes back to the sender with the request's
+// sequence number. The UDP callback only copies the datagram into a queue;
+// a dedicated task takes sdm_lock around each request, so network I/O never
+// stalls a scan and the scan never holds up the network stack.
+class SDMNetService {
+public:
+    // sdm_lock: mutex every other user of sdm also holds while calling it
+    bool begin(SparseDistributedMemory* sdm, SemaphoreHandle_t sdm_lock, uint16_t port = SDM_NET_PORT);
+    void end();
+    bool running() const { return task != nullptr; }
+
+    uint32_t served() const { return requests_served; }
+    uint32_t dropped() const { return requests_dropped; }  // Queue full or malformed
+
+private:
+    struct Request {
+        uint32_t address;
+        uint16_t port;
+        uint16_t length;
+        alignas(4) uint8_t data[SDM_NET_MAX_DATAGRAM];  // Keeps frame payloads word-aligned
+    };
+
+    SparseDistributedMemory* sdm = nullptr;
+    SemaphoreHandle_t sdm_lock = nullptr;
+    AsyncUDP udp;
+    QueueHandle_t queue = nullptr;        // Request*, owned by whoever holds it
+    TaskHandle_t task = nullptr;
+    volatile uint32_t requests_served = 0;
+    volatile uint32_t requests_dropped = 0;
+
+    void onPacket(AsyncUDPPacket& packet);
+    void reject(AsyncUDPPacket& packet, SDMFrameStatus status);
+    static void serviceTask(void* arg);
+    void serviceLoop();
+};
+
+#endif
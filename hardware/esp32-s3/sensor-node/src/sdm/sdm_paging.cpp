@@ -0,0 +1,279 @@
+#include "sdm.h"
+
+// Paged mode keeps only cache_pages pages of SDM_PAGE_ROWS counter rows in the
+// arena; memory.bin on the card is the backing store, laid out exactly as a
+// resident save so either mode can open the other's image.
+
+uint8_t* SparseDistributedMemory::pagedRow(uint16_t location, bool for_write) {
+    uint16_t page = location / SDM_PAGE_ROWS;
+    size_t page_bytes = static_cast<size_t>(SDM_PAGE_ROWS) * row_bytes;
+    uint16_t slot = page_to_slot[page];
+
+    if (slot == SDM_NO_PAGE) {
+        slot = evictPage();
+        if (slot == SDM_NO_PAGE) {
+            // Every cached page is dirty and the card won't take them: serve
+            // this row alone, uncached. Changes to it are lost, but the
+            // cached pages keep theirs until a writeback succeeds.
+            uint32_t offset = imageRowsOffset() + static_cast<uint32_t>(location) * row_bytes;
+            if (!page_file.seek(offset) || page_file.read(page_spill.data(), row_bytes) != row_bytes) {
+                memset(page_spill.data(), 0, row_bytes);
+            }
+            page_faults++;
+            return page_spill.data();
+        }
+
+        PageSlot& victim = page_slots[slot];
+        uint8_t* data = counters + slot * page_bytes;
+        uint32_t first_row = static_cast<uint32_t>(page) * SDM_PAGE_ROWS;
+        size_t bytes = std::min<uint32_t>(SDM_PAGE_ROWS, config.num_locations - first_row) * row_bytes;
+        if (!page_file.seek(imageRowsOffset() + first_row * row_bytes) || page_file.read(data, bytes) != bytes) {
+            // Unreadable page: serve zeros rather than another page's stale rows
+            Serial.printf("SDM page %d read failed\n", page);
+            memset(data, 0, bytes);
+        }
+
+        victim.page = page;
+        victim.dirty = false;
+        page_to_slot[page] = slot;
+        page_faults++;
+    }
+
+    PageSlot& entry = page_slots[slot];
+    entry.last_use = ++page_clock;
+    entry.dirty |= for_write;
+    return counters + slot * page_bytes + static_cast<size_t>(location % SDM_PAGE_ROWS) * row_bytes;
+}
+
+uint16_t SparseDistributedMemory::evictPage() {
+    // A free slot, else the least recently used page
+    uint16_t slot = 0;
+    for (uint16_t s = 0; s < page_slots.size(); s++) {
+        if (page_slots[s].page == SDM_NO_PAGE) return s;
+        if (page_slots[s].last_use < page_slots[slot].last_use) slot = s;
+    }
+    if (page_slots[slot].dirty && !writeBackSlot(slot)) {
+        // Keep it cached so its rows aren't lost (flushPages() retries it);
+        // take the least recently used clean page instead
+        Serial.printf("SDM page %d writeback failed; keeping it cached\n", page_slots[slot].page);
+        page_failures++;
+        slot = SDM_NO_PAGE;
+        for (uint16_t s = 0; s < page_slots.size(); s++) {
+            if (page_slots[s].dirty) continue;
+            if (slot == SDM_NO_PAGE || page_slots[s].last_use < page_slots[slot].last_use) slot = s;
+        }
+        if (slot == SDM_NO_PAGE) return SDM_NO_PAGE;
+    }
+    page_to_slot[page_slots[slot].page] = SDM_NO_PAGE;
+    page_slots[slot].page = SDM_NO_PAGE;
+    return slot;
+}
+
+bool SparseDistributedMemory::writeBackSlot(uint16_t slot) {
+    PageSlot& entry = page_slots[slot];
+    size_t page_bytes = static_cast<size_t>(SDM_PAGE_ROWS) * row_bytes;
+
+    // The payload CRC no longer holds once rows change in place
+    if (!image_marked_open) {
+        SDMImageHeader header;
+        if (!page_file.seek(0) || page_file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+        header.flags |= SDM_IMAGE_FLAG_OPEN;
+        sdmSealImageHeader(header);
+        if (!page_file.seek(0) || page_file.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+        image_marked_open = true;
+    }
+
+    uint32_t first_row = static_cast<uint32_t>(entry.page) * SDM_PAGE_ROWS;
+    size_t bytes = std::min<uint32_t>(SDM_PAGE_ROWS, config.num_locations - first_row) * row_bytes;
+    if (!page_file.seek(imageRowsOffset() + first_row * row_bytes) ||
+        page_file.write(counters + slot * page_bytes, bytes) != bytes) {
+        return false;
+    }
+    entry.dirty = false;
+    page_writebacks++;
+    return true;
+}
+
+bool SparseDistributedMemory::flushPages() {
+    bool success = true;
+    for (uint16_t s = 0; s < page_slots.size(); s++) {
+        if (page_slots[s].page != SDM_NO_PAGE && page_slots[s].dirty) {
+            success &= writeBackSlot(s);
+        }
+    }
+
+    // Access counts are resident; write them alongside the rows
+    size_t count_bytes = access_counts.size() * sizeof(uint16_t);
+    if (success && (!page_file.seek(sizeof(SDMImageHeader)) ||
+                    page_file.write((const uint8_t*)access_counts.data(), count_bytes) != count_bytes)) {
+        success = false;
+    }
+    page_file.flush();
+    if (success) markCheckpointed();
+    return success;
+}
+
+bool SparseDistributedMemory::createPagedImage() {
+    closePagedImage();
+    if (!SD.exists("/sdm")) {
+        SD.mkdir("/sdm");
+    }
+
+    // Never truncate an image in place: one that didn't open (another
+    // config's, or a transient read error) is kept as the backup
+    if (SD.exists(memory_file)) {
+        String backup_file = memory_file + ".bak";
+        if (SD.exists(backup_file)) {
+            SD.remove(backup_file);
+        }
+        if (!SD.rename(memory_file, backup_file)) {
+            Serial.printf("Could not move %s aside\n", memory_file.c_str());
+            return false;
+        }
+    }
+
+    SDMImageHeader header;
+    header.seed = config.seed;
+    header.num_locations = config.num_locations;
+    header.vector_dim = config.vector_dim;
+    header.counter_bits = config.counter_bits;
+    header.flags = sparse_mode ? SDM_IMAGE_FLAG_SPARSE_ADDRESSES : 0;
+    header.address_ones = address_ones;
+    header.row_bytes = row_bytes;
+    header.payload_bytes = config.num_locations * sizeof(uint16_t) + static_cast<uint32_t>(config.num_locations) * row_bytes;
+
+    // An all-zero payload: stream zero blocks, checksumming as they go
+    InternalVector<uint8_t> zeros(SDM_IMAGE_BLOCK, 0);
+    uint32_t crc = 0;
+    for (uint32_t done = 0; done < header.payload_bytes; done += SDM_IMAGE_BLOCK) {
+        crc = sdmCrc32(crc, zeros.data(), std::min<uint32_t>(header.payload_bytes - done, SDM_IMAGE_BLOCK));
+    }
+    header.payload_crc = crc;
+    sdmSealImageHeader(header);
+
+    File file = SD.open(memory_file, FILE_WRITE);
+    if (!file) return false;
+    bool written = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+    for (uint32_t done = 0; written && done < header.payload_bytes; done += SDM_IMAGE_BLOCK) {
+        size_t chunk = std::min<uint32_t>(header.payload_bytes - done, SDM_IMAGE_BLOCK);
+        written = file.write(zeros.data(), chunk) == chunk;
+    }
+    file.close();
+    if (!written) {
+        SD.remove(memory_file);
+        return false;
+    }
+
+    Serial.printf("Created %u byte paged memory image\n", (unsigned)(sizeof(header) + header.payload_bytes));
+    return openPagedImage();
+}
+
+bool SparseDistributedMemory::recoverPagedImage() {
+    // As in resident mode, fall back to the backup. The two files trade
+    // places rather than either being removed, so a failed attempt loses nothing.
+    String backup_file = memory_file + ".bak";
+    String swap_file = memory_file + ".swap";
+    if (!SD.exists(backup_file)) return false;
+    if (SD.exists(swap_file)) {
+        SD.remove(swap_file);
+    }
+    bool had_image = SD.exists(memory_file);
+    if (had_image && !SD.rename(memory_file, swap_file)) return false;
+
+    if (!SD.rename(backup_file, memory_file) || !openPagedImage()) {
+        if (SD.exists(memory_file)) SD.rename(memory_file, backup_file);
+        if (had_image) SD.rename(swap_file, memory_file);
+        return false;
+    }
+    if (had_image) SD.rename(swap_file, backup_file);
+    Serial.println("Recovered memory from backup image");
+    return true;
+}
+
+bool SparseDistributedMemory::openPagedImage() {
+    closePagedImage();
+    std::fill(access_counts.begin(), access_counts.end(), 0);
+
+    page_file = SD.open(memory_file, "r+");
+    if (!page_file) return false;
+
+    SDMImageHeader header;
+    bool usable = page_file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                  sdmImageHeaderValid(header) && matchesImage(header);
+    if (!usable) {
+        closePagedImage();
+        return false;
+    }
+
+    // Verify a cleanly saved image block by block; an open one was never resealed
+    size_t count_bytes = access_counts.size() * sizeof(uint16_t);
+    bool complete = page_file.read((uint8_t*)access_counts.data(), count_bytes) == count_bytes;
+    if (complete && !(header.flags & SDM_IMAGE_FLAG_OPEN)) {
+        InternalVector<uint8_t> block(SDM_IMAGE_BLOCK);
+        uint32_t crc = sdmCrc32(0, access_counts.data(), count_bytes);
+        uint32_t remaining = header.payload_bytes - count_bytes;
+        while (complete && remaining > 0) {
+            size_t chunk = std::min<uint32_t>(remaining, SDM_IMAGE_BLOCK);
+            complete = page_file.read(block.data(), chunk) == chunk;
+            crc = sdmCrc32(crc, block.data(), chunk);
+            remaining -= chunk;
+        }
+        complete = complete && crc == header.payload_crc;
+    } else if (complete) {
+        Serial.println("Paged memory image was not closed cleanly; payload CRC not verified");
+    }
+    if (!complete) {
+        Serial.printf("%s is truncated or corrupt\n", memory_file.c_str());
+        closePagedImage();
+        std::fill(access_counts.begin(), access_counts.end(), 0);
+        return false;
+    }
+
+    image_crc = header.payload_crc;
+    image_marked_open = header.flags & SDM_IMAGE_FLAG_OPEN;
+    image_on_card = true;
+    markCheckpointed();
+    return true;
+}
+
+bool SparseDistributedMemory::sealPagedImage() {
+    if (!page_file || !flushPages()) return false;
+
+    // Recompute the payload CRC from the card and clear the open flag
+    SDMImageHeader header;
+    if (!page_file.seek(0) || page_file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+
+    InternalVector<uint8_t> block(SDM_IMAGE_BLOCK);
+    uint32_t crc = 0;
+    for (uint32_t done = 0; done < header.payload_bytes; done += SDM_IMAGE_BLOCK) {
+        size_t chunk = std::min<uint32_t>(header.payload_bytes - done, SDM_IMAGE_BLOCK);
+        if (page_file.read(block.data(), chunk) != chunk) return false;
+        crc = sdmCrc32(crc, block.data(), chunk);
+    }
+
+    header.payload_crc = crc;
+    header.flags &= ~SDM_IMAGE_FLAG_OPEN;
+    sdmSealImageHeader(header);
+    if (!page_file.seek(0) || page_file.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+    page_file.flush();
+
+    image_crc = crc;
+    image_marked_open = false;
+    if (SD.exists(journal_file)) {
+        SD.remove(journal_file);
+    }
+    journal_bytes = 0;
+    return true;
+}
+
+void SparseDistributedMemory::closePagedImage() {
+    if (page_file) {
+        page_file.close();
+    }
+    for (PageSlot& slot : page_slots) {
+        slot = PageSlot();
+    }
+    std::fill(page_to_slot.begin(), page_to_slot.end(), SDM_NO_PAGE);
+    image_marked_open = false;
+    image_on_card = false;
+}
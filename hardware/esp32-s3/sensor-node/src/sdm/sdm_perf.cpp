@@ -0,0 +1,249 @@
+#include "sdm_perf.h"
+
+// Distinct vectors the timed iterations rotate through (two full batches)
+#define SDM_PERF_VECTORS (2 * SDM_BATCH_MAX)
+
+template <typename Op>
+SDMPerfResult& SDMPerfHarness::measure(const char* phase, const SDMConfig& config, uint16_t count, Op op) {
+    for (uint16_t i = 0; i < warmup; i++) {
+        op(i);
+    }
+    samples.resize(count);
+    uint64_t total = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        samples[i] = op(warmup + i);
+        total += samples[i];
+    }
+    std::sort(samples.begin(), samples.end());
+    
+    // Nearest-rank percentiles
+    SDMPerfResult result;
+    result.phase = phase;
+    result.config = config;
+    result.iterations = count;
+    result.mean_us = sdmPerfTicksToUs(static_cast<float>(total) / count);
+    result.p50_us = sdmPerfTicksToUs(samples[(count + 1) / 2 - 1]);
+    result.p99_us = sdmPerfTicksToUs(samples[(static_cast<uint32_t>(count) * 99 + 99) / 100 - 1]);
+    result.max_us = sdmPerfTicksToUs(samples[count - 1]);
+    result.ops_per_sec = result.mean_us > 0.0f ? 1e6f / result.mean_us : 0.0f;
+    rows.push_back(result);
+    return rows.back();
+}
+
+uint16_t SDMPerfHarness::scanActivated(SparseDistributedMemory& sdm, const uint32_t* query) {
+    uint16_t count = 0;
+    if (sdm.config.target_activations) {
+        // The engine's k-nearest selection, ties at the radius lowest id first
+        uint16_t ties;
+        uint16_t radius = sdm.selectNearest(query, ties);
+        for (uint16_t location = 0; location < sdm.config.num_locations; location++) {
+            uint16_t dist = sdm.distance_scratch[location];
+            if (dist > radius) continue;
+            if (dist == radius) {
+                if (ties == 0) continue;
+                ties--;
+            }
+            activated[count] = location;
+            distances[count] = dist;
+            count++;
+        }
+        return count;
+    }
+    
+    uint16_t query_weight = sdm.queryWeight(query);
+    for (uint16_t location = 0; location < sdm.config.num_locations; location++) {
+        uint16_t dist = sdm.locationDistance(location, query, query_weight);
+        if (dist > sdm.config.access_radius) continue;
+        activated[count] = location;
+        distances[count] = dist;
+        count++;
+    }
+    return count;
+}
+
+bool SDMPerfHarness::run(const SDMConfig& base_config) {
+    if (iterations == 0) return false;
+    
+    SDMConfig config = base_config;
+    config.persistent = false;
+    
+    // Init is the slow phase; a handful of samples is enough
+    measure("init", config, std::min<uint16_t>(iterations, 16), [&](uint16_t) {
+        SparseDistributedMemory scratch(config);
+        uint32_t start = sdmPerfTicks();
+        scratch.initialize();
+        return sdmPerfTicks() - start;
+    });
+    
+    SparseDistributedMemory sdm(config);
+    if (!sdm.initialize()) {
+        return false;
+    }
+    activated.resize(config.num_locations);
+    distances.resize(config.num_locations);
+    if (sdm.weight_table.size() != static_cast<size_t>(sdm.maxActivationDistance()) + 1) {
+        sdm.rebuildWeightTable();
+    }
+    
+    // Random sparse vectors as in testConfiguration, derived from the seed so
+    // device and host runs time the same work
+    uint16_t words = sdm.wordsPerVector();
+    InternalVector<uint32_t> vectors(static_cast<size_t>(SDM_PERF_VECTORS) * words, 0);
+    InternalVector<uint32_t> outputs(vectors.size(), 0);
+    uint16_t ones = std::max<uint16_t>(1, static_cast<uint16_t>(config.vector_dim * config.sparsity));
+    uint64_t state = config.seed ^ 0x9E2F0A55u;
+    for (uint16_t v = 0; v < SDM_PERF_VECTORS; v++) {
+        uint32_t* vector = &vectors[static_cast<size_t>(v) * words];
+        for (uint16_t set = 0; set < ones;) {
+            uint16_t bit = SDMKernels::reduceRange(static_cast<uint32_t>(SDMKernels::splitmix64(state)), config.vector_dim);
+            if (SDMKernels::testBit(vector, bit)) continue;
+            SDMKernels::setBit(vector, bit);
+            set++;
+        }
+    }
+    auto vectorAt = [&](uint16_t i) { return &vectors[static_cast<size_t>(i % SDM_PERF_VECTORS) * words]; };
+    
+    // Phases that scan also report the mean activated count (warmup included)
+    uint32_t activated_total = 0;
+    uint32_t calls = 0;
+    auto meanActivated = [&]() {
+        float mean = calls ? static_cast<float>(activated_total) / calls : 0.0f;
+        activated_total = calls = 0;
+        return mean;
+    };
+    
+    SDMPerfResult* row = &measure("scan", config, iterations, [&](uint16_t i) {
+        uint32_t start = sdmPerfTicks();
+        activated_total += scanActivated(sdm, vectorAt(i));
+        calls++;
+        return sdmPerfTicks() - start;
+    });
+    row->activated = meanActivated();
+    
+    // Only where the engine would take the indexed path for every vector;
+    // k-nearest selection always measures every location
+    bool index_applies = !sdm.address_index.empty() && !config.target_activations;
+    for (uint16_t v = 0; v < SDM_PERF_VECTORS && index_applies; v++) {
+        index_applies = sdm.indexMinOverlap(vectorAt(v)) > 0;
+    }
+    if (index_applies) {
+        row = &measure("scan_index", config, iterations, [&](uint16_t i) {
+            const uint32_t* query = vectorAt(i);
+            uint32_t start = sdmPerfTicks();
+            uint16_t candidates = sdm.address_index.candidates(query, sdm.indexMinOverlap(query),
+                                                               sdm.candidate_scratch.data());
+            uint16_t query_weight = sdm.queryWeight(query);
+            uint16_t count = 0;
+            for (uint16_t c = 0; c < candidates; c++) {
+                count += sdm.locationDistance(sdm.candidate_scratch[c], query, query_weight) <= config.access_radius;
+            }
+            uint32_t elapsed = sdmPerfTicks() - start;
+            activated_total += count;
+            calls++;
+            return elapsed;
+        });
+        row->activated = meanActivated();
+    }
+    
+    row = &measure("update", config, iterations, [&](uint16_t i) {
+        const uint32_t* input = vectorAt(i);
+        uint16_t count = scanActivated(sdm, input);
+        uint32_t start = sdmPerfTicks();
+        sdm.buildDeltaRows(input, 1, 1);
+        for (uint16_t a = 0; a < count; a++) {
+            sdm.applyWrite(activated[a], sdm.deltaRow(0));
+        }
+        uint32_t elapsed = sdmPerfTicks() - start;
+        activated_total += count;
+        calls++;
+        return elapsed;
+    });
+    row->activated = meanActivated();
+    
+    row = &measure("accumulate", config, iterations, [&](uint16_t i) {
+        uint16_t count = scanActivated(sdm, vectorAt(i));
+        uint32_t* output = &outputs[0];
+        uint32_t start = sdmPerfTicks();
+        SparseDistributedMemory::ScanPartial partial = {};
+        for (uint16_t a = 0; a < count; a++) {
+            sdm.applyRead(activated[a], distances[a], sdm.read_accum, partial, 0);
+        }
+        std::fill(output, output + words, 0);
+        for (uint16_t j = 0; count > 0 && j < config.vector_dim; j++) {
+            if (sdm.read_accum[j] > 0) SDMKernels::setBit(output, j);
+        }
+        uint32_t elapsed = sdmPerfTicks() - start;
+        activated_total += count;
+        calls++;
+        return elapsed;
+    });
+    row->activated = meanActivated();
+    
+    SDMEncoder encoder(&sdm);
+    std::vector<String> texts;
+    for (uint16_t t = 0; t < SDM_PERF_VECTORS; t++) {
+        texts.push_back("SENSOR_" + String(t * 7919) + "_READING");
+    }
+    measure("encode", config, iterations, [&](uint16_t i) {
+        uint32_t start = sdmPerfTicks();
+        encoder.encodeText(texts[i % SDM_PERF_VECTORS], &outputs[0]);
+        return sdmPerfTicks() - start;
+    });
+    
+    measure("write", config, iterations, [&](uint16_t i) {
+        uint32_t start = sdmPerfTicks();
+        sdm.write(vectorAt(i), 1);
+        return sdmPerfTicks() - start;
+    });
+    measure("read", config, iterations, [&](uint16_t i) {
+        uint32_t start = sdmPerfTicks();
+        sdm.read(vectorAt(i), &outputs[0]);
+        return sdmPerfTicks() - start;
+    });
+    
+    // Batched ops are reported per vector
+    measure("write_batch", config, iterations, [&](uint16_t i) {
+        const uint32_t* batch = &vectors[static_cast<size_t>(i % 2) * SDM_BATCH_MAX * words];
+        uint32_t start = sdmPerfTicks();
+        sdm.writeBatch(batch, SDM_BATCH_MAX, 1);
+        return (sdmPerfTicks() - start) / SDM_BATCH_MAX;
+    });
+    measure("read_batch", config, iterations, [&](uint16_t i) {
+        const uint32_t* batch = &vectors[static_cast<size_t>(i % 2) * SDM_BATCH_MAX * words];
+        uint32_t start = sdmPerfTicks();
+        sdm.readBatch(batch, SDM_BATCH_MAX, outputs.data());
+        return (sdmPerfTicks() - start) / SDM_BATCH_MAX;
+    });
+    return true;
+}
+
+void SDMPerfHarness::print() const {
+    Serial.println("phase        dim   locs  r  bits iters     mean      p50      p99    ops/s  active");
+    for (const SDMPerfResult& row : rows) {
+        Serial.printf("%-11s %4u %6u %3u %2u %5u %8.2f %8.2f %8.2f %8.0f %7.1f\n",
+                      row.phase, row.config.vector_dim, row.config.num_locations, row.config.access_radius,
+                      row.config.counter_bits, row.iterations, row.mean_us, row.p50_us, row.p99_us,
+                      row.ops_per_sec, row.activated);
+    }
+}
+
+bool SDMPerfHarness::saveCSV(const String& path) const {
+    File file = SD.open(path, FILE_WRITE);
+    if (!file) {
+        Serial.printf("Failed to open %s\n", path.c_str());
+        return false;
+    }
+    
+    file.println("phase,vector_dim,num_locations,access_radius,counter_bits,sparse_addresses,use_index,"
+                 "iterations,mean_us,p50_us,p99_us,max_us,ops_per_sec,activated");
+    for (const SDMPerfResult& row : rows) {
+        file.println(String(row.phase) + "," + String(row.config.vector_dim) + "," +
+                     String(row.config.num_locations) + "," + String(row.config.access_radius) + "," +
+                     String(row.config.counter_bits) + "," + String(row.config.sparse_addresses ? 1 : 0) + "," +
+                     String(row.config.use_index ? 1 : 0) + "," + String(row.iterations) + "," +
+                     String(row.mean_us, 3) + "," + String(row.p50_us, 3) + "," + String(row.p99_us, 3) + "," +
+                     String(row.max_us, 3) + "," + String(row.ops_per_sec, 1) + "," + String(row.activated, 1));
+    }
+    file.close();
+    return true;
+}
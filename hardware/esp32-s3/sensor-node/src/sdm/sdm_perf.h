@@ -0,0 +1,72 @@
+#ifndef SDM_PERF_H
+#define SDM_PERF_H
+
+#include "sdm.h"
+
+#if defined(ESP_PLATFORM)
+// CPU cycle counter: sub-microsecond resolution for the short kernel phases.
+// A single sample must stay under 2^32 cycles (~17 s at 240 MHz).
+inline uint32_t sdmPerfTicks() { return ESP.getCycleCount(); }
+inline float sdmPerfTicksToUs(float ticks) { return ticks / getCpuFreqMHz(); }
+#else
+#include <chrono>
+inline uint32_t sdmPerfTicks() {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+inline float sdmPerfTicksToUs(float ticks) { return ticks / 1000.0f; }
+#endif
+
+// One phase of one configuration; latencies in microseconds per operation
+struct SDMPerfResult {
+    const char* phase = "";
+    SDMConfig config;
+    uint16_t iterations = 0;
+    float mean_us = 0.0f;
+    float p50_us = 0.0f;
+    float p99_us = 0.0f;
+    float max_us = 0.0f;
+    float ops_per_sec = 0.0f;
+    float activated = 0.0f;  // Mean activated locations per op, where the phase scans
+};
+
+// Per-phase latency harness. Each phase runs `warmup` untimed iterations,
+// then `iterations` individually timed ones over a rotating set of random
+// sparse vectors on a scratch (non-persistent) memory:
+//   init        initialize(): allocation, addresses, index
+//   scan        linear distance scan over every location (the k-nearest
+//               selection when target_activations is set)
+//   scan_index  index candidates plus their distance checks (use_index only,
+//               not with target_activations)
+//   update      delta rows and saturating counter update of the activated rows
+//   accumulate  weighted counter sums of the activated rows and thresholding
+//   encode      SDMEncoder::encodeText into a packed buffer
+//   write/read  the public packed API end to end
+//   write_batch/read_batch  per vector, in batches of SDM_BATCH_MAX
+// Nothing touches the SD card while timing; results stay in RAM until
+// saveCSV() writes them in one go.
+class SDMPerfHarness {
+public:
+    uint16_t warmup = 8;
+    uint16_t iterations = 128;
+
+    bool run(const SDMConfig& config);
+    const std::vector<SDMPerfResult>& results() const { return rows; }
+    void clear() { rows.clear(); }
+
+    void print() const;
+    bool saveCSV(const String& path) const;
+
+private:
+    std::vector<SDMPerfResult> rows;
+    InternalVector<uint32_t> samples;      // Ticks per timed iteration
+    InternalVector<uint16_t> activated;    // Activated locations of the current vector
+    InternalVector<uint16_t> distances;
+
+    // op(i) runs iteration i and returns the ticks it spent in the timed part
+    template <typename Op>
+    SDMPerfResult& measure(const char* phase, const SDMConfig& config, uint16_t count, Op op);
+    uint16_t scanActivated(SparseDistributedMemory& sdm, const uint32_t* query);
+};
+
+#endif
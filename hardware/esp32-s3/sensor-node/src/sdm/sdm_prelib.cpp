@@ -22,9 +22,136 @@ public:
         }
     }
     
+    // Sequential reader over vectors.bin in either format. Holds one file and
+    // no per-library state, so merges run in constant memory.
+    class LibraryReader {
+    public:
+        uint32_t num_vectors = 0;
+        uint32_t vector_dim = 0;
+        uint16_t words_per_vector = 0;
+        uint16_t version = 0;
+        
+        bool open(const String& path) {
+            file = SD.open(path);
+            if (!file) return false;
+            
+            SDMLibraryHeader header;
+            if (file.read((uint8_t*)&header, sizeof(uint32_t)) != sizeof(uint32_t)) return false;
+            if (header.magic == SDM_LIBRARY_MAGIC) {
+                if (file.read((uint8_t*)&header + sizeof(uint32_t), sizeof(header) - sizeof(uint32_t)) !=
+                        sizeof(header) - sizeof(uint32_t) ||
+                    !sdmLibraryHeaderValid(header) ||
+                    header.words_per_vector != SDMKernels::wordsForDim(header.vector_dim)) {
+                    return false;
+                }
+                version = header.version;
+                num_vectors = header.num_vectors;
+                vector_dim = header.vector_dim;
+                labels_offset = header.labels_offset;
+                vectors_crc = header.vectors_crc;
+            } else {
+                // v1: (num_vectors, vector_dim) then one byte per bit
+                version = 1;
+                num_vectors = header.magic;
+                if (file.read((uint8_t*)&vector_dim, sizeof(vector_dim)) != sizeof(vector_dim)) return false;
+            }
+            words_per_vector = SDMKernels::wordsForDim(vector_dim);
+            return true;
+        }
+        
+        // Read up to max_count packed vectors; returns how many were read
+        uint32_t readChunk(uint32_t* packed, uint32_t max_count) {
+            uint32_t count = std::min(max_count, num_vectors - next);
+            if (count == 0) return 0;
+            
+            if (version >= 2) {
+                size_t bytes = static_cast<size_t>(count) * words_per_vector * sizeof(uint32_t);
+                if (file.read((uint8_t*)packed, bytes) != bytes) return 0;
+                crc = sdmCrc32(crc, packed, bytes);
+            } else {
+                std::vector<uint8_t> bits(vector_dim);
+                for (uint32_t v = 0; v < count; v++) {
+                    if (file.read(bits.data(), vector_dim) != vector_dim) return v;
+                    SDMKernels::pack(bits.data(), vector_dim, packed + static_cast<size_t>(v) * words_per_vector);
+                }
+            }
+            next += count;
+            return count;
+        }
+        
+        // Stable id of the library contents: the v2 checksum, or count and size for v1
+        uint32_t identity() const {
+            if (version >= 2) return vectors_crc;
+            uint32_t fingerprint[2] = {num_vectors, static_cast<uint32_t>(file.size())};
+            return sdmCrc32(0, fingerprint, sizeof(fingerprint));
+        }
+        
+        // After the last chunk: v2 vectors matched their checksum (v1 has none)
+        bool verified() const { return version < 2 || (next == num_vectors && crc == vectors_crc); }
+        
+        // Label of vector `index` via the v2 label index; false when absent.
+        // The streaming position is restored afterwards.
+        bool readLabel(uint32_t index, String& label) {
+            if (version < 2 || labels_offset == 0 || index >= num_vectors) return false;
+            
+            size_t resume = file.position();
+            uint32_t span[2];
+            bool found = file.seek(labels_offset + index * sizeof(uint32_t)) &&
+                         file.read((uint8_t*)span, sizeof(span)) == sizeof(span) && span[1] >= span[0];
+            if (found) {
+                uint32_t text_offset = labels_offset + (num_vectors + 1) * sizeof(uint32_t);
+                std::vector<char> text(span[1] - span[0] + 1, 0);
+                found = file.seek(text_offset + span[0]) &&
+                        file.read((uint8_t*)text.data(), span[1] - span[0]) == span[1] - span[0];
+                if (found) label = String(text.data());
+            }
+            file.seek(resume);
+            return found;
+        }
+        
+        // The whole v2 label index and text in two reads; false when absent.
+        // The streaming position is restored afterwards.
+        bool readLabels(InternalVector<uint32_t>& offsets, InternalVector<char>& text) {
+            if (version < 2 || labels_offset == 0) return false;
+            
+            size_t resume = file.position();
+            offsets.resize(num_vectors + 1);
+            size_t index_bytes = offsets.size() * sizeof(uint32_t);
+            bool found = file.seek(labels_offset) &&
+                         file.read((uint8_t*)offsets.data(), index_bytes) == index_bytes;
+            if (found) {
+                text.resize(offsets[num_vectors]);
+                found = file.read((uint8_t*)text.data(), text.size()) == text.size();
+            }
+            file.seek(resume);
+            return found;
+        }
+        
+        void close() { file.close(); }
+        
+    private:
+        File file;
+        uint32_t labels_offset = 0;
+        uint32_t vectors_crc = 0;
+        uint32_t crc = 0;
+        uint32_t next = 0;
+    };
+    
     bool savePretrainedVectors(const String& lib_name, 
                                const std::vector<std::vector<uint8_t>>& vectors,
                                const std::vector<String>& labels = {}) {
+        uint16_t vector_dim = vectors.empty() ? sdm->config.vector_dim : vectors[0].size();
+        uint16_t words = SDMKernels::wordsForDim(vector_dim);
+        std::vector<uint32_t> packed(vectors.size() * words);
+        for (size_t v = 0; v < vectors.size(); v++) {
+            SDMKernels::pack(vectors[v].data(), vector_dim, &packed[v * words]);
+        }
+        return savePackedVectors(lib_name, packed.data(), vectors.size(), vector_dim, labels);
+    }
+    
+    // Write a v2 library from count packed vectors stored back to back
+    bool savePackedVectors(const String& lib_name, const uint32_t* packed, uint32_t count,
+                           uint16_t vector_dim, const std::vector<String>& labels = {}) {
         String lib_path = lib_base_path + lib_name + "/";
         
         // Create library directory
@@ -40,22 +167,42 @@ public:
             return false;
         }
         
-        // Write header
-        uint32_t num_vectors = vectors.size();
-        uint32_t vector_dim = vectors.empty() ? 0 : vectors[0].size();
-        file.write((uint8_t*)&num_vectors, sizeof(num_vectors));
-        file.write((uint8_t*)&vector_dim, sizeof(vector_dim));
-        
-        // Write vectors
-        for (const auto& vector : vectors) {
-            for (uint8_t bit : vector) {
-                file.write(&bit, 1);
+        uint16_t words = SDMKernels::wordsForDim(vector_dim);
+        size_t vector_bytes = static_cast<size_t>(count) * words * sizeof(uint32_t);
+        bool has_labels = !labels.empty();
+        
+        SDMLibraryHeader header;
+        header.num_vectors = count;
+        header.vector_dim = vector_dim;
+        header.words_per_vector = words;
+        header.labels_offset = has_labels ? sizeof(header) + vector_bytes : 0;
+        header.vectors_crc = sdmCrc32(0, packed, vector_bytes);
+        sdmSealLibraryHeader(header);
+        
+        bool written = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                       file.write((const uint8_t*)packed, vector_bytes) == vector_bytes;
+        
+        // Label index (one offset per vector plus the end), then the label text
+        if (written && has_labels) {
+            uint32_t offset = 0;
+            for (uint32_t v = 0; v <= count && written; v++) {
+                written = file.write((const uint8_t*)&offset, sizeof(offset)) == sizeof(offset);
+                if (v < count && v < labels.size()) offset += labels[v].length();
+            }
+            for (uint32_t v = 0; v < count && v < labels.size() && written; v++) {
+                written = file.write((const uint8_t*)labels[v].c_str(), labels[v].length()) == labels[v].length();
             }
         }
+        uint32_t file_size = file.size();
         file.close();
+        if (!written) {
+            Serial.println("Failed to write vectors file");
+            SD.remove(vectors_file);
+            return false;
+        }
         
         // Save labels if provided
-        if (!labels.empty()) {
+        if (has_labels) {
             String labels_file = lib_path + "labels.txt";
             File labelFile = SD.open(labels_file, FILE_WRITE);
             if (labelFile) {
@@ -67,56 +214,80 @@ public:
         }
         
         // Save library metadata
-        saveLibraryMetadata(lib_name, num_vectors, file.size());
+        saveLibraryMetadata(lib_name, count, file_size);
         
-        Serial.printf("Saved %d vectors to library '%s'\n", num_vectors, lib_name.c_str());
+        Serial.printf("Saved %u vectors to library '%s'\n", (unsigned)count, lib_name.c_str());
         return true;
     }
     
-    bool loadPretrainedVectors(const String& lib_name,
-                               std::vector<std::vector<uint8_t>>& vectors,
-                               std::vector<String>& labels) {
-        String lib_path = lib_base_path + lib_name + "/";
-        String vectors_file = lib_path + "vectors.bin";
+    // labels.txt (one label per line) in the packed form of LibraryReader::readLabels
+    bool readLabelsFile(const String& lib_name, InternalVector<uint32_t>& offsets, InternalVector<char>& text) {
+        File file = SD.open(lib_base_path + lib_name + "/labels.txt");
+        if (!file) return false;
+        
+        offsets.assign(1, 0);
+        text.clear();
+        while (file.available() > 0) {
+            String line = file.readStringUntil('\n');
+            line.trim();
+            if (line.length() == 0) continue;
+            text.insert(text.end(), line.c_str(), line.c_str() + line.length());
+            offsets.push_back(text.size());
+        }
+        file.close();
+        return true;
+    }
+    
+    bool openLibrary(const String& lib_name, LibraryReader& reader) {
+        String vectors_file = lib_base_path + lib_name + "/vectors.bin";
         
         if (!SD.exists(vectors_file)) {
             Serial.println("Library not found: " + lib_name);
             return false;
         }
-        
-        File file = SD.open(vectors_file);
-        if (!file) {
+        if (!reader.open(vectors_file)) {
             Serial.println("Failed to open vectors file");
+            reader.close();
             return false;
         }
         
-        // Read header
-        uint32_t num_vectors, vector_dim;
-        file.read((uint8_t*)&num_vectors, sizeof(num_vectors));
-        file.read((uint8_t*)&vector_dim, sizeof(vector_dim));
-        
         // Validate dimensions
-        if (vector_dim != sdm->config.vector_dim) {
-            Serial.printf("Dimension mismatch: lib=%d, sdm=%d\n", vector_dim, sdm->config.vector_dim);
-            file.close();
+        if (reader.vector_dim != sdm->config.vector_dim) {
+            Serial.printf("Dimension mismatch: lib=%d, sdm=%d\n", reader.vector_dim, sdm->config.vector_dim);
+            reader.close();
+            return false;
+        }
+        return true;
+    }
+    
+    // Materializes the whole library; prefer mergeLibraryIntoSDM / LibraryReader for large ones
+    bool loadPretrainedVectors(const String& lib_name,
+                               std::vector<std::vector<uint8_t>>& vectors,
+                               std::vector<String>& labels) {
+        LibraryReader reader;
+        if (!openLibrary(lib_name, reader)) {
             return false;
         }
         
         // Read vectors
         vectors.clear();
-        vectors.reserve(num_vectors);
+        vectors.reserve(reader.num_vectors);
         
-        for (uint32_t i = 0; i < num_vectors; i++) {
-            std::vector<uint8_t> vector(vector_dim);
-            for (uint32_t j = 0; j < vector_dim; j++) {
-                file.read(&vector[j], 1);
-            }
+        std::vector<uint32_t> packed(reader.words_per_vector);
+        while (reader.readChunk(packed.data(), 1) == 1) {
+            std::vector<uint8_t> vector(reader.vector_dim);
+            SDMKernels::unpack(packed.data(), reader.vector_dim, vector.data());
             vectors.push_back(vector);
         }
-        file.close();
+        bool verified = vectors.size() == reader.num_vectors && reader.verified();
+        reader.close();
+        if (!verified) {
+            Serial.println("Library vectors are truncated or corrupt: " + lib_name);
+            return false;
+        }
         
         // Load labels if available
-        String labels_file = lib_path + "labels.txt";
+        String labels_file = lib_base_path + lib_name + "/labels.txt";
         labels.clear();
         if (SD.exists(labels_file)) {
             File labelFile = SD.open(labels_file);
@@ -132,30 +303,122 @@ public:
             }
         }
         
-        Serial.printf("Loaded %d vectors from library '%s'\n", vectors.size(), lib_name.c_str());
+        Serial.printf("Loaded %u vectors from library '%s'\n", (unsigned)vectors.size(), lib_name.c_str());
         return true;
     }
     
     bool mergeLibraryIntoSDM(const String& lib_name, uint8_t reinforcement = 3) {
-        std::vector<std::vector<uint8_t>> vectors;
-        std::vector<String> labels;
-        
-        if (!loadPretrainedVectors(lib_name, vectors, labels)) {
+        LibraryReader reader;
+        if (!openLibrary(lib_name, reader)) {
             return false;
         }
         
-        Serial.printf("Merging %d vectors into SDM...\n", vectors.size());
+        Serial.printf("Merging %u vectors into SDM...\n", (unsigned)reader.num_vectors);
+        
+        // Stream block-sized chunks of packed vectors into the batch API; memory
+        // use is one SD block whatever the library size
+        uint16_t words = reader.words_per_vector;
+        uint32_t chunk_vectors = std::max<uint32_t>(SDM_BATCH_MAX, SDM_IMAGE_BLOCK / (words * sizeof(uint32_t)));
+        std::vector<uint32_t> chunk(static_cast<size_t>(chunk_vectors) * words);
+        uint32_t merged = 0;
         
-        for (const auto& vector : vectors) {
+        while (uint32_t count = reader.readChunk(chunk.data(), chunk_vectors)) {
             for (uint8_t i = 0; i < reinforcement; i++) {
-                sdm->write(vector, 2); // Medium strength reinforcement
+                sdm->writeBatch(chunk.data(), count, 2); // Medium strength reinforcement
             }
+            merged += count;
         }
+        bool verified = merged == reader.num_vectors && reader.verified();
+        reader.close();
         
+        if (!verified) {
+            Serial.printf("Library '%s' is truncated or corrupt; merged %u of %u vectors\n",
+                          lib_name.c_str(), (unsigned)merged, (unsigned)reader.num_vectors);
+            return false;
+        }
         Serial.println("Library merged successfully");
         return true;
     }
     
+    // Snapshot of the counters a library produces when merged into an empty
+    // memory. Merging is deterministic given the config and seed, so the file
+    // name carries a key over everything that shapes the result.
+    String snapshotPath(const String& lib_name, const LibraryReader& reader, uint8_t reinforcement) {
+        const SDMConfig& cfg = sdm->config;
+        uint32_t key_fields[] = {
+            cfg.seed, cfg.num_locations, cfg.vector_dim, cfg.access_radius, 0, cfg.counter_bits,
+            reinforcement, reader.identity(), cfg.target_activations, sdm->addressMapCrc(),
+        };
+        memcpy(&key_fields[4], &cfg.sparsity, sizeof(float));
+        char name[32];
+        snprintf(name, sizeof(name), "snapshot_%08x.bin", (unsigned)sdmCrc32(0, key_fields, sizeof(key_fields)));
+        return lib_base_path + lib_name + "/" + name;
+    }
+    
+    // Merge the library once into a scratch memory with the same config and save its image
+    bool buildLibrarySnapshot(const String& lib_name, const String& snapshot_file, uint8_t reinforcement) {
+        SDMConfig scratch_config = sdm->config;
+        scratch_config.persistent = false;
+        scratch_config.cache_pages = 0;
+        if (!SparseDistributedMemory::fitsInMemory(scratch_config, 65536)) {
+            Serial.println("Not enough memory to build a library snapshot");
+            return false;
+        }
+        
+        SparseDistributedMemory scratch(scratch_config);
+        if (!scratch.initialize()) {
+            return false;
+        }
+        // Not persistent, so it starts from seed-derived addresses; the rows
+        // have to line up with the ones they are stacked onto
+        if (!scratch.copyAddressMap(*sdm)) {
+            Serial.println("Could not match the memory's relocated addresses");
+            return false;
+        }
+        SDMPretrainedLib scratch_lib(&scratch);
+        if (!scratch_lib.mergeLibraryIntoSDM(lib_name, reinforcement)) {
+            return false;
+        }
+        
+        String temp_file = snapshot_file + ".tmp";
+        if (!scratch.exportImage(temp_file)) {
+            return false;
+        }
+        if (SD.exists(snapshot_file)) {
+            SD.remove(snapshot_file);
+        }
+        return SD.rename(temp_file, snapshot_file);
+    }
+    
+    // Add a library's counters in one sequential read instead of replaying its
+    // writes, building the snapshot on first use. Returns false when no snapshot
+    // can be used and the caller should merge by replay, unless partial is set:
+    // then part of it was already added and a replay would apply it twice.
+    bool stackLibrarySnapshot(const String& lib_name, uint8_t reinforcement = 3, bool* partial = nullptr) {
+        if (partial) *partial = false;
+        LibraryReader reader;
+        if (!openLibrary(lib_name, reader)) {
+            return false;
+        }
+        String snapshot_file = snapshotPath(lib_name, reader, reinforcement);
+        reader.close();
+        
+        if (!SD.exists(snapshot_file)) {
+            Serial.printf("Building snapshot for library '%s'...\n", lib_name.c_str());
+            if (!buildLibrarySnapshot(lib_name, snapshot_file, reinforcement)) {
+                return false;
+            }
+        }
+        
+        if (!sdm->stackImage(snapshot_file, partial)) {
+            // Rebuilt on the next load
+            SD.remove(snapshot_file);
+            return false;
+        }
+        Serial.printf("Stacked snapshot of library '%s'\n", lib_name.c_str());
+        return true;
+    }
+    
     std::vector<String> listAvailableLibraries() {
         std::vector<String> libraries;
         
@@ -192,31 +455,30 @@ public:
             "NOW", "FIND", "LONG", "DOWN", "DAY", "DID", "GET", "COME", "MADE", "MAY", "PART"
         };
         
-        std::vector<std::vector<uint8_t>> vectors;
+        uint16_t words = sdm->wordsPerVector();
+        std::vector<uint32_t> packed(common_words.size() * words);
         SDMEncoder encoder(sdm);
         
-        for (const String& word : common_words) {
-            auto encoded = encoder.encodeText(word);
-            vectors.push_back(encoded);
+        for (size_t i = 0; i < common_words.size(); i++) {
+            encoder.encodeText(common_words[i], &packed[i * words]);
         }
         
-        return savePretrainedVectors("common_words", vectors, common_words);
+        return savePackedVectors("common_words", packed.data(), common_words.size(), sdm->config.vector_dim, common_words);
     }
     
     bool createNumbersLibrary() {
         // Create a library for numbers 0-100
         std::vector<String> numbers;
-        std::vector<std::vector<uint8_t>> vectors;
+        uint16_t words = sdm->wordsPerVector();
+        std::vector<uint32_t> packed(101 * words);
         SDMEncoder encoder(sdm);
         
         for (int i = 0; i <= 100; i++) {
-            String num_str = String(i);
-            numbers.push_back(num_str);
-            auto encoded = encoder.encodeText(num_str);
-            vectors.push_back(encoded);
+            numbers.push_back(String(i));
+            encoder.encodeText(numbers.back(), &packed[i * words]);
         }
         
-        return savePretrainedVectors("numbers", vectors, numbers);
+        return savePackedVectors("numbers", packed.data(), numbers.size(), sdm->config.vector_dim, numbers);
     }
     
     void printLibraryInfo(const String& lib_name) {
@@ -248,21 +510,22 @@ private:
         doc["file_size"] = file_size;
         doc["vector_dim"] = sdm->config.vector_dim;
         doc["creation_time"] = millis();
-        doc["version"] = "1.0";
+        doc["version"] = "2.0";
         
-        File file = SD.open(info_file, FILE_WRITE);
-        if (!file) return false;
-        
-        serializeJson(doc, file);
-        file.close();
-        return true;
+        String text;
+        serializeJson(doc, text);
+        return sdmWriter().write(info_file, text.c_str(), text.length(), SDM_WRITE_REPLACE) != 0;
     }
 };
 
 // Add library management to SDM class
 bool SparseDistributedMemory::loadPretrainedLib(const String& lib_name) {
     SDMPretrainedLib prelib(this);
-    return prelib.mergeLibraryIntoSDM(lib_name);
+    bool partial = false;
+    if (prelib.stackLibrarySnapshot(lib_name, 3, &partial)) {
+        return true;
+    }
+    return !partial && prelib.mergeLibraryIntoSDM(lib_name);
 }
 
 bool SparseDistributedMemory::savePretrainedLib(const String& lib_name) {
@@ -271,25 +534,70 @@ bool SparseDistributedMemory::savePretrainedLib(const String& lib_name) {
     // the most frequently accessed patterns
     
     SDMPretrainedLib prelib(this);
-    std::vector<std::vector<uint8_t>> vectors;
+    std::vector<uint32_t> patterns;
     std::vector<String> labels;
     
     // Find most accessed memory locations and extract their patterns
     for (uint16_t i = 0; i < config.num_locations; i++) {
         if (access_counts[i] > 5) { // Only save frequently accessed patterns
-            std::vector<uint8_t> pattern(config.vector_dim);
+            size_t first = patterns.size();
+            patterns.resize(first + words_per_vector, 0);
+            const uint8_t* row = counterRow(i);
             for (uint16_t j = 0; j < config.vector_dim; j++) {
-                pattern[j] = (memory[i][j] > 0) ? 1 : 0;
+                if (SDMKernels::counterLane(row, config.counter_bits, j) > 0) SDMKernels::setBit(&patterns[first], j);
             }
-            vectors.push_back(pattern);
             labels.push_back("pattern_" + String(i) + "_access_" + String(access_counts[i]));
         }
     }
     
-    return prelib.savePretrainedVectors(lib_name, vectors, labels);
+    return prelib.savePackedVectors(lib_name, patterns.data(), labels.size(), config.vector_dim, labels);
 }
 
 std::vector<String> SparseDistributedMemory::listPretrainedLibs() {
     SDMPretrainedLib prelib(this);
     return prelib.listAvailableLibraries();
+}
+
+bool SDMCleanupMemory::loadLibrary(SparseDistributedMemory* sdm, const String& lib_name, bool use_index) {
+    SDMPretrainedLib prelib(sdm);
+    SDMPretrainedLib::LibraryReader reader;
+    if (!prelib.openLibrary(lib_name, reader)) {
+        return false;
+    }
+    if (reader.num_vectors > UINT16_MAX) {
+        Serial.printf("Library '%s' has too many vectors for a cleanup memory\n", lib_name.c_str());
+        reader.close();
+        return false;
+    }
+    
+    clear();
+    vector_dim = reader.vector_dim;
+    words_per_vector = reader.words_per_vector;
+    items.resize(static_cast<size_t>(reader.num_vectors) * words_per_vector);
+    
+    uint32_t loaded = 0;
+    while (loaded < reader.num_vectors) {
+        uint32_t count = reader.readChunk(&items[static_cast<size_t>(loaded) * words_per_vector],
+                                          reader.num_vectors - loaded);
+        if (count == 0) break;
+        loaded += count;
+    }
+    if (loaded != reader.num_vectors || !reader.verified()) {
+        Serial.println("Library vectors are truncated or corrupt: " + lib_name);
+        reader.close();
+        clear();
+        return false;
+    }
+    item_count = loaded;
+    
+    // v2 files index their labels; older libraries only have labels.txt
+    if (!reader.readLabels(label_index, label_chars)) {
+        prelib.readLabelsFile(lib_name, label_index, label_chars);
+    }
+    reader.close();
+    finishLoad(use_index);
+    
+    Serial.printf("Cleanup memory: %u labels from '%s' (%u bytes)\n",
+                  (unsigned)item_count, lib_name.c_str(), (unsigned)memoryBytes());
+    return true;
 }
\ No newline at end of file
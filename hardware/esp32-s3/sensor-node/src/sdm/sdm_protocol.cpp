@@ -0,0 +1,288 @@
+#include "sdm_protocol.h"
+#include "sdm.h"
+
+SDMProtocol::Event SDMProtocol::poll() {
+    while (port.available() > 0) {
+        // The timeout is for a stalled frame, so it runs from the last byte
+        last_byte_ms = millis();
+        if (state == STATE_PAYLOAD) {
+            // Payload bytes in bulk; never more than has arrived
+            size_t want = std::min<size_t>(payload.size() - got, port.available());
+            got += port.readBytes(reinterpret_cast<char*>(payload.data()) + got, want);
+            if (got == payload.size()) {
+                state = STATE_CRC;
+                got = 0;
+            }
+            continue;
+        }
+        
+        int c = port.read();
+        if (c < 0) break;
+        
+        switch (state) {
+            case STATE_LINE:
+                if (c == SDM_FRAME_SYNC0 && line_buffer.isEmpty()) {
+                    state = STATE_SYNC;
+                } else if (c == '\n' || c == '\r') {
+                    bool complete = !line_buffer.isEmpty() && !line_overflow;
+                    if (complete) ready_line = line_buffer;
+                    line_buffer = "";
+                    line_overflow = false;
+                    if (complete) return EVENT_LINE;
+                } else if (line_buffer.length() < SDM_LINE_MAX) {
+                    line_buffer += static_cast<char>(c);
+                } else {
+                    line_overflow = true;
+                }
+                break;
+            
+            case STATE_SYNC:
+                state = c == SDM_FRAME_SYNC1 ? STATE_HEADER : STATE_LINE;
+                got = 0;
+                break;
+            
+            case STATE_HEADER:
+                header[got++] = static_cast<uint8_t>(c);
+                if (got == sizeof(header)) {
+                    uint16_t length = header[4] | (header[5] << 8);
+                    if (length > SDM_FRAME_MAX_PAYLOAD) {
+                        // Can't hold it; skip the payload and CRC rather than parse them as text
+                        sendStatus(SDM_FRAME_NAK, header[2] | (header[3] << 8), SDM_STATUS_TOO_LARGE);
+                        state = STATE_DISCARD;
+                        discard = static_cast<uint32_t>(length) + sizeof(crc_bytes);
+                        break;
+                    }
+                    payload.resize(length);
+                    state = length ? STATE_PAYLOAD : STATE_CRC;
+                    got = 0;
+                }
+                break;
+            
+            case STATE_CRC:
+                crc_bytes[got++] = static_cast<uint8_t>(c);
+                if (got == sizeof(crc_bytes)) {
+                    state = STATE_LINE;
+                    if (finishFrame()) return EVENT_FRAME;
+                }
+                break;
+            
+            case STATE_DISCARD:
+                if (--discard == 0) state = STATE_LINE;
+                break;
+            
+            default:
+                break;
+        }
+    }
+    
+    if (state != STATE_LINE && millis() - last_byte_ms > SDM_FRAME_TIMEOUT_MS) {
+        state = STATE_LINE;
+    }
+    return EVENT_NONE;
+}
+
+bool SDMProtocol::finishFrame() {
+    uint32_t expected = crc_bytes[0] | (crc_bytes[1] << 8) | (crc_bytes[2] << 16) |
+                        (static_cast<uint32_t>(crc_bytes[3]) << 24);
+    uint32_t crc = sdmCrc32(sdmCrc32(0, header, sizeof(header)), payload.data(), payload.size());
+    uint16_t sequence = header[2] | (header[3] << 8);
+    if (crc != expected) {
+        sendStatus(SDM_FRAME_NAK, sequence, SDM_STATUS_BAD_CRC);
+        return false;
+    }
+    
+    ready_frame.type = header[0];
+    ready_frame.sequence = sequence;
+    ready_frame.payload = payload.data();
+    ready_frame.length = static_cast<uint16_t>(payload.size());
+    return true;
+}
+
+void SDMProtocol::sendStatus(uint8_t type, uint16_t sequence, SDMFrameStatus status, uint32_t value) {
+    std::vector<uint8_t> reply;
+    sdmStatusFrame(reply, type, sequence, status, value);
+    send(reply);
+}
+
+static void appendLE(std::vector<uint8_t>& out, uint32_t value, uint8_t bytes) {
+    for (uint8_t i = 0; i < bytes; i++) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void sdmBeginFrame(std::vector<uint8_t>& out, uint8_t type, uint16_t sequence) {
+    out.clear();
+    out.push_back(SDM_FRAME_SYNC0);
+    out.push_back(SDM_FRAME_SYNC1);
+    out.push_back(type);
+    out.push_back(0);
+    appendLE(out, sequence, 2);
+    appendLE(out, 0, 2);  // Length, set by sdmEndFrame()
+}
+
+void sdmEndFrame(std::vector<uint8_t>& out) {
+    uint16_t length = static_cast<uint16_t>(out.size() - SDM_FRAME_HEADER);
+    out[6] = static_cast<uint8_t>(length);
+    out[7] = static_cast<uint8_t>(length >> 8);
+    appendLE(out, sdmCrc32(0, out.data() + 2, out.size() - 2), 4);
+}
+
+void sdmStatusFrame(std::vector<uint8_t>& out, uint8_t type, uint16_t sequence, SDMFrameStatus status, uint32_t value) {
+    sdmBeginFrame(out, type == SDM_FRAME_NAK ? SDM_FRAME_NAK : type | SDM_FRAME_REPLY, sequence);
+    appendLE(out, status, 2);
+    appendLE(out, 0, 2);
+    appendLE(out, value, 4);
+    sdmEndFrame(out);
+}
+
+SDMFrameStatus sdmDecodeFrame(const uint8_t* data, size_t length, SDMFrame& frame) {
+    if (length < SDM_FRAME_HEADER + 4 || data[0] != SDM_FRAME_SYNC0 || data[1] != SDM_FRAME_SYNC1) {
+        return SDM_STATUS_BAD_REQUEST;
+    }
+    uint16_t payload_length = data[6] | (data[7] << 8);
+    if (SDM_FRAME_HEADER + payload_length + 4u != length) return SDM_STATUS_TOO_LARGE;
+    
+    const uint8_t* tail = data + length - 4;
+    uint32_t expected = tail[0] | (tail[1] << 8) | (tail[2] << 16) | (static_cast<uint32_t>(tail[3]) << 24);
+    if (sdmCrc32(0, data + 2, length - 6) != expected) return SDM_STATUS_BAD_CRC;
+    
+    frame.type = data[2];
+    frame.sequence = data[4] | (data[5] << 8);
+    frame.payload = data + SDM_FRAME_HEADER;
+    frame.length = payload_length;
+    return SDM_STATUS_OK;
+}
+
+bool sdmServeFrame(SparseDistributedMemory& sdm, const SDMFrame& request, uint16_t max_payload,
+                   std::vector<uint8_t>& reply) {
+    const uint8_t* p = request.payload;
+    uint16_t words = sdm.wordsPerVector();
+    size_t vector_bytes = words * sizeof(uint32_t);
+    
+    switch (request.type) {
+        case SDM_FRAME_INFO:
+            sdmBeginFrame(reply, request.type | SDM_FRAME_REPLY, request.sequence);
+            appendLE(reply, sdm.config.vector_dim, 2);
+            appendLE(reply, sdm.config.num_locations, 2);
+            appendLE(reply, words, 2);
+            appendLE(reply, max_payload, 2);
+            reply.push_back(sdm.config.counter_bits);
+            reply.push_back(SDM_BATCH_MAX);
+            appendLE(reply, 0, 2);
+            sdmEndFrame(reply);
+            return true;
+        
+        case SDM_FRAME_WRITE: {
+            uint16_t count = request.length >= 4 ? p[2] | (p[3] << 8) : 0;
+            if (count == 0 || request.length != 4 + count * vector_bytes) {
+                sdmStatusFrame(reply, request.type, request.sequence, SDM_STATUS_BAD_REQUEST);
+                return true;
+            }
+            uint32_t activated = sdm.writeBatch(reinterpret_cast<const uint32_t*>(p + 4), count, p[0] ? p[0] : 1);
+            sdmStatusFrame(reply, request.type, request.sequence, SDM_STATUS_OK, activated);
+            return true;
+        }
+        
+        case SDM_FRAME_READ: {
+            uint16_t count = request.length >= 4 ? p[0] | (p[1] << 8) : 0;
+            size_t reply_bytes = 4 + count * (vector_bytes + sizeof(float));
+            if (count == 0 || request.length != 4 + count * vector_bytes || reply_bytes > max_payload) {
+                sdmStatusFrame(reply, request.type, request.sequence, SDM_STATUS_BAD_REQUEST);
+                return true;
+            }
+            // Outputs and confidences go straight into the reply buffer
+            sdmBeginFrame(reply, request.type | SDM_FRAME_REPLY, request.sequence);
+            appendLE(reply, count, 2);
+            appendLE(reply, 0, 2);
+            size_t outputs_at = reply.size();
+            reply.resize(outputs_at + reply_bytes - 4);
+            uint32_t* outputs = reinterpret_cast<uint32_t*>(reply.data() + outputs_at);
+            float* confidences = reinterpret_cast<float*>(reply.data() + outputs_at + count * vector_bytes);
+            sdm.readBatch(reinterpret_cast<const uint32_t*>(p + 4), count, outputs, confidences);
+            sdmEndFrame(reply);
+            return true;
+        }
+        
+        default:
+            return false;
+    }
+}
+
+bool SDMLibraryUpload::begin(const String& lib_name, uint32_t file_bytes) {
+    abort();
+    // The name becomes a directory; keep it to one path component
+    if (lib_name.isEmpty() || lib_name.indexOf('/') >= 0 || lib_name.indexOf("..") >= 0 ||
+        file_bytes < sizeof(SDMLibraryHeader)) {
+        return false;
+    }
+    
+    name = lib_name;
+    if (!SD.exists("/lib")) SD.mkdir("/lib");
+    if (!SD.exists(libraryPath())) SD.mkdir(libraryPath());
+    
+    String temp_file = libraryPath() + "vectors.tmp";
+    if (SD.exists(temp_file)) SD.remove(temp_file);
+    file = SD.open(temp_file, FILE_WRITE);
+    if (!file) return false;
+    
+    file_active = true;
+    total_bytes = file_bytes;
+    received_bytes = 0;
+    last_offset = 0;
+    return true;
+}
+
+bool SDMLibraryUpload::append(uint32_t offset, const uint8_t* data, uint16_t length) {
+    if (!file_active) return false;
+    if (offset == last_offset && offset + length == received_bytes) return true;
+    if (offset != received_bytes || received_bytes + length > total_bytes) return false;
+    
+    if (file.write(data, length) != length) return false;
+    last_offset = offset;
+    received_bytes += length;
+    return true;
+}
+
+uint32_t SDMLibraryUpload::commit(uint16_t vector_dim) {
+    if (!file_active || received_bytes != total_bytes) return 0;
+    file.close();
+    file_active = false;
+    
+    String temp_file = libraryPath() + "vectors.tmp";
+    File check = SD.open(temp_file);
+    SDMLibraryHeader header;
+    bool valid = check && check.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+                 sdmLibraryHeaderValid(header) && header.num_vectors > 0 && header.vector_dim == vector_dim &&
+                 header.words_per_vector == SDMKernels::wordsForDim(vector_dim);
+    
+    // Header fields are trusted only after the CRC over the vectors they describe
+    uint64_t vector_bytes = valid ? static_cast<uint64_t>(header.num_vectors) * header.words_per_vector * sizeof(uint32_t) : 0;
+    valid = valid && sizeof(header) + vector_bytes <= total_bytes &&
+            (header.labels_offset == 0 || header.labels_offset == sizeof(header) + vector_bytes);
+    uint32_t crc = 0;
+    uint8_t block[512];
+    for (uint64_t left = vector_bytes; valid && left > 0;) {
+        size_t chunk = std::min<uint64_t>(left, sizeof(block));
+        valid = check.read(block, chunk) == chunk;
+        crc = sdmCrc32(crc, block, chunk);
+        left -= chunk;
+    }
+    valid = valid && crc == header.vectors_crc;
+    if (check) check.close();
+    
+    String vectors_file = libraryPath() + "vectors.bin";
+    if (!valid) {
+        SD.remove(temp_file);
+        return 0;
+    }
+    // labels.txt belongs to the library being replaced; v2 files carry their own labels
+    if (SD.exists(libraryPath() + "labels.txt")) SD.remove(libraryPath() + "labels.txt");
+    if (SD.exists(vectors_file)) SD.remove(vectors_file);
+    if (!SD.rename(temp_file, vectors_file)) return 0;
+    return header.num_vectors;
+}
+
+void SDMLibraryUpload::abort() {
+    if (!file_active) return;
+    file.close();
+    file_active = false;
+    SD.remove(libraryPath() + "vectors.tmp");
+}
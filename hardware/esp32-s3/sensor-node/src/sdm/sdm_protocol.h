@@ -0,0 +1,142 @@
+#ifndef SDM_PROTOCOL_H
+#define SDM_PROTOCOL_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+
+// Serial link shared by text commands and binary frames. Text is read a line
+// at a time ('\n' or '\r' terminated). A frame starts with the two sync bytes,
+// which no text command contains:
+//   uint8  sync[2]   SDM_FRAME_SYNC0 SDM_FRAME_SYNC1
+//   uint8  type      SDMFrameType; replies set SDM_FRAME_REPLY
+//   uint8  flags     0
+//   uint16 sequence  echoed in the reply
+//   uint16 length    payload bytes, at most SDM_FRAME_MAX_PAYLOAD
+//   payload
+//   uint32 crc       CRC32 (sdmCrc32) from type to the end of the payload
+// All fields are little-endian. A frame that stalls for SDM_FRAME_TIMEOUT_MS
+// between two bytes is dropped and the link goes back to reading text. The
+// whole frame may take longer: one with a full SDM_FRAME_MAX_PAYLOAD takes
+// about 0.71 s at 115200 baud.
+#define SDM_FRAME_SYNC0 0xA5
+#define SDM_FRAME_SYNC1 0x5A
+#define SDM_FRAME_HEADER 8
+#define SDM_FRAME_MAX_PAYLOAD 8192
+#define SDM_FRAME_TIMEOUT_MS 500
+#define SDM_FRAME_REPLY 0x80
+// Longest text command; longer lines are discarded
+#define SDM_LINE_MAX 512
+
+// Request payloads (replies in brackets; SDMFrameStatus replies carry
+// uint16 status, uint16 reserved, uint32 value):
+enum SDMFrameType : uint8_t {
+    SDM_FRAME_INFO = 0x01,       // empty [uint16 vector_dim, num_locations, words_per_vector, max_payload,
+                                 //        uint8 counter_bits, uint8 batch_max, uint16 reserved]
+    SDM_FRAME_WRITE = 0x02,      // uint8 strength, uint8 reserved, uint16 count, count packed vectors
+                                 // [status, value = activated locations]
+    SDM_FRAME_READ = 0x03,       // uint16 count, uint16 reserved, count packed vectors
+                                 // [uint16 count, uint16 reserved, count packed vectors, count float32 confidences]
+    SDM_FRAME_LIB_BEGIN = 0x10,  // uint32 file bytes, library name [status]
+    SDM_FRAME_LIB_DATA = 0x11,   // uint32 offset, bytes of vectors.bin [status, value = bytes received]
+    SDM_FRAME_LIB_END = 0x12,    // empty; verify and install the library [status, value = vector count]
+    SDM_FRAME_NAK = 0x7F,        // Reply only: a frame failed its CRC or length check [status]
+};
+
+enum SDMFrameStatus : uint16_t {
+    SDM_STATUS_OK = 0,
+    SDM_STATUS_BAD_CRC = 1,
+    SDM_STATUS_TOO_LARGE = 2,
+    SDM_STATUS_BAD_REQUEST = 3,   // Unknown type, short payload or a vector count that doesn't match
+    SDM_STATUS_NOT_READY = 4,     // No SDM initialized
+    SDM_STATUS_IO_ERROR = 5,
+    SDM_STATUS_BAD_LIBRARY = 6,   // Upload did not verify as a library for this vector_dim
+    SDM_STATUS_BUSY = 7,          // Request queue full; retry
+};
+
+struct SDMFrame {
+    uint8_t type = 0;
+    uint16_t sequence = 0;
+    const uint8_t* payload = nullptr;  // Valid until the next poll()
+    uint16_t length = 0;
+};
+
+class SDMProtocol {
+public:
+    enum Event : uint8_t { EVENT_NONE, EVENT_LINE, EVENT_FRAME };
+
+    explicit SDMProtocol(Stream& port) : port(port) {}
+
+    // Consume what has arrived without waiting; returns at the first complete
+    // line or frame. Frames that fail their checks are NAKed here.
+    Event poll();
+    const String& line() const { return ready_line; }
+    const SDMFrame& frame() const { return ready_frame; }
+
+    // Whole frames built with the sdm*Frame helpers below
+    void send(const std::vector<uint8_t>& frame) { port.write(frame.data(), frame.size()); }
+    void sendStatus(uint8_t type, uint16_t sequence, SDMFrameStatus status, uint32_t value = 0);
+
+private:
+    enum State : uint8_t { STATE_LINE, STATE_SYNC, STATE_HEADER, STATE_PAYLOAD, STATE_CRC, STATE_DISCARD };
+
+    Stream& port;
+    State state = STATE_LINE;
+    String line_buffer;
+    bool line_overflow = false;
+    String ready_line;
+
+    uint8_t header[SDM_FRAME_HEADER - 2];  // After the sync bytes
+    uint8_t crc_bytes[4];
+    uint16_t got = 0;
+    uint32_t discard = 0;  // Bytes left of a frame too large to hold
+    std::vector<uint8_t> payload;
+    SDMFrame ready_frame;
+    uint32_t last_byte_ms = 0;
+
+    bool finishFrame();
+};
+
+class SparseDistributedMemory;
+
+// Frames in memory, for datagram transports (one frame per packet) and replies.
+// sdmBeginFrame() starts out with a header; append the payload, then
+// sdmEndFrame() fills in the length and appends the CRC.
+void sdmBeginFrame(std::vector<uint8_t>& out, uint8_t type, uint16_t sequence);
+void sdmEndFrame(std::vector<uint8_t>& out);
+void sdmStatusFrame(std::vector<uint8_t>& out, uint8_t type, uint16_t sequence, SDMFrameStatus status, uint32_t value = 0);
+// Check one complete frame; frame.payload points into data
+SDMFrameStatus sdmDecodeFrame(const uint8_t* data, size_t length, SDMFrame& frame);
+// Run an INFO, WRITE or READ request against sdm and build its reply; false
+// for other types. The payload must be 4-byte aligned (vectors are read in
+// place), and READ replies are refused past max_payload.
+bool sdmServeFrame(SparseDistributedMemory& sdm, const SDMFrame& request, uint16_t max_payload,
+                   std::vector<uint8_t>& reply);
+
+// Receives a library file (/lib/<name>/vectors.bin, see sdm_image.h) in
+// ordered chunks. It lands in a temporary file and replaces the library only
+// once the header and vector CRC check out.
+class SDMLibraryUpload {
+public:
+    bool begin(const String& lib_name, uint32_t file_bytes);
+    // A repeat of the last chunk (lost acknowledgement) is accepted without writing
+    bool append(uint32_t offset, const uint8_t* data, uint16_t length);
+    // Returns the number of vectors installed, 0 on failure
+    uint32_t commit(uint16_t vector_dim);
+    void abort();
+
+    bool active() const { return file_active; }
+    uint32_t received() const { return received_bytes; }
+
+private:
+    String name;
+    File file;
+    bool file_active = false;
+    uint32_t total_bytes = 0;
+    uint32_t received_bytes = 0;
+    uint32_t last_offset = 0;
+
+    String libraryPath() const { return "/lib/" + name + "/"; }
+};
+
+#endif
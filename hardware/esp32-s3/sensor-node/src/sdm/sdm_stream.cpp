@@ -0,0 +1,58 @@
+#include "sdm.h"
+
+SDMStreamEncoder::SDMStreamEncoder(SparseDistributedMemory* sdm_instance, uint16_t window_length,
+                                   uint16_t write_stride, float min_val, float max_val)
+    : sdm(sdm_instance), window_length(std::max<uint16_t>(window_length, 1)),
+      write_stride(std::max<uint16_t>(write_stride, 1)), min_val(min_val), max_val(max_val) {
+    bits_per_element = sdm->config.vector_dim / this->window_length;
+    ring.assign(SDMKernels::wordsForDim(sdm->config.vector_dim), 0);
+    window_scratch.assign(ring.size(), 0);
+}
+
+bool SDMStreamEncoder::push(float sample) {
+    // Same thermometer segment as encodeSequence
+    float normalized = (sample - min_val) / (max_val - min_val);
+    normalized = constrain(normalized, 0.0f, 1.0f);
+    uint16_t num_bits = static_cast<uint16_t>(normalized * bits_per_element);
+    
+    uint16_t start_bit = head * bits_per_element;
+    SDMKernels::clearBitRange(ring.data(), start_bit, start_bit + bits_per_element);
+    SDMKernels::setBitRange(ring.data(), start_bit, start_bit + num_bits);
+    
+    head = head + 1 == window_length ? 0 : head + 1;
+    samples++;
+    if (++since_due < write_stride) return false;
+    since_due = 0;
+    return true;
+}
+
+void SDMStreamEncoder::reset() {
+    std::fill(ring.begin(), ring.end(), 0);
+    head = 0;
+    samples = 0;
+    since_due = 0;
+}
+
+void SDMStreamEncoder::window(uint32_t* packed) const {
+    std::fill(packed, packed + ring.size(), 0);
+    
+    // Until the ring wraps, segments are already oldest first from slot 0
+    if (!full() || head == 0) {
+        std::copy(ring.begin(), ring.end(), packed);
+        return;
+    }
+    uint16_t split = head * bits_per_element;
+    uint16_t used = window_length * bits_per_element;
+    SDMKernels::copyBitRange(packed, 0, ring.data(), split, used - split);
+    SDMKernels::copyBitRange(packed, used - split, ring.data(), 0, split);
+}
+
+uint16_t SDMStreamEncoder::writeWindow(uint8_t strength) {
+    window(window_scratch.data());
+    return sdm->write(window_scratch.data(), strength);
+}
+
+float SDMStreamEncoder::readWindow(uint32_t* packed_output) {
+    window(window_scratch.data());
+    return sdm->read(window_scratch.data(), packed_output);
+}
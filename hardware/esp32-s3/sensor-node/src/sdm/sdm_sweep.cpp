@@ -0,0 +1,292 @@
+#include "sdm_sweep.h"
+
+#if !defined(ESP_PLATFORM)
+#include <thread>
+#endif
+
+// Worker tasks only wait on the sweep lock; 8 KB covers a config's scratch
+#define SDM_SWEEP_STACK 8192
+
+static uint8_t defaultSweepWorkers() {
+#if defined(ESP_PLATFORM)
+    return SDM_SCAN_WORKERS;
+#else
+    unsigned threads = std::thread::hardware_concurrency();
+    return static_cast<uint8_t>(std::min(std::max(threads, 1u), 16u));
+#endif
+}
+
+bool SDMSweep::run(const SDMSweepParams& sweep_params) {
+    params = sweep_params;
+    rows.clear();
+    jobs.clear();
+    pattern_dims.clear();
+    patterns.clear();
+    next_job = 0;
+    best_score = 0.0f;
+    configs_run = configs_pruned = configs_skipped = 0;
+
+    std::sort(params.reinforce_cycles.begin(), params.reinforce_cycles.end());
+    params.reinforce_cycles.erase(std::unique(params.reinforce_cycles.begin(), params.reinforce_cycles.end()),
+                                  params.reinforce_cycles.end());
+    if (params.reinforce_cycles.empty() || params.reinforce_cycles.back() == 0 || params.num_tests == 0) {
+        return false;
+    }
+
+    // Ordered by size, so a worker's next config usually reuses its memory
+    for (uint16_t dim : params.vector_dims) {
+        for (uint16_t locations : params.num_locations) {
+            for (float factor : params.radius_factors) {
+                if (dim == 0 || locations == 0) continue;
+                jobs.push_back({dim, locations, factor});
+            }
+        }
+    }
+    if (jobs.empty()) return false;
+
+    // One pattern set per dimension, derived from the seed like the addresses
+    for (uint16_t dim : params.vector_dims) {
+        if (dim == 0 || std::find(pattern_dims.begin(), pattern_dims.end(), dim) != pattern_dims.end()) continue;
+        uint16_t words = SDMKernels::wordsForDim(dim);
+        uint16_t ones = std::max<uint16_t>(1, static_cast<uint16_t>(dim * params.sparsity));
+        std::vector<uint32_t> set(static_cast<size_t>(params.num_tests) * words, 0);
+        uint64_t state = params.seed ^ (static_cast<uint64_t>(dim) << 32) ^ 0x7E57BA5Eu;
+        for (uint8_t t = 0; t < params.num_tests; t++) {
+            uint32_t* pattern = &set[static_cast<size_t>(t) * words];
+            for (uint16_t placed = 0; placed < ones;) {
+                uint16_t bit = SDMKernels::reduceRange(static_cast<uint32_t>(SDMKernels::splitmix64(state)), dim);
+                if (SDMKernels::testBit(pattern, bit)) continue;
+                SDMKernels::setBit(pattern, bit);
+                placed++;
+            }
+        }
+        pattern_dims.push_back(dim);
+        patterns.push_back(std::move(set));
+    }
+
+    uint8_t worker_count = params.workers ? params.workers : defaultSweepWorkers();
+    worker_count = static_cast<uint8_t>(std::min<size_t>(worker_count, jobs.size()));
+    lock = xSemaphoreCreateMutex();
+    finished = xSemaphoreCreateCounting(worker_count, 0);
+    if (!lock || !finished) {
+        if (lock) vSemaphoreDelete(lock);
+        if (finished) vSemaphoreDelete(finished);
+        lock = finished = nullptr;
+        return false;
+    }
+
+    Serial.printf("SDM sweep: %u configs x %u reinforcement levels on %u workers\n",
+                  (unsigned)jobs.size(), (unsigned)params.reinforce_cycles.size(), worker_count);
+    started_ms = millis();
+
+    std::vector<Worker> pool(worker_count);
+    uint8_t launched = 0;
+    for (uint8_t w = 0; w < worker_count; w++) {
+        pool[w].owner = this;
+        if (xTaskCreatePinnedToCore(workerTask, "sdm_sweep", SDM_SWEEP_STACK, &pool[w], 1, &pool[w].task,
+                                    w % SDM_SCAN_WORKERS) == pdPASS) {
+            launched++;
+        }
+    }
+    if (launched == 0) {
+        // No task could be created; sweep on the calling task instead
+        workerLoop();
+    }
+    for (uint8_t w = 0; w < launched; w++) {
+        xSemaphoreTake(finished, portMAX_DELAY);
+    }
+    vSemaphoreDelete(finished);
+    vSemaphoreDelete(lock);
+    lock = finished = nullptr;
+
+    // Workers finish out of order; report in grid order
+    std::sort(rows.begin(), rows.end(), [](const SDMSweepResult& a, const SDMSweepResult& b) {
+        if (a.config.vector_dim != b.config.vector_dim) return a.config.vector_dim < b.config.vector_dim;
+        if (a.config.num_locations != b.config.num_locations) return a.config.num_locations < b.config.num_locations;
+        if (a.radius_factor != b.radius_factor) return a.radius_factor < b.radius_factor;
+        return a.reinforcement < b.reinforcement;
+    });
+
+    Serial.printf("SDM sweep done in %lu ms: %u run (%u stopped early), %u skipped, best score %.3f\n",
+                  (unsigned long)(millis() - started_ms), configs_run, configs_pruned, configs_skipped, best_score);
+    return configs_run > 0;
+}
+
+void SDMSweep::workerTask(void* arg) {
+    Worker* worker = static_cast<Worker*>(arg);
+    SDMSweep* sweep = worker->owner;
+    sweep->workerLoop();
+    xSemaphoreGive(sweep->finished);
+    vTaskDelete(nullptr);
+}
+
+void SDMSweep::workerLoop() {
+    SparseDistributedMemory* sdm = nullptr;
+
+    while (true) {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        bool out_of_time = params.time_budget_ms && millis() - started_ms >= params.time_budget_ms;
+        if (next_job >= jobs.size() || out_of_time) {
+            configs_skipped += jobs.size() - next_job;
+            next_job = jobs.size();
+            xSemaphoreGive(lock);
+            break;
+        }
+        Job job = jobs[next_job++];
+
+        // Allocation happens under the lock so concurrent workers can't both
+        // pass the free-memory check and then overrun the reserve
+        if (!sdm || sdm->config.vector_dim != job.vector_dim || sdm->config.num_locations != job.num_locations) {
+            delete sdm;
+            sdm = nullptr;
+
+            SDMConfig config;
+            config.vector_dim = job.vector_dim;
+            config.num_locations = job.num_locations;
+            config.sparsity = params.sparsity;
+            config.seed = params.seed;
+            config.counter_bits = params.counter_bits;
+            config.persistent = false;
+            if (SparseDistributedMemory::fitsInMemory(config, params.reserve_bytes)) {
+                sdm = new SparseDistributedMemory(config);
+                if (!sdm->initialize()) {
+                    delete sdm;
+                    sdm = nullptr;
+                }
+            }
+        }
+        if (!sdm) {
+            configs_skipped++;
+            Serial.printf("Sweep skipped dim=%u, locs=%u (insufficient memory)\n", job.vector_dim, job.num_locations);
+        }
+        xSemaphoreGive(lock);
+
+        if (sdm) {
+            sdm->clearMemory();
+            sdm->resetStats();
+            sdm->config.access_radius = std::max<uint16_t>(1, static_cast<uint16_t>(job.vector_dim * job.radius_factor));
+            evaluate(job, sdm);
+        }
+    }
+
+    delete sdm;
+}
+
+void SDMSweep::evaluate(const Job& job, SparseDistributedMemory* sdm) {
+    const uint32_t* inputs = patternsFor(job.vector_dim);
+    uint16_t words = sdm->wordsPerVector();
+    uint8_t tests = params.num_tests;
+    std::vector<uint32_t> outputs(static_cast<size_t>(tests) * words, 0);
+    std::vector<float> confidences(tests, 0.0f);
+
+    SDMSweepResult row;
+    row.config = sdm->config;
+    row.radius_factor = job.radius_factor;
+    row.memory_bytes = sdm->footprint().total();
+
+    uint32_t start_ms = millis();
+    uint8_t written = 0;
+    float previous_score = -1.0f;
+    bool pruned = false;
+
+    for (size_t level = 0; level < params.reinforce_cycles.size(); level++) {
+        uint8_t target = params.reinforce_cycles[level];
+        for (; written < target; written++) {
+            uint32_t activated = sdm->writeBatch(inputs, tests);
+            if (written == 0) row.activated = static_cast<float>(activated) / tests;
+        }
+        sdm->readBatch(inputs, tests, outputs.data(), confidences.data());
+
+        float match_total = 0.0f;
+        float score_total = 0.0f;
+        float confidence_total = 0.0f;
+        for (uint8_t t = 0; t < tests; t++) {
+            const uint32_t* input = inputs + static_cast<size_t>(t) * words;
+            const uint32_t* output = &outputs[static_cast<size_t>(t) * words];
+            uint16_t mismatches = SDMKernels::hammingDistance(input, output, words);
+            // F1 = 2 * hits / (|input| + |output|)
+            uint32_t hits = 0;
+            for (uint16_t w = 0; w < words; w++) {
+                hits += __builtin_popcount(input[w] & output[w]);
+            }
+            uint32_t weights = SDMKernels::popcount(input, words) + SDMKernels::popcount(output, words);
+            match_total += static_cast<float>(job.vector_dim - mismatches) / job.vector_dim;
+            score_total += weights ? 2.0f * hits / weights : 1.0f;
+            confidence_total += confidences[t];
+        }
+        row.reinforcement = target;
+        row.match_ratio = match_total / tests;
+        row.score = score_total / tests;
+        row.confidence = confidence_total / tests;
+        row.duration_ms = millis() - start_ms;
+
+        xSemaphoreTake(lock, portMAX_DELAY);
+        rows.push_back(row);
+        best_score = std::max(best_score, row.score);
+        float best = best_score;
+        xSemaphoreGive(lock);
+
+        // Let the idle task run between levels (task watchdog)
+        vTaskDelay(1);
+
+        bool last = level + 1 == params.reinforce_cycles.size();
+        // With nothing activated, more cycles can't change the recall; far
+        // behind the best and no longer improving, they won't close the gap
+        bool dominated = row.activated == 0.0f ||
+                         (previous_score >= 0.0f && row.score < best - params.prune_margin &&
+                          row.score - previous_score < 0.01f);
+        if (dominated && !last) {
+            pruned = true;
+            break;
+        }
+        previous_score = row.score;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    configs_run++;
+    if (pruned) configs_pruned++;
+    Serial.printf("Sweep dim=%u, locs=%u, r=%u: score %.3f, match %.3f after %u cycles%s\n",
+                  job.vector_dim, job.num_locations, row.config.access_radius, row.score, row.match_ratio,
+                  row.reinforcement, pruned ? " (stopped early)" : "");
+    xSemaphoreGive(lock);
+}
+
+const uint32_t* SDMSweep::patternsFor(uint16_t vector_dim) const {
+    for (size_t i = 0; i < pattern_dims.size(); i++) {
+        if (pattern_dims[i] == vector_dim) return patterns[i].data();
+    }
+    return nullptr;
+}
+
+bool SDMSweep::best(SDMSweepResult* out) const {
+    const SDMSweepResult* best_row = nullptr;
+    for (const SDMSweepResult& row : rows) {
+        if (!best_row || row.score > best_row->score ||
+            (row.score == best_row->score && row.memory_bytes < best_row->memory_bytes)) {
+            best_row = &row;
+        }
+    }
+    if (!best_row) return false;
+    *out = *best_row;
+    return true;
+}
+
+bool SDMSweep::saveCSV(const String& path) const {
+    File file = SD.open(path, FILE_WRITE);
+    if (!file) {
+        Serial.printf("Failed to open %s\n", path.c_str());
+        return false;
+    }
+
+    file.println("vector_dim,num_locations,access_radius,radius_factor,reinforcement,match_ratio,score,"
+                 "confidence,activated,duration_ms,memory_usage");
+    for (const SDMSweepResult& row : rows) {
+        file.println(String(row.config.vector_dim) + "," + String(row.config.num_locations) + "," +
+                     String(row.config.access_radius) + "," + String(row.radius_factor, 2) + "," +
+                     String(row.reinforcement) + "," + String(row.match_ratio, 4) + "," + String(row.score, 4) + "," +
+                     String(row.confidence, 3) + "," + String(row.activated, 1) + "," + String(row.duration_ms) + "," +
+                     String(row.memory_bytes));
+    }
+    file.close();
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef SDM_SWEEP_H
+#define SDM_SWEEP_H
+
+#include "sdm.h"
+
+// Parameter grid for SDMSweep. reinforce_cycles must be ascending.
+struct SDMSweepParams {
+    std::vector<uint16_t> vector_dims = {32, 64, 128, 256};
+    std::vector<uint16_t> num_locations = {500, 1000, 2000};
+    std::vector<float> radius_factors = {0.1f, 0.2f, 0.4f, 0.6f};
+    std::vector<uint8_t> reinforce_cycles = {1, 5, 10, 20, 30};
+    uint8_t num_tests = 3;            // Patterns written and recalled per config
+    uint8_t counter_bits = 16;
+    float sparsity = 0.03f;           // Of the addresses and of the test patterns
+    uint32_t seed = 0x5DC0FFEE;       // Addresses and test patterns derive from it
+    uint32_t reserve_bytes = 100000;  // Kept free with every worker's memory allocated
+    uint8_t workers = 0;              // 0: one per core on the device, one per hardware thread on the host
+    float prune_margin = 0.25f;       // Stop reinforcing a config this far below the best score once it plateaus
+    uint32_t time_budget_ms = 0;      // >0: start no new config after this long
+};
+
+// One (config, reinforcement) point. Each config is reinforced cumulatively,
+// so its row for N cycles is the state after N writes of every pattern,
+// exactly as a fresh memory written N times.
+struct SDMSweepResult {
+    SDMConfig config;            // vector_dim, num_locations, access_radius, counter_bits
+    float radius_factor = 0.0f;
+    uint8_t reinforcement = 0;
+    float match_ratio = 0.0f;    // Fraction of matching bits, as testConfiguration()
+    float score = 0.0f;          // F1 over the patterns' set bits; an empty recall scores 0
+    float confidence = 0.0f;     // Mean read confidence
+    float activated = 0.0f;      // Mean locations activated per write
+    uint32_t duration_ms = 0;    // Since the config started, writes included
+    uint32_t memory_bytes = 0;
+};
+
+// Parallel parameter sweep. Configs of one size share a memory: a worker
+// clears the counters and changes the radius instead of reallocating, and
+// all configs of one vector_dim recall the same generated patterns. Workers
+// are FreeRTOS tasks, one per core (host builds get a thread each through
+// the shim), pulling configs from a shared list ordered by size.
+class SDMSweep {
+public:
+    bool run(const SDMSweepParams& params);
+
+    const std::vector<SDMSweepResult>& results() const { return rows; }
+    // Highest score; ties go to the smaller footprint. False if nothing ran.
+    bool best(SDMSweepResult* out) const;
+    uint16_t configsRun() const { return configs_run; }
+    uint16_t configsPruned() const { return configs_pruned; }
+    uint16_t configsSkipped() const { return configs_skipped; }
+
+    bool saveCSV(const String& path) const;
+
+private:
+    struct Job {
+        uint16_t vector_dim;
+        uint16_t num_locations;
+        float radius_factor;
+    };
+    struct Worker {
+        SDMSweep* owner = nullptr;
+        TaskHandle_t task = nullptr;
+    };
+
+    SDMSweepParams params;
+    std::vector<Job> jobs;
+    std::vector<uint16_t> pattern_dims;
+    std::vector<std::vector<uint32_t>> patterns;  // Per entry of pattern_dims, num_tests packed vectors
+    std::vector<SDMSweepResult> rows;
+
+    SemaphoreHandle_t lock = nullptr;     // Guards the fields below and allocation
+    SemaphoreHandle_t finished = nullptr;
+    size_t next_job = 0;
+    float best_score = 0.0f;
+    uint32_t started_ms = 0;
+    uint16_t configs_run = 0;
+    uint16_t configs_pruned = 0;
+    uint16_t configs_skipped = 0;
+
+    static void workerTask(void* arg);
+    void workerLoop();
+    void evaluate(const Job& job, SparseDistributedMemory* sdm);
+    const uint32_t* patternsFor(uint16_t vector_dim) const;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "sdm.h"
+
+void SparseDistributedMemory::telemetryFrame(SDMTelemetryFrame& frame) {
+    frame = SDMTelemetryFrame();
+    frame.sequence = telemetry.sequence++;
+    frame.uptime_ms = millis();
+    
+    frame.vector_dim = config.vector_dim;
+    frame.num_locations = config.num_locations;
+    frame.access_radius = config.target_activations ? stats.last_radius : config.access_radius;
+    frame.counter_bits = config.counter_bits;
+    frame.flags = (paged ? SDM_TELEMETRY_FLAG_PAGED : 0) | (counters_in_psram ? SDM_TELEMETRY_FLAG_PSRAM : 0) |
+                  (SDM_ENABLE_TELEMETRY ? SDM_TELEMETRY_FLAG_HOT_PATH : 0);
+    frame.total_writes = stats.total_writes;
+    frame.total_reads = stats.total_reads;
+    
+    for (uint8_t op = 0; op < SDM_OP_COUNT; op++) {
+        frame.op_count[op] = telemetry.op_count[op];
+        frame.op_max_us[op] = telemetry.op_max_us[op];
+        memcpy(frame.latency_us[op], telemetry.latency[op].buckets, sizeof(frame.latency_us[op]));
+    }
+    memcpy(frame.activated, telemetry.activated.buckets, sizeof(frame.activated));
+    
+    // Saturation over a rotating window of rows keeps the frame cost bounded on
+    // large arenas. Paged rows would have to be faulted in; skip them.
+    if (counters && !paged && config.num_locations > 0) {
+        int16_t high = static_cast<int16_t>((1 << (config.counter_bits - 1)) - 1);
+        int16_t low = static_cast<int16_t>(-high - 1);
+        uint16_t rows = std::min<uint16_t>(SDM_TELEMETRY_SAMPLE_ROWS, config.num_locations);
+        uint16_t location = telemetry.sample_cursor % config.num_locations;
+        for (uint16_t r = 0; r < rows; r++) {
+            const uint8_t* row = counters + static_cast<size_t>(location) * row_bytes;
+            for (uint16_t lane = 0; lane < config.vector_dim; lane++) {
+                int16_t value = SDMKernels::counterLane(row, config.counter_bits, lane);
+                if (value == high || value == low) frame.saturated_lanes++;
+            }
+            location = location + 1 == config.num_locations ? 0 : location + 1;
+        }
+        frame.sampled_lanes = static_cast<uint32_t>(rows) * config.vector_dim;
+        telemetry.sample_cursor = location;
+    }
+    
+    SDMHistogram usage;
+    for (uint16_t count : access_counts) {
+        usage.add(count);
+        if (count) frame.used_locations++;
+        if (count > frame.max_access_count) frame.max_access_count = count;
+    }
+    memcpy(frame.access_counts, usage.buckets, sizeof(frame.access_counts));
+    
+    frame.heap_free = ESP.getFreeHeap();
+    frame.heap_min_free = ESP.getMinFreeHeap();
+    frame.psram_free = ESP.getFreePsram();
+    frame.psram_min_free = ESP.getMinFreePsram();
+    
+    frame.dirty_rows = dirtyRowCount();
+    frame.page_failures = static_cast<uint16_t>(std::min<uint32_t>(page_failures, UINT16_MAX));
+    frame.page_faults = page_faults;
+    frame.page_writebacks = page_writebacks;
+}
+
+size_t sdmSendTelemetry(Print& out, SDMTelemetryFrame& frame) {
+    frame.crc = sdmCrc32(0, &frame, offsetof(SDMTelemetryFrame, crc));
+    return out.write(reinterpret_cast<const uint8_t*>(&frame), sizeof(frame));
+}
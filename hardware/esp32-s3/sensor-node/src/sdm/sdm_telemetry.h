@@ -0,0 +1,139 @@
+#ifndef SDM_TELEMETRY_H
+#define SDM_TELEMETRY_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+// Hot-path instrumentation. Build with -DSDM_ENABLE_TELEMETRY=1 to compile it
+// in; otherwise every recording call below is an empty inline and the timers
+// are never read.
+#ifndef SDM_ENABLE_TELEMETRY
+#define SDM_ENABLE_TELEMETRY 0
+#endif
+
+// Log2 buckets per histogram: bucket 0 counts zeros, bucket b counts values in
+// [2^(b-1), 2^b), and the last bucket is open-ended
+#define SDM_TELEMETRY_BUCKETS 16
+// Counter rows checked for saturation per frame, continuing where the last frame stopped
+#define SDM_TELEMETRY_SAMPLE_ROWS 256
+
+enum SDMTelemetryOp : uint8_t {
+    SDM_OP_WRITE,       // Per vector, batches divided by their size
+    SDM_OP_READ,
+    SDM_OP_CHECKPOINT,  // Journal append, image rewrite or page writeback, until on the card
+    SDM_OP_SAVE,        // Full saveToSD()
+    SDM_OP_COUNT
+};
+
+struct SDMHistogram {
+    uint32_t buckets[SDM_TELEMETRY_BUCKETS] = {};
+
+    void add(uint32_t value) { buckets[bucketOf(value)]++; }
+    static uint8_t bucketOf(uint32_t value) {
+        uint8_t bucket = value ? static_cast<uint8_t>(32 - __builtin_clz(value)) : 0;
+        return bucket < SDM_TELEMETRY_BUCKETS ? bucket : SDM_TELEMETRY_BUCKETS - 1;
+    }
+};
+
+// Binary telemetry frame, sent as is over serial or UDP. All fields are
+// little-endian; histograms and op counts are cumulative since the last
+// reset, so a reader diffs consecutive frames (sequence detects gaps).
+// crc covers everything before it. On serial the frames share the port with
+// text output: resynchronise on magic and accept a frame only if frame_bytes
+// and crc check out.
+#define SDM_TELEMETRY_MAGIC 0x544D4453u  // "SDMT"
+#define SDM_TELEMETRY_VERSION 1
+#define SDM_TELEMETRY_FLAG_PAGED 0x01
+#define SDM_TELEMETRY_FLAG_PSRAM 0x02
+#define SDM_TELEMETRY_FLAG_HOT_PATH 0x04  // Built with SDM_ENABLE_TELEMETRY; otherwise only the gauges are filled
+
+struct SDMTelemetryFrame {
+    uint32_t magic = SDM_TELEMETRY_MAGIC;
+    uint16_t version = SDM_TELEMETRY_VERSION;
+    uint16_t frame_bytes = sizeof(SDMTelemetryFrame);
+    uint32_t sequence = 0;
+    uint32_t uptime_ms = 0;
+
+    uint16_t vector_dim = 0;
+    uint16_t num_locations = 0;
+    uint16_t access_radius = 0;  // Last op's radius when SDMConfig::target_activations is set
+    uint8_t counter_bits = 0;
+    uint8_t flags = 0;
+    uint32_t total_writes = 0;
+    uint32_t total_reads = 0;
+
+    // Latency in microseconds per SDMTelemetryOp
+    uint32_t op_count[SDM_OP_COUNT] = {};
+    uint32_t op_max_us[SDM_OP_COUNT] = {};
+    uint32_t latency_us[SDM_OP_COUNT][SDM_TELEMETRY_BUCKETS] = {};
+    // Locations activated per written or read vector
+    uint32_t activated[SDM_TELEMETRY_BUCKETS] = {};
+
+    // Saturated lanes out of the lanes checked in this frame's window of rows
+    uint32_t saturated_lanes = 0;
+    uint32_t sampled_lanes = 0;
+    // Location utilization from the access counts
+    uint16_t used_locations = 0;
+    uint16_t max_access_count = 0;
+    uint32_t access_counts[SDM_TELEMETRY_BUCKETS] = {};
+
+    // Free heap now and its low-water mark since boot (internal and PSRAM)
+    uint32_t heap_free = 0;
+    uint32_t heap_min_free = 0;
+    uint32_t psram_free = 0;
+    uint32_t psram_min_free = 0;
+
+    uint16_t dirty_rows = 0;
+    uint16_t page_failures = 0;  // Failed page writebacks, saturating (reserved and 0 in older builds)
+    uint32_t page_faults = 0;
+    uint32_t page_writebacks = 0;
+    uint32_t crc = 0;
+};
+
+static_assert(sizeof(SDMTelemetryFrame) == 492, "SDMTelemetryFrame layout changed; bump SDM_TELEMETRY_VERSION");
+
+// Recorder owned by each SparseDistributedMemory. Recording is a timer read,
+// a count-leading-zeros and an increment; it runs on the task calling the
+// engine, never in the scan workers.
+class SDMTelemetry {
+public:
+#if SDM_ENABLE_TELEMETRY
+    static uint32_t start() { return micros(); }
+    void record(SDMTelemetryOp op, uint32_t started_us, uint16_t count = 1) {
+        recordElapsed(op, micros() - started_us, count);
+    }
+    void recordElapsed(SDMTelemetryOp op, uint32_t elapsed, uint16_t count = 1) {
+        uint32_t per_op = count > 1 ? elapsed / count : elapsed;
+        op_count[op] += count;
+        if (per_op > op_max_us[op]) op_max_us[op] = per_op;
+        latency[op].buckets[SDMHistogram::bucketOf(per_op)] += count;
+    }
+    void recordActivated(uint16_t locations) { activated.add(locations); }
+#else
+    static uint32_t start() { return 0; }
+    void record(SDMTelemetryOp, uint32_t, uint16_t = 1) {}
+    void recordElapsed(SDMTelemetryOp, uint32_t, uint16_t = 1) {}
+    void recordActivated(uint16_t) {}
+#endif
+    // Sequence numbers keep counting so a reader sees the reset as a drop in op_count
+    void reset() {
+        uint32_t next = sequence;
+        *this = SDMTelemetry();
+        sequence = next;
+    }
+
+private:
+    friend class SparseDistributedMemory;  // Fills frames from these and its own state
+
+    uint32_t op_count[SDM_OP_COUNT] = {};
+    uint32_t op_max_us[SDM_OP_COUNT] = {};
+    SDMHistogram latency[SDM_OP_COUNT];
+    SDMHistogram activated;
+    uint32_t sequence = 0;
+    uint16_t sample_cursor = 0;  // Next row checked for saturation
+};
+
+// Seal a frame (crc) and write it in one piece to Serial, a WiFiUDP packet or a file
+size_t sdmSendTelemetry(Print& out, SDMTelemetryFrame& frame);
+
+#endif
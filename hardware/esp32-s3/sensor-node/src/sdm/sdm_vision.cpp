@@ -0,0 +1,174 @@
+#include "sdm_vision.h"
+
+bool VisionPipeline::begin(const VisionConfig& cfg) {
+    end();
+    if (cfg.pixel_format != PIXFORMAT_GRAYSCALE && cfg.pixel_format != PIXFORMAT_RGB565) {
+        Serial.println("Vision pipeline needs grayscale or RGB565 frames");
+        return false;
+    }
+    if (cfg.grid_cols * cfg.grid_rows < 2 || cfg.vector_dim == 0) {
+        Serial.println("Vision pipeline needs at least two cells and one bit");
+        return false;
+    }
+    
+    config = cfg;
+    stats = VisionStats();
+    words_per_vector = SDMKernels::wordsForDim(config.vector_dim);
+    buildPairs();
+    cell_sums.assign(static_cast<size_t>(config.grid_cols) * config.grid_rows, 0);
+    slots.assign(2 * words_per_vector, 0);
+    front = 0;
+    sequence = 0;
+    
+    if (!camera->init(config.pixel_format, config.frame_size, config.fb_count)) {
+        return false;
+    }
+    
+    stop_requested = false;
+    window_start_ms = millis();
+    window_frames = 0;
+    if (xTaskCreatePinnedToCore(captureTask, "sdm_vision", 4096, this, 1, &task, config.task_core) != pdPASS) {
+        task = nullptr;
+        Serial.println("Failed to start vision task");
+        return false;
+    }
+    Serial.printf("Vision pipeline: %ux%u grid -> %u-bit vectors\n",
+                  config.grid_cols, config.grid_rows, config.vector_dim);
+    return true;
+}
+
+void VisionPipeline::end() {
+    if (!task) return;
+    
+    // The task checks the flag once per frame and clears the handle on exit.
+    // captureFrame() returns within the driver's frame timeout, so this ends;
+    // the camera can't be torn down under a task that is still using it.
+    stop_requested = true;
+    while (task) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    camera->deinit();
+}
+
+void VisionPipeline::buildPairs() {
+    // splitmix64 over the seed, as for hard-location addresses
+    uint16_t cells = config.grid_cols * config.grid_rows;
+    cell_pairs.resize(2 * config.vector_dim);
+    uint64_t state = config.seed;
+    for (uint16_t j = 0; j < config.vector_dim; j++) {
+        uint64_t random = SDMKernels::splitmix64(state);
+        uint16_t a = SDMKernels::reduceRange(static_cast<uint32_t>(random), cells);
+        uint16_t b = SDMKernels::reduceRange(static_cast<uint32_t>(random >> 32), cells - 1);
+        cell_pairs[2 * j] = a;
+        cell_pairs[2 * j + 1] = b >= a ? b + 1 : b;  // Never compare a cell with itself
+    }
+}
+
+bool VisionPipeline::encodeFrame(const camera_fb_t* frame, uint32_t* packed) {
+    if (!frame || (frame->format != PIXFORMAT_GRAYSCALE && frame->format != PIXFORMAT_RGB565)) return false;
+    
+    // Equal-sized cells; the right and bottom remainders are not sampled
+    uint16_t cell_width = frame->width / config.grid_cols;
+    uint16_t cell_height = frame->height / config.grid_rows;
+    if (cell_width == 0 || cell_height == 0) return false;
+    
+    bool rgb = frame->format == PIXFORMAT_RGB565;
+    size_t stride = static_cast<size_t>(frame->width) * (rgb ? 2 : 1);
+    if (frame->len < stride * cell_height * config.grid_rows) return false;
+    
+    // Box sums straight from the framebuffer, one row of cells at a time
+    std::fill(cell_sums.begin(), cell_sums.end(), 0);
+    for (uint16_t y = 0; y < cell_height * config.grid_rows; y++) {
+        const uint8_t* row = frame->buf + y * stride;
+        uint32_t* sums = &cell_sums[(y / cell_height) * config.grid_cols];
+        for (uint8_t cx = 0; cx < config.grid_cols; cx++) {
+            const uint8_t* pixel = row + cx * cell_width * (rgb ? 2 : 1);
+            uint32_t sum = 0;
+            if (rgb) {
+                // Big-endian RGB565; 2*R5 + 2*G6 + B5 weighs about 0.28R + 0.58G + 0.14B
+                for (uint16_t x = 0; x < cell_width; x++, pixel += 2) {
+                    uint16_t value = (pixel[0] << 8) | pixel[1];
+                    sum += ((value >> 11) << 1) + (((value >> 5) & 0x3F) << 1) + (value & 0x1F);
+                }
+            } else {
+                for (uint16_t x = 0; x < cell_width; x++) {
+                    sum += pixel[x];
+                }
+            }
+            sums[cx] += sum;
+        }
+    }
+    
+    // One comparison per bit
+    std::fill(packed, packed + words_per_vector, 0);
+    for (uint16_t j = 0; j < config.vector_dim; j++) {
+        if (cell_sums[cell_pairs[2 * j]] > cell_sums[cell_pairs[2 * j + 1]]) {
+            SDMKernels::setBit(packed, j);
+        }
+    }
+    return true;
+}
+
+bool VisionPipeline::latest(uint32_t* packed, uint32_t* seen) {
+    portENTER_CRITICAL(&slot_lock);
+    bool fresh = sequence != 0 && sequence != *seen;
+    if (fresh) {
+        memcpy(packed, &slots[front * words_per_vector], words_per_vector * sizeof(uint32_t));
+        *seen = sequence;
+    }
+    portEXIT_CRITICAL(&slot_lock);
+    return fresh;
+}
+
+VisionStats VisionPipeline::getStats() {
+    portENTER_CRITICAL(&slot_lock);
+    VisionStats copy = stats;
+    portEXIT_CRITICAL(&slot_lock);
+    return copy;
+}
+
+void VisionPipeline::captureTask(void* arg) {
+    VisionPipeline* self = static_cast<VisionPipeline*>(arg);
+    
+    while (!self->stop_requested) {
+        // The driver keeps filling the other framebuffer while this one is encoded
+        camera_fb_t* frame = self->camera->captureFrame();
+        if (!frame) {
+            portENTER_CRITICAL(&self->slot_lock);
+            self->stats.failures++;
+            portEXIT_CRITICAL(&self->slot_lock);
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        
+        uint32_t start_us = micros();
+        uint8_t back = self->front ^ 1;
+        bool encoded = self->encodeFrame(frame, &self->slots[back * self->words_per_vector]);
+        uint32_t elapsed_us = micros() - start_us;
+        self->camera->releaseFrame(frame);
+        
+        uint32_t now = millis();
+        portENTER_CRITICAL(&self->slot_lock);
+        if (encoded) {
+            self->front = back;
+            self->sequence++;
+            self->stats.frames++;
+            self->stats.last_encode_us = elapsed_us;
+            // Running average over roughly the last 16 frames
+            self->stats.avg_encode_us = self->stats.frames == 1 ? elapsed_us :
+                                        self->stats.avg_encode_us - self->stats.avg_encode_us / 16 + elapsed_us / 16;
+            self->window_frames++;
+        } else {
+            self->stats.failures++;
+        }
+        if (now - self->window_start_ms >= 1000) {
+            self->stats.fps = self->window_frames * 1000.0f / (now - self->window_start_ms);
+            self->window_start_ms = now;
+            self->window_frames = 0;
+        }
+        portEXIT_CRITICAL(&self->slot_lock);
+    }
+    
+    self->task = nullptr;
+    vTaskDelete(nullptr);
+}
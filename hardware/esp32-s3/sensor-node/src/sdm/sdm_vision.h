@@ -0,0 +1,90 @@
+#ifndef SDM_VISION_H
+#define SDM_VISION_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "modules/camera_module.h"
+#include "sdm_kernels.h"
+#include "sdm_alloc.h"
+
+// Camera frames to packed hypervectors for SparseDistributedMemory::write()/read().
+//
+// The frame is reduced to a grid of cell brightness sums read straight from
+// the framebuffer, then bit j of the vector is set when cell a_j is brighter
+// than cell b_j, for vector_dim cell pairs drawn from the seed. Similar images
+// agree on most comparisons and global brightness changes none of them, so
+// Hamming distance tracks image similarity.
+//
+// With fb_count = 2 the driver fills one framebuffer while the capture task
+// encodes the other; finished vectors are published to a double-buffered slot
+// that latest() copies from.
+
+struct VisionConfig {
+    pixformat_t pixel_format = PIXFORMAT_GRAYSCALE;  // Or PIXFORMAT_RGB565
+    framesize_t frame_size = FRAMESIZE_QQVGA;        // 160x120
+    uint8_t fb_count = 2;
+    uint8_t grid_cols = 16;
+    uint8_t grid_rows = 12;
+    uint16_t vector_dim = 128;
+    uint32_t seed = 0x5EE1F00D;  // Cell pairs are derived from it; keep it fixed for stored memories
+    uint8_t task_core = 0;       // Capture task core; loop() runs on core 1
+};
+
+struct VisionStats {
+    uint32_t frames = 0;       // Frames encoded
+    uint32_t failures = 0;     // Capture or encode failures
+    uint32_t last_encode_us = 0;
+    uint32_t avg_encode_us = 0;
+    float fps = 0.0f;          // Encoded frames per second over the last second
+};
+
+class VisionPipeline {
+private:
+    CameraModule* camera;
+    VisionConfig config;
+    VisionStats stats;
+    uint16_t words_per_vector = 0;
+
+    InternalVector<uint16_t> cell_pairs;   // vector_dim x (a, b) cell indices
+    InternalVector<uint32_t> cell_sums;    // grid_cols x grid_rows, scratch per frame
+
+    // Double-buffered output: the task encodes into the back slot and flips
+    InternalVector<uint32_t> slots;        // 2 x words_per_vector
+    uint8_t front = 0;
+    uint32_t sequence = 0;                 // Vectors published so far
+    portMUX_TYPE slot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+    TaskHandle_t task = nullptr;
+    volatile bool stop_requested = false;
+    uint32_t window_start_ms = 0;
+    uint32_t window_frames = 0;
+
+    void buildPairs();
+    static void captureTask(void* arg);
+
+public:
+    VisionPipeline(CameraModule* camera_module) : camera(camera_module) {}
+    ~VisionPipeline() { end(); }
+    VisionPipeline(const VisionPipeline&) = delete;
+    VisionPipeline& operator=(const VisionPipeline&) = delete;
+
+    // Reinitialize the camera for raw capture and start the capture task
+    bool begin(const VisionConfig& cfg);
+    void end();
+    bool running() const { return task != nullptr; }
+
+    // Encode one grayscale or RGB565 frame into words_per_vector packed words.
+    // Usable without the task (e.g. on a frame from CameraModule::captureFrame()),
+    // but not while it runs: both use the same cell scratch.
+    bool encodeFrame(const camera_fb_t* frame, uint32_t* packed);
+
+    // Copy the newest published vector; false if none is newer than *seen.
+    // *seen is updated to the returned vector's sequence number.
+    bool latest(uint32_t* packed, uint32_t* seen);
+
+    VisionStats getStats();
+    const VisionConfig& getConfig() const { return config; }
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include "sdm_writer.h"
+
+SDMWriter& sdmWriter() {
+    static SDMWriter writer;
+    return writer;
+}
+
+uint8_t* SDMWriteBuffer::extend(size_t count) {
+    if (length + count > data.size()) {
+        data.resize(std::max(length + count, std::max<size_t>(data.size() * 2, SDM_WRITER_BUFFER_BYTES)));
+    }
+    uint8_t* at = data.data() + length;
+    length += count;
+    return at;
+}
+
+bool SDMWriter::begin(BaseType_t core, UBaseType_t priority) {
+    if (task) return true;
+
+    free_buffers = xQueueCreate(SDM_WRITER_BUFFERS, sizeof(SDMWriteBuffer*));
+    jobs = xQueueCreate(SDM_WRITER_BUFFERS, sizeof(SDMWriteBuffer*));
+    submit_lock = xSemaphoreCreateMutex();
+    if (!free_buffers || !jobs || !submit_lock) {
+        Serial.println("Failed to create SD writer queues");
+        return false;
+    }
+    for (SDMWriteBuffer& buffer : buffers) {
+        SDMWriteBuffer* free_buffer = &buffer;
+        xQueueSend(free_buffers, &free_buffer, 0);
+    }
+
+    if (xTaskCreatePinnedToCore(writerTask, "sdm_writer", SDM_WRITER_STACK, this, priority, &task, core) != pdPASS) {
+        task = nullptr;
+        Serial.println("Failed to start SD writer task");
+        return false;
+    }
+    return true;
+}
+
+SDMWriteBuffer* SDMWriter::acquire(uint32_t wait_ms) {
+    SDMWriteBuffer* buffer = nullptr;
+    if (!task) {
+        // Synchronous mode: the previous job was written inside submit()
+        buffer = &buffers[0];
+    } else if (xQueueReceive(free_buffers, &buffer, wait_ms == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms)) != pdTRUE) {
+        return nullptr;
+    }
+
+    if (buffer->data.empty()) {
+        buffer->data.resize(SDM_WRITER_BUFFER_BYTES);
+    }
+    buffer->length = 0;
+    buffer->write_us = nullptr;
+    return buffer;
+}
+
+uint32_t SDMWriter::submit(SDMWriteBuffer* buffer, const String& path, SDMWriteMode mode) {
+    buffer->path = path;
+    buffer->mode = mode;
+    if (!task) {
+        buffer->ticket = ++submitted_ticket;
+        run(buffer);
+        return buffer->ticket;
+    }
+
+    // Tickets and queue order must agree for done() to mean anything
+    xSemaphoreTake(submit_lock, portMAX_DELAY);
+    buffer->ticket = ++submitted_ticket;
+    // Never waits: there are only SDM_WRITER_BUFFERS buffers to queue
+    xQueueSend(jobs, &buffer, portMAX_DELAY);
+    xSemaphoreGive(submit_lock);
+    return buffer->ticket;
+}
+
+uint32_t SDMWriter::write(const String& path, const void* data, size_t length, SDMWriteMode mode, uint32_t wait_ms) {
+    SDMWriteBuffer* buffer = acquire(wait_ms);
+    if (!buffer) return 0;
+    buffer->append(data, length);
+    return submit(buffer, path, mode);
+}
+
+bool SDMWriter::flush(uint32_t timeout_ms) {
+    uint32_t started_ms = millis();
+    while (pending() > 0) {
+        if (timeout_ms != portMAX_DELAY && millis() - started_ms >= timeout_ms) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+bool SDMWriter::writeOut(const SDMWriteBuffer& buffer) {
+    File file = SD.open(buffer.path, buffer.mode == SDM_WRITE_APPEND ? FILE_APPEND : FILE_WRITE);
+    if (!file) return false;
+    bool written = file.write(buffer.data.data(), buffer.length) == buffer.length;
+    file.close();
+    return written;
+}
+
+void SDMWriter::run(SDMWriteBuffer* buffer) {
+    uint32_t started_us = micros();
+    bool written = writeOut(*buffer);
+    // Added before finish() so the time is in once done() says so
+    if (buffer->write_us) *buffer->write_us += micros() - started_us;
+    finish(buffer, written);
+}
+
+void SDMWriter::finish(SDMWriteBuffer* buffer, bool written) {
+    if (!written) {
+        Serial.printf("SD write to %s failed\n", buffer->path.c_str());
+        last_failed_ticket = buffer->ticket;
+        failure_count = failure_count + 1;
+    }
+    completed_ticket = buffer->ticket;
+}
+
+void SDMWriter::writerTask(void* arg) {
+    SDMWriter* writer = static_cast<SDMWriter*>(arg);
+    for (;;) {
+        SDMWriteBuffer* buffer = nullptr;
+        if (xQueueReceive(writer->jobs, &buffer, portMAX_DELAY) != pdTRUE) continue;
+
+        writer->run(buffer);
+        // Completed before the buffer is free again, so whoever acquires it next sees done()
+        xQueueSend(writer->free_buffers, &buffer, portMAX_DELAY);
+    }
+}
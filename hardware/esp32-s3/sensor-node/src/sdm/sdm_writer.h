@@ -0,0 +1,85 @@
+#ifndef SDM_WRITER_H
+#define SDM_WRITER_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "sdm_alloc.h"
+
+// Staging buffers: callers fill one while the writer task flushes the other
+#define SDM_WRITER_BUFFERS 2
+// A buffer is handed over once it holds this much; single jobs may grow it past
+#define SDM_WRITER_BUFFER_BYTES 8192
+#define SDM_WRITER_STACK 4096
+
+enum SDMWriteMode : uint8_t {
+    SDM_WRITE_REPLACE,  // Truncate or create (FILE_WRITE)
+    SDM_WRITE_APPEND,   // FILE_APPEND
+};
+
+// Owned by whoever acquired it until submit() hands it to the writer
+struct SDMWriteBuffer {
+    InternalVector<uint8_t> data;
+    size_t length = 0;
+    String path;
+    SDMWriteMode mode = SDM_WRITE_REPLACE;
+    uint32_t ticket = 0;
+    volatile uint32_t* write_us = nullptr;  // If set, the writer adds the microseconds it spent on this job
+
+    void append(const void* bytes, size_t count) { memcpy(extend(count), bytes, count); }
+    // count more bytes at the end, to be filled in place
+    uint8_t* extend(size_t count);
+};
+
+// SD writes that the caller doesn't have to wait for (journal appends, stats,
+// CSV logs), done in submission order by one task off the loop. Each job gets
+// a ticket; done() and failedSince() tell a caller how its jobs went. With
+// only SDM_WRITER_BUFFERS buffers, acquire() is the back-pressure: it waits
+// for the card when both are still being written. Until begin() starts the
+// task (and in the native build unless started) submit() writes on the spot.
+class SDMWriter {
+public:
+    bool begin(BaseType_t core = 0, UBaseType_t priority = 1);
+    bool running() const { return task != nullptr; }
+
+    // An empty buffer, waiting up to wait_ms for one; nullptr on timeout
+    SDMWriteBuffer* acquire(uint32_t wait_ms = portMAX_DELAY);
+    // Queue the buffer's bytes for path and give the buffer up; returns the ticket
+    uint32_t submit(SDMWriteBuffer* buffer, const String& path, SDMWriteMode mode);
+    // acquire(), copy and submit() in one; 0 if no buffer was free within wait_ms
+    uint32_t write(const String& path, const void* data, size_t length, SDMWriteMode mode,
+                   uint32_t wait_ms = portMAX_DELAY);
+
+    bool done(uint32_t ticket) const { return static_cast<int32_t>(completed_ticket - ticket) >= 0; }
+    // Whether any job from ticket on has failed so far
+    bool failedSince(uint32_t ticket) const { return static_cast<int32_t>(last_failed_ticket - ticket) >= 0; }
+    uint32_t pending() const { return submitted_ticket - completed_ticket; }
+    uint32_t failures() const { return failure_count; }
+    // Wait for every submitted job; false on timeout. Synchronous SD work that
+    // must come after queued writes (image rewrites, loads) calls this first.
+    bool flush(uint32_t timeout_ms = portMAX_DELAY);
+
+private:
+    SDMWriteBuffer buffers[SDM_WRITER_BUFFERS];
+    QueueHandle_t free_buffers = nullptr;  // SDMWriteBuffer*
+    QueueHandle_t jobs = nullptr;          // SDMWriteBuffer*, in ticket order
+    SemaphoreHandle_t submit_lock = nullptr;
+    TaskHandle_t task = nullptr;
+    volatile uint32_t submitted_ticket = 0;
+    volatile uint32_t completed_ticket = 0;
+    volatile uint32_t last_failed_ticket = 0;
+    volatile uint32_t failure_count = 0;
+
+    static bool writeOut(const SDMWriteBuffer& buffer);
+    void run(SDMWriteBuffer* buffer);
+    void finish(SDMWriteBuffer* buffer, bool written);
+    static void writerTask(void* arg);
+};
+
+// The one writer shared by every SDM instance and the benchmark logs
+SDMWriter& sdmWriter();
+
+#endif
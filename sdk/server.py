@@ -1,6 +1,15 @@
-from fastapi import FastAPI
+import os
+from concurrent.futures import ThreadPoolExecutor
+from threading import Lock
+from typing import Dict, List, Optional
+
+import numpy as np
+from fastapi import FastAPI, HTTPException
 from pydantic import BaseModel
 
+from backend.core.sdm.memory import pack_vectors, unpack_vectors
+from backend.core.sdm.protocol import NodeLink, ProtocolError
+
 app = FastAPI()
 
 class TextInput(BaseModel):
@@ -22,4 +31,90 @@ async def store_vector(input: VectorInput):
 @app.post("/query")
 async def query_vector(input: VectorInput):
     # TODO: implement SDM query logic
-    return {"result": "query_result_placeholder"}
\ No newline at end of file
+    return {"result": "query_result_placeholder"}
+
+# Fleet of sensor nodes running the SDM network service (UDP, NET_PORT).
+# Every node stores every pattern; a query goes to all of them and the most
+# confident answer wins. Routes are plain defs so FastAPI runs them on its
+# threadpool while the fan-out waits on the network.
+fleet: Dict[str, NodeLink] = {}
+fleet_locks: Dict[str, Lock] = {}
+fleet_pool = ThreadPoolExecutor(max_workers=16)
+
+class NodeInput(BaseModel):
+    host: str
+
+class FleetVectors(BaseModel):
+    vectors: List[str]  # '0'/'1' strings of the fleet's vector_dim
+    strength: int = 1
+    nodes: Optional[List[str]] = None
+
+def add_node(host):
+    link = NodeLink.udp(host)
+    fleet[host] = link
+    fleet_locks[host] = Lock()
+    return {"host": host, "vector_dim": link.vector_dim, "num_locations": link.num_locations,
+            "counter_bits": link.counter_bits}
+
+def fan_out(hosts, call):
+    """call(link) on each node in parallel; {host: result or error string}"""
+    def run(host):
+        with fleet_locks[host]:  # One request at a time per node; sequence numbers are per link
+            try:
+                return call(fleet[host])
+            except (ProtocolError, OSError) as error:
+                return str(error)
+    hosts = [h for h in (hosts or list(fleet)) if h in fleet]
+    return dict(zip(hosts, fleet_pool.map(run, hosts)))
+
+def packed_input(input: FleetVectors):
+    """The request's vectors packed for the nodes it goes to; 400 if they can't take them"""
+    dims = {fleet[host].vector_dim for host in (input.nodes or list(fleet)) if host in fleet}
+    if len(dims) != 1:
+        raise HTTPException(400, "fleet nodes disagree on vector_dim" if dims else "no nodes registered")
+    vector_dim = dims.pop()
+    if not input.vectors:
+        raise HTTPException(400, "no vectors given")
+    if any(len(v) != vector_dim or set(v) - {'0', '1'} for v in input.vectors):
+        raise HTTPException(400, f"vectors must be {vector_dim} '0'/'1' characters")
+    bits = np.array([[int(c) for c in v] for v in input.vectors], dtype=np.uint8)
+    return pack_vectors(bits, vector_dim), vector_dim
+
+for host in filter(None, os.environ.get("SDM_NODES", "").split(",")):
+    try:
+        add_node(host.strip())
+    except (ProtocolError, OSError) as error:
+        print(f"SDM node {host} unavailable: {error}")
+
+@app.post("/fleet/nodes")
+def register_node(input: NodeInput):
+    try:
+        return add_node(input.host)
+    except (ProtocolError, OSError) as error:
+        return {"host": input.host, "error": str(error)}
+
+@app.get("/fleet/nodes")
+def list_nodes():
+    return {host: {"vector_dim": link.vector_dim, "num_locations": link.num_locations} for host, link in fleet.items()}
+
+@app.post("/fleet/store")
+def fleet_store(input: FleetVectors):
+    packed, _ = packed_input(input)
+    return {"activated": fan_out(input.nodes, lambda link: link.write(packed, input.strength))}
+
+@app.post("/fleet/query")
+def fleet_query(input: FleetVectors):
+    packed, vector_dim = packed_input(input)
+    answers = fan_out(input.nodes, lambda link: link.read(packed))
+    results = []
+    for i in range(len(packed)):
+        replies = [(conf[i], host, out[i]) for host, (out, conf) in
+                   ((h, a) for h, a in answers.items() if not isinstance(a, str))]
+        if not replies:
+            results.append(None)
+            continue
+        confidence, host, output = max(replies, key=lambda r: r[0])
+        results.append({"vector": "".join(map(str, unpack_vectors(output, vector_dim))),
+                        "confidence": float(confidence), "node": host})
+    errors = {h: a for h, a in answers.items() if isinstance(a, str)}
+    return {"results": results, "errors": errors}
@@ -0,0 +1,77 @@
+"""Build the native SDM engine used by backend/core/sdm/memory.py.
+
+    pip install pybind11
+    pio pkg install -e native -d hardware/esp32-s3/sensor-node   # fetches ArduinoJson
+    python setup.py build_ext --inplace
+
+Compiles the sensor node's SDM sources against the host shim in
+hardware/esp32-s3/sensor-node/src/host into backend/core/sdm/_sdm_native.
+The extension is optional: without ArduinoJson (or a working compiler) the
+build warns and skips it, and memory.py falls back to the NumPy engine.
+Set ARDUINOJSON_INCLUDE to use another ArduinoJson checkout, and
+SDM_NATIVE_MARCH=native (or another -march value) to tune for a CPU.
+"""
+
+import os
+from glob import glob
+from pathlib import Path
+
+from pybind11.setup_helpers import Pybind11Extension, build_ext
+from setuptools import setup
+
+ROOT = Path(__file__).parent.resolve()
+NODE = ROOT / "hardware" / "esp32-s3" / "sensor-node"
+
+
+def arduinojson_include():
+    candidates = [os.environ.get("ARDUINOJSON_INCLUDE", ""),
+                  str(NODE / ".pio" / "libdeps" / "native" / "ArduinoJson" / "src")]
+    for candidate in candidates:
+        if candidate and (Path(candidate) / "ArduinoJson.h").exists():
+            return candidate
+    return None
+
+
+def native_sources():
+    # Same selection as [env:native], without the benchmark's main()
+    node = NODE.relative_to(ROOT)
+    device_only = ("sdm_vision.cpp", "sdm_net.cpp")
+    engine = [s for s in glob(str(node / "src" / "sdm" / "*.cpp")) if not s.endswith(device_only)]
+    host = glob(str(node / "src" / "host" / "host_*.cpp"))
+    return sorted(engine) + sorted(host)
+
+
+class native_build_ext(build_ext):
+    # ArduinoJson is looked up when the extension is built, not when setup.py
+    # runs, so installs that never build it (sdists, metadata) don't need it
+    def build_extensions(self):
+        include = arduinojson_include()
+        if include is None:
+            self.warn("ArduinoJson not found, skipping the native SDM engine: run `pio pkg install -e native` "
+                      f"in {NODE.relative_to(ROOT)} or set ARDUINOJSON_INCLUDE")
+            self.extensions = []
+            return
+        for extension in self.extensions:
+            extension.include_dirs.append(include)
+        super().build_extensions()
+
+
+flags = ["-O3", "-pthread"]
+if os.environ.get("SDM_NATIVE_MARCH"):
+    flags.append("-march=" + os.environ["SDM_NATIVE_MARCH"])
+
+setup(
+    packages=[],
+    ext_modules=[
+        Pybind11Extension(
+            "backend.core.sdm._sdm_native",
+            ["backend/core/sdm/native/sdm_native.cpp"] + native_sources(),
+            include_dirs=[str(NODE / "src" / "host"), str(NODE / "src")],
+            cxx_std=17,
+            extra_compile_args=flags,
+            extra_link_args=["-pthread"],
+            optional=True,
+        )
+    ],
+    cmdclass={"build_ext": native_build_ext},
+)